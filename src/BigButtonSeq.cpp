@@ -435,17 +435,24 @@ struct BigButtonSeq : Module {
 
 
 struct BigButtonSeqWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 
-	struct ChanDisplayWidget : TransparentWidget {
+	struct ChanDisplayWidget : CachedDisplayWidget {
 		BigButtonSeq *module;
 		std::shared_ptr<Font> font;
+		char displayStr[2];
 		
 		ChanDisplayWidget() {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			unsigned int chan = (unsigned)(module ? module->channel : 0);
+			snprintf(displayStr, 2, "%1u", (unsigned) (chan + 1) );
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			//nvgTextLetterSpacing(args.vg, 2.5);
@@ -454,22 +461,26 @@ struct BigButtonSeqWidget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~", NULL);
 			nvgFillColor(args.vg, textColor);
-			char displayStr[2];
-			unsigned int chan = (unsigned)(module ? module->channel : 0);
-			snprintf(displayStr, 2, "%1u", (unsigned) (chan + 1) );
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};
 
-	struct StepsDisplayWidget : TransparentWidget {
+	struct StepsDisplayWidget : CachedDisplayWidget {
 		BigButtonSeq *module;
 		std::shared_ptr<Font> font;
+		char displayStr[3];
 		
 		StepsDisplayWidget() {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			unsigned int len = (unsigned)(module ? module->length : 64);
+			snprintf(displayStr, 3, "%2u", (unsigned) len );
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			//nvgTextLetterSpacing(args.vg, 2.5);
@@ -478,9 +489,6 @@ struct BigButtonSeqWidget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~~", NULL);
 			nvgFillColor(args.vg, textColor);
-			char displayStr[3];
-			unsigned int len = (unsigned)(module ? module->length : 64);
-			snprintf(displayStr, 3, "%2u", (unsigned) len );
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};
@@ -577,8 +585,10 @@ struct BigButtonSeqWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/BigButtonSeq.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/BigButtonSeq_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/BigButtonSeq_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -698,14 +708,6 @@ struct BigButtonSeqWidget : ModuleWidget {
 		// Metronome light
 		addChild(createLight<MediumLight<GreenRedLight>>(Vec(colRulerT0 + offsetMediumLight - 1, rowRulerExtras), module, BigButtonSeq::METRONOME_LIGHT + 0));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((BigButtonSeq*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((BigButtonSeq*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelBigButtonSeq = createModel<BigButtonSeq, BigButtonSeqWidget>("Big-Button-Seq");
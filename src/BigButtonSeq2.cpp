@@ -562,17 +562,24 @@ struct BigButtonSeq2 : Module {
 
 
 struct BigButtonSeq2Widget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 
-	struct ChanDisplayWidget : TransparentWidget {
+	struct ChanDisplayWidget : CachedDisplayWidget {
 		BigButtonSeq2 *module;
 		std::shared_ptr<Font> font;
+		char displayStr[2];
 		
 		ChanDisplayWidget() {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			unsigned int channel = (unsigned)(module ? module->channel : 0);
+			snprintf(displayStr, 2, "%1u", (unsigned) (channel + 1) );
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			//nvgTextLetterSpacing(args.vg, 2.5);
@@ -581,22 +588,28 @@ struct BigButtonSeq2Widget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~", NULL);
 			nvgFillColor(args.vg, textColor);
-			char displayStr[2];
-			unsigned int channel = (unsigned)(module ? module->channel : 0);
-			snprintf(displayStr, 2, "%1u", (unsigned) (channel + 1) );
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};
 
-	struct StepsDisplayWidget : TransparentWidget {
+	struct StepsDisplayWidget : CachedDisplayWidget {
 		BigButtonSeq2 *module;
 		std::shared_ptr<Font> font;
+		char displayStr[4];
 		
 		StepsDisplayWidget() {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			unsigned dispVal = 128;
+			if (module)
+				dispVal = (unsigned)(module->params[BigButtonSeq2::DISPMODE_PARAM].getValue() < 0.5f ?  module->length : module->indexStep + 1);
+			snprintf(displayStr, 4, "%3u",  dispVal);
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			//nvgTextLetterSpacing(args.vg, 2.5);
@@ -605,11 +618,6 @@ struct BigButtonSeq2Widget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
 			nvgFillColor(args.vg, textColor);
-			char displayStr[4];
-			unsigned dispVal = 128;
-			if (module)
-				dispVal = (unsigned)(module->params[BigButtonSeq2::DISPMODE_PARAM].getValue() < 0.5f ?  module->length : module->indexStep + 1);
-			snprintf(displayStr, 4, "%3u",  dispVal);
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};
@@ -704,8 +712,10 @@ struct BigButtonSeq2Widget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/BigButtonSeq2.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/BigButtonSeq2_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/BigButtonSeq2_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -837,14 +847,6 @@ struct BigButtonSeq2Widget : ModuleWidget {
 		addParam(createParamCentered<LEDButton>(Vec(colRulerT6 + 2, rowRuler10 + gateOffsetY / 2), module, BigButtonSeq2::SAMPLEHOLD_PARAM));
 		addChild(createLightCentered<MediumLight<GreenLight>>(Vec(colRulerT6 + 2, rowRuler10 + gateOffsetY / 2), module, BigButtonSeq2::SAMPLEHOLD_LIGHT));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((BigButtonSeq2*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((BigButtonSeq2*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelBigButtonSeq2 = createModel<BigButtonSeq2, BigButtonSeq2Widget>("Big-Button-Seq2");
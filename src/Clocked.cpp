@@ -11,6 +11,7 @@
 
 
 #include "ImpromptuModular.hpp"
+#include "ProfileUtil.hpp"
 
 
 class Clock {
@@ -224,7 +225,9 @@ struct Clocked : Module {
 	
 	
 	// Expander
-	float rightMessages[2][8] = {};// messages from expander
+	ExpanderMessage<8> rightMessages[2] = {};// messages from expander
+	ExpanderMessageReader<8> readerFromExpander;
+	ExpanderMessageWriter<1> writerToExpander;
 		
 
 	// Constants
@@ -274,6 +277,11 @@ struct Clocked : Module {
 	long notifyInfo[4] = {0l, 0l, 0l, 0l};// downward step counter when swing to be displayed, 0 when normal display
 	long cantRunWarning = 0l;// 0 when no warning, positive downward step counter timer when warning
 	RefreshCounter refresh;
+	float expanderPulseWidths[3] = {};// expander CVs, decoded only when they change
+	float expanderSwings[3] = {};
+#ifdef IM_PROFILE
+	ModuleProfiler profiler;
+#endif
 	float resetLight = 0.0f;
 	Trigger resetTrigger;
 	Trigger runTrigger;
@@ -305,20 +313,31 @@ struct Clocked : Module {
 	}
 	
 	void updatePulseSwingDelay() {
-		bool expanderPresent = (rightExpander.module && rightExpander.module->model == modelClockedExpander);
-		float *messagesFromExpander = (float*)rightExpander.consumerMessage;// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
+		ExpanderMessage<8> *messageFromExpander = readerFromExpander.read(rightExpander, rightExpander.module && rightExpander.module->model == modelClockedExpander);
+		for (int i = 0; i < 3; i++) {
+			if (messageFromExpander == NULL) {
+				expanderPulseWidths[i] = 0.0f;
+				expanderSwings[i] = 0.0f;
+			}
+			else {
+				if (readerFromExpander.hasChanged(i))
+					expanderPulseWidths[i] = messageFromExpander->values[i] / 10.0f;
+				if (readerFromExpander.hasChanged(i + 4))
+					expanderSwings[i] = messageFromExpander->values[i + 4] / 5.0f;
+			}
+		}
 		for (int i = 0; i < 4; i++) {
 			// Pulse Width
 			pulseWidth[i] = params[PW_PARAMS + i].getValue();
-			if (i < 3 && expanderPresent) {
-				pulseWidth[i] += (messagesFromExpander[i] / 10.0f);
+			if (i < 3) {
+				pulseWidth[i] += expanderPulseWidths[i];
 				pulseWidth[i] = clamp(pulseWidth[i], 0.0f, 1.0f);
 			}
 			
 			// Swing
 			swingAmount[i] = params[SWING_PARAMS + i].getValue();
-			if (i < 3 && expanderPresent) {
-				swingAmount[i] += (messagesFromExpander[i + 4] / 5.0f);
+			if (i < 3) {
+				swingAmount[i] += expanderSwings[i];
 				swingAmount[i] = clamp(swingAmount[i], -1.0f, 1.0f);
 			}
 		}
@@ -339,8 +358,8 @@ struct Clocked : Module {
 	Clocked() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 
-		rightExpander.producerMessage = rightMessages[0];
-		rightExpander.consumerMessage = rightMessages[1];
+		rightExpander.producerMessage = &rightMessages[0];
+		rightExpander.consumerMessage = &rightMessages[1];
 
 		configParam(RATIO_PARAMS + 0, (float)(bpmMin), (float)(bpmMax), 120.0f, "Master clock", " BPM");// must be a snap knob, code in step() assumes that a rounded value is read from the knob	(chaining considerations vs BPM detect)
 		configParam(RESET_PARAM, 0.0f, 1.0f, 0.0f, "Reset");
@@ -421,7 +440,7 @@ struct Clocked : Module {
 					newMasterLength = 1.0f;// 120 BPM
 			}
 			else
-				newMasterLength = 1.0f / std::pow(2.0f, inputs[BPM_INPUT].getVoltage());// bpm = 120*2^V, 2T = 120/bpm = 120/(120*2^V) = 1/2^V
+				newMasterLength = fastExp2(-inputs[BPM_INPUT].getVoltage());// bpm = 120*2^V, 2T = 120/bpm = 120/(120*2^V) = 1/2^V
 		}
 		else
 			newMasterLength = 120.0f / params[RATIO_PARAMS + 0].getValue();
@@ -546,6 +565,8 @@ struct Clocked : Module {
 	
 
 	void process(const ProcessArgs &args) override {
+		PROFILE_BEGIN(profiler, PROF_INPUTS);
+		
 		// Scheduled reset
 		if (scheduledReset) {
 			resetClocked(false);		
@@ -654,7 +675,7 @@ struct Clocked : Module {
 			}
 			// BPM CV method
 			else {// bpmDetectionMode not active
-				newMasterLength = clamp(1.0f / std::pow(2.0f, inputs[BPM_INPUT].getVoltage()), masterLengthMin, masterLengthMax);// bpm = 120*2^V, 2T = 120/bpm = 120/(120*2^V) = 1/2^V
+				newMasterLength = clamp(fastExp2(-inputs[BPM_INPUT].getVoltage()), masterLengthMin, masterLengthMax);// bpm = 120*2^V, 2T = 120/bpm = 120/(120*2^V) = 1/2^V
 				// no need to round since this clocked's master's BPM knob is a snap knob thus already rounded, and with passthru approach, no cumul error
 			}
 		}
@@ -671,6 +692,7 @@ struct Clocked : Module {
 		
 		
 		// main clock engine
+		PROFILE_NEXT(PROF_CLOCK);
 		if (running) {
 			// See if clocks finished their prescribed number of iteratios of double periods (and syncWait for sub) or 
 			//    if they were forced reset and if so, recalc and restart them
@@ -719,6 +741,7 @@ struct Clocked : Module {
 		}
 		
 		// outputs
+		PROFILE_NEXT(PROF_OUTPUTS);
 		for (int i = 0; i < 4; i++) {
 			outputs[CLK_OUTPUTS + i].setVoltage(clkOutputs[i]);
 		}
@@ -728,6 +751,7 @@ struct Clocked : Module {
 			
 		
 		// lights
+		PROFILE_NEXT(PROF_LIGHTS);
 		if (refresh.processLights()) {
 			// Reset light
 			lights[RESET_LIGHT].setSmoothBrightness(resetLight, (float)sampleTime * (RefreshCounter::displayRefreshStepSkips >> 2));	
@@ -760,10 +784,10 @@ struct Clocked : Module {
 				editingBpmMode = 0l;
 			
 			// To Expander
+			PROFILE_NEXT(PROF_EXPANDER);
 			if (rightExpander.module && rightExpander.module->model == modelClockedExpander) {
-				float *messageToExpander = (float*)(rightExpander.module->leftExpander.producerMessage);
-				messageToExpander[0] = (float)panelTheme;
-				rightExpander.module->leftExpander.messageFlipRequested = true;
+				writerToExpander.values[0] = (float)panelTheme;
+				writerToExpander.send(rightExpander.module, rightExpander.module->leftExpander);
 			}
 		}// lightRefreshCounter
 	}// process()
@@ -771,9 +795,9 @@ struct Clocked : Module {
 
 
 struct ClockedWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 
-	struct RatioDisplayWidget : TransparentWidget {
+	struct RatioDisplayWidget : CachedDisplayWidget {
 		Clocked *module;
 		int knobIndex;
 		std::shared_ptr<Font> font;
@@ -786,15 +810,7 @@ struct ClockedWidget : ModuleWidget {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 		
-		void draw(const DrawArgs &args) override {
-			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
-			nvgFontFaceId(args.vg, font->handle);
-			//nvgTextLetterSpacing(args.vg, 2.5);
-
-			Vec textPos = Vec(6, 24);
-			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
-			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
-			nvgFillColor(args.vg, textColor);
+		void printState(DisplayState &state) override {
 			if (module == NULL) {
 				if (knobIndex == 0)
 					snprintf(displayStr, 4, "120");
@@ -854,6 +870,18 @@ struct ClockedWidget : ModuleWidget {
 				}
 			}
 			displayStr[3] = 0;// more safety
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
+			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
+			nvgFontFaceId(args.vg, font->handle);
+			//nvgTextLetterSpacing(args.vg, 2.5);
+
+			Vec textPos = Vec(6, 24);
+			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
+			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
+			nvgFillColor(args.vg, textColor);
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};		
@@ -965,6 +993,16 @@ struct ClockedWidget : ModuleWidget {
 		expItem->model = modelClockedExpander;
 		expItem->posit = box.pos.plus(math::Vec(box.size.x,0));
 		menu->addChild(expItem);	
+
+#ifdef IM_PROFILE
+		menu->addChild(new MenuLabel());// empty line
+
+		ProfileMenuItem *profItem = createMenuItem<ProfileMenuItem>("Performance", RIGHT_ARROW);
+		profItem->profiler = &module->profiler;
+		profItem->moduleName = "Clocked";
+		profItem->moduleId = module->id;
+		menu->addChild(profItem);
+#endif
 	}	
 	
 	struct IMSmallKnobNotify : IMSmallKnob {
@@ -1016,8 +1054,10 @@ struct ClockedWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/Clocked.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/Clocked_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/Clocked_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -1125,14 +1165,6 @@ struct ClockedWidget : ModuleWidget {
 		addOutput(createDynamicPort<IMPort>(Vec(colRulerT5, rowRuler5), false, module, Clocked::CLK_OUTPUTS + 3, module ? &module->panelTheme : NULL));	
 	}
 	
-	void step() override {
-		if (module) {
-			panel->visible = ((((Clocked*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((Clocked*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
-	
 	void onHoverKey(const event::HoverKey& e) override {
 		if (e.action == GLFW_PRESS) {
 			if ( e.key == GLFW_KEY_SPACE && ((e.mods & RACK_MOD_MASK) == 0) ) {
@@ -23,49 +23,49 @@ struct ClockedExpander : Module {
 
 
 	// Expander
-	float leftMessages[2][1] = {};// messages from mother
+	ExpanderMessage<1> leftMessages[2] = {};// messages from mother
+	ExpanderMessageReader<1> readerFromMother;
+	ExpanderMessageWriter<8> writerToMother;
 
 
 	// No need to save, no reset
 	int panelTheme;
-	unsigned int expanderRefreshCounter = 0;
+	ExpanderRefreshCounter expanderRefresh;
 
 
 	ClockedExpander() {
 		config(0, NUM_INPUTS, 0, 0);
 		
-		leftExpander.producerMessage = leftMessages[0];
-		leftExpander.consumerMessage = leftMessages[1];
+		leftExpander.producerMessage = &leftMessages[0];
+		leftExpander.consumerMessage = &leftMessages[1];
 		
 		panelTheme = (loadDarkAsDefault() ? 1 : 0);
 	}
 
 
 	void process(const ProcessArgs &args) override {		
-		expanderRefreshCounter++;
-		if (expanderRefreshCounter >= expanderRefreshStepSkips) {
-			expanderRefreshCounter = 0;
+		if (expanderRefresh.process()) {
 			
 			bool motherPresent = (leftExpander.module && leftExpander.module->model == modelClocked);
 			if (motherPresent) {
 				// To Mother
-				float *messagesToMother = (float*)leftExpander.module->rightExpander.producerMessage;
 				for (int i = 0; i < 8; i++) {
-					messagesToMother[i] = inputs[i].getVoltage();
+					writerToMother.values[i] = inputs[i].getVoltage();
 				}
-				leftExpander.module->rightExpander.messageFlipRequested = true;
-				
-				// From Mother
-				float *messagesFromMother = (float*)leftExpander.consumerMessage;
-				panelTheme = clamp((int)(messagesFromMother[0] + 0.5f), 0, 1);			
-			}		
-		}// expanderRefreshCounter
+				expanderRefresh.update(writerToMother.send(leftExpander.module, leftExpander.module->rightExpander));
+			}
+			
+			// From Mother
+			ExpanderMessage<1> *messageFromMother = readerFromMother.read(leftExpander, motherPresent);
+			if (messageFromMother && readerFromMother.hasChanged(0))
+				panelTheme = clamp((int)(messageFromMother->values[0] + 0.5f), 0, 1);			
+		}// expanderRefresh
 	}// process()
 };
 
 
 struct ClockedExpanderWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 	
 	ClockedExpanderWidget(ClockedExpander *module) {
 		setModule(module);
@@ -73,8 +73,10 @@ struct ClockedExpanderWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/ClockedExpander.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/ClockedExpander_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/ClockedExpander_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -94,14 +96,6 @@ struct ClockedExpanderWidget : ModuleWidget {
 		addInput(createDynamicPort<IMPort>(Vec(colRulerExp, rowRulerExpTop + rowSpacingExp * 4), true, module, ClockedExpander::SWING_INPUTS + 1, module ? &module->panelTheme : NULL));
 		addInput(createDynamicPort<IMPort>(Vec(colRulerExp, rowRulerExpTop + rowSpacingExp * 5), true, module, ClockedExpander::SWING_INPUTS + 2, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((ClockedExpander*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((ClockedExpander*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelClockedExpander = createModel<ClockedExpander, ClockedExpanderWidget>("Clocked-Expander");
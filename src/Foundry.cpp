@@ -13,6 +13,7 @@
 #include <time.h>
 #include "FoundrySequencer.hpp"
 #include "comp/PianoKey.hpp"
+#include "ProfileUtil.hpp"
 
 
 struct Foundry : Module {	
@@ -89,7 +90,9 @@ struct Foundry : Module {
 									1 + // TRKCV_INPUT with connected
 									7 + // GATECV_INPUT, GATEPCV_INPUT, TIEDCV_INPUT, SLIDECV_INPUT, WRITE_SRC_INPUT, LEFTCV_INPUT, RIGHTCV_INPUT
 									2; // SYNC_SEQCV_PARAM, WRITEMODE_PARAM
-	float rightMessages[2][messageSize] = {};// messages from expander
+	ExpanderMessage<messageSize> rightMessages[2] = {};// messages from expander
+	ExpanderMessageReader<messageSize> readerFromExpander;
+	ExpanderMessageWriter<1 + 2 + Sequencer::NUM_TRACKS> writerToExpander;
 		
 	// Constants
 	enum EditPSDisplayStateIds {DISP_NORMAL, DISP_MODE_SEQ, DISP_MODE_SONG, DISP_LEN, DISP_REPS, DISP_TRANSPOSE, DISP_ROTATE, DISP_PPQN, DISP_DELAY, DISP_COPY_SEQ, DISP_PASTE_SEQ, DISP_COPY_SONG, DISP_PASTE_SONG, DISP_COPY_SONG_CUST};
@@ -128,6 +131,12 @@ struct Foundry : Module {
 	// No need to save, no reset
 	int cpSongStart;// no need to initialize
 	RefreshCounter refresh;
+	int expanderTrack = 0;// track CV from expander, decoded only when it changes
+	int expanderSeqs[Sequencer::NUM_TRACKS] = {};// seq CVs from expander, decoded only when they change (-1 for TrigIncr)
+	int expanderSeqCVmethod = -1;// seqCVmethod of the decoded expanderSeqs
+#ifdef IM_PROFILE
+	ModuleProfiler profiler;
+#endif
 	float resetLight = 0.0f;
 	int sequenceKnob = 0;
 	int velocityKnob = 0;
@@ -138,7 +147,7 @@ struct Foundry : Module {
 	Trigger runningTrigger;
 	Trigger clockTriggers[SequencerKernel::MAX_STEPS];
 	dsp::BooleanTrigger keyTrigger;
-	Trigger octTriggers[7];
+	TriggerBank<7> octTriggers;
 	Trigger gate1Trigger;
 	Trigger tiedTrigger;
 	Trigger gateProbTrigger;
@@ -149,7 +158,7 @@ struct Foundry : Module {
 	Trigger modeTrigger;
 	Trigger rotateTrigger;
 	Trigger transposeTrigger;
-	Trigger stepTriggers[SequencerKernel::MAX_STEPS];
+	TriggerBank<SequencerKernel::MAX_STEPS> stepTriggers;
 	Trigger clkResTrigger;
 	Trigger trackIncTrigger;
 	Trigger trackDecTrigger;	
@@ -167,6 +176,29 @@ struct Foundry : Module {
 	
 	inline bool isEditingSequence(void) {return params[EDIT_PARAM].getValue() > 0.5f;}
 	inline bool isEditingGates(void) {return params[KEY_GATE_PARAM].getValue() < 0.5f;}
+	
+	void decodeExpanderMessage(const float *messagesFromExpander) {
+		// called on each read, since hasChanged() only holds for the read that received the changes
+		float trkCVin = messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 0];
+		if (readerFromExpander.hasChanged(Sequencer::NUM_TRACKS * 2 + 0) && !std::isnan(trkCVin))
+			expanderTrack = (int)( trkCVin * (2.0f * (float)Sequencer::NUM_TRACKS - 1.0f) / 10.0f + 0.5f );
+		bool methodChanged = (seqCVmethod != expanderSeqCVmethod);
+		expanderSeqCVmethod = seqCVmethod;
+		for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
+			float seqCVin = messagesFromExpander[Sequencer::NUM_TRACKS + trkn];
+			if ((!methodChanged && !readerFromExpander.hasChanged(Sequencer::NUM_TRACKS + trkn)) || std::isnan(seqCVin))
+				continue;
+			if (seqCVmethod == 0) {// 0-10 V
+				expanderSeqs[trkn] = clamp((int)(seqCVin * ((float)SequencerKernel::MAX_SEQS - 1.0f) / 10.0f + 0.5f ), 0, SequencerKernel::MAX_SEQS - 1);
+			}
+			else if (seqCVmethod == 1) {// C2-D7#
+				expanderSeqs[trkn] = clamp((int)( (seqCVin + 2.0f) * 12.0f + 0.5f ), 0, SequencerKernel::MAX_SEQS - 1);
+			}
+			else {// TrigIncr, processed with the other inputs
+				expanderSeqs[trkn] = -1;
+			}
+		}
+	}
 	inline int getCPMode(void) {
 		if (params[CPMODE_PARAM].getValue() > 1.5f) return 2000;// this means end, and code should never loop up to this count. This value should be bigger than max(MAX_STEPS, MAX_PHRASES)
 		if (params[CPMODE_PARAM].getValue() < 0.5f) return 4;
@@ -177,14 +209,9 @@ struct Foundry : Module {
 	Foundry() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		
-		rightExpander.producerMessage = rightMessages[0];
-		rightExpander.consumerMessage = rightMessages[1];
+		rightExpander.producerMessage = &rightMessages[0];
+		rightExpander.consumerMessage = &rightMessages[1];
 		
-		// must init those that have no-connect info to non-connected, or else mother may read 0.0 init value if ever refresh limiters make it such that after a connection of expander the mother reads before the first pass through the expander's writing code, and this may do something undesired (ex: change track in Foundry on expander connected while track CV jack is empty)
-		for (int i = 0; i < (Sequencer::NUM_TRACKS * 2 + 1); i++) {
-			rightMessages[1][i] = std::numeric_limits<float>::quiet_NaN();
-		}
-
 		char strBuf[32];
 		const int numX = SequencerKernel::MAX_STEPS / 2;
 		for (int x = 0; x < numX; x++) {
@@ -424,11 +451,16 @@ struct Foundry : Module {
 		const float sampleRate = args.sampleRate;
 		static const float revertDisplayTime = 0.7f;// seconds
 		
-		bool expanderPresent = (rightExpander.module && rightExpander.module->model == modelFoundryExpander);
-		float *messagesFromExpander = (float*)rightExpander.consumerMessage;// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
+		PROFILE_BEGIN(profiler, PROF_EXPANDER);
+		ExpanderMessage<messageSize> *messageFromExpander = readerFromExpander.read(rightExpander, rightExpander.module && rightExpander.module->model == modelFoundryExpander);
+		bool expanderPresent = (messageFromExpander != NULL);
+		float *messagesFromExpander = (expanderPresent ? messageFromExpander->values : NULL);
+		if (expanderPresent)
+			decodeExpanderMessage(messagesFromExpander);
 		
 		
 		//********** Buttons, knobs, switches and inputs **********
+		PROFILE_NEXT(PROF_INPUTS);
 		
 		bool editingSequence = isEditingSequence();
 		
@@ -448,11 +480,9 @@ struct Foundry : Module {
 		if (refresh.processInputs()) {
 			// Track CV input
 			if (expanderPresent) {
-				float trkCVin = messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 0];
-				if (!std::isnan(trkCVin)) {
-					int newTrk = (int)( trkCVin * (2.0f * (float)Sequencer::NUM_TRACKS - 1.0f) / 10.0f + 0.5f );
-					seq.setTrackIndexEdit(abs(newTrk));
-					multiTracks = (newTrk > 3);
+				if (!std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 0])) {
+					seq.setTrackIndexEdit(abs(expanderTrack));
+					multiTracks = (expanderTrack > 3);
 				}
 			}
 			
@@ -461,16 +491,8 @@ struct Foundry : Module {
 				if (expanderPresent) {
 					float seqCVin = messagesFromExpander[Sequencer::NUM_TRACKS + trkn];
 					if (!std::isnan(seqCVin)) {
-						int newSeq = -1;
-						if (seqCVmethod == 0) {// 0-10 V
-							newSeq = (int)(seqCVin * ((float)SequencerKernel::MAX_SEQS - 1.0f) / 10.0f + 0.5f );
-							newSeq = clamp(newSeq, 0, SequencerKernel::MAX_SEQS - 1);
-						}
-						else if (seqCVmethod == 1) {// C2-D7#
-							newSeq = (int)( (seqCVin + 2.0f) * 12.0f + 0.5f );
-							newSeq = clamp(newSeq, 0, SequencerKernel::MAX_SEQS - 1);
-						}
-						else if (seqCVTriggers[trkn].process(seqCVin)) {// TrigIncr
+						int newSeq = expanderSeqs[trkn];// decoded 0-10 V or C2-D7#
+						if (seqCVmethod == 2 && seqCVTriggers[trkn].process(seqCVin)) {// TrigIncr
 							newSeq = clamp(seq.getSeqIndexEdit(trkn) + 1, 0, SequencerKernel::MAX_SEQS - 1);
 						}
 						if (newSeq >= 0) {
@@ -600,11 +622,8 @@ struct Foundry : Module {
 			}
 
 			// Step button presses
-			int stepPressed = -1;
-			for (int i = 0; i < SequencerKernel::MAX_STEPS; i++) {
-				if (stepTriggers[i].process(params[STEP_PHRASE_PARAMS + i].getValue()))
-					stepPressed = i;
-			}
+			uint64_t stepsPressed = stepTriggers.process(params, STEP_PHRASE_PARAMS);
+			int stepPressed = (stepsPressed != 0 ? 63 - __builtin_clzll(stepsPressed) : -1);// the last one when many are pressed
 			if (stepPressed != -1) {
 				if (displayState == DISP_LEN) {
 					if (editingSequence) {
@@ -880,13 +899,13 @@ struct Foundry : Module {
 				
 	
 			// Octave buttons
-			for (int octn = 0; octn < 7; octn++) {
-				if (octTriggers[octn].process(params[OCTAVE_PARAM + octn].getValue())) {
-					if (editingSequence) {
-						displayState = DISP_NORMAL;
-						if (seq.applyNewOctave(6 - octn, multiSteps ? cpSeqLength : 1, sampleRate, multiTracks))
-							tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-					}
+			uint64_t octsPressed = octTriggers.process(params, OCTAVE_PARAM);
+			for (; octsPressed != 0; octsPressed &= (octsPressed - 1)) {
+				int octn = __builtin_ctzll(octsPressed);
+				if (editingSequence) {
+					displayState = DISP_NORMAL;
+					if (seq.applyNewOctave(6 - octn, multiSteps ? cpSeqLength : 1, sampleRate, multiTracks))
+						tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 				}
 			}
 			
@@ -943,6 +962,7 @@ struct Foundry : Module {
 		
 		
 		//********** Clock and reset **********
+		PROFILE_NEXT(PROF_CLOCK);
 		
 		// Clock
 		if (running && clockIgnoreOnReset == 0l) {
@@ -975,6 +995,7 @@ struct Foundry : Module {
 
 		
 		//********** Outputs and lights **********
+		PROFILE_NEXT(PROF_OUTPUTS);
 				
 		
 		
@@ -987,6 +1008,7 @@ struct Foundry : Module {
 		}
 
 		// lights
+		PROFILE_NEXT(PROF_LIGHTS);
 		if (refresh.processLights()) {
 			// Prepare values to visualize
 			StepAttributes attributesVisual;
@@ -1192,15 +1214,15 @@ struct Foundry : Module {
 			}
 			
 			// To Expander
+			PROFILE_NEXT(PROF_EXPANDER);
 			if (rightExpander.module && rightExpander.module->model == modelFoundryExpander) {
-				float *messagesToExpander = (float*)(rightExpander.module->leftExpander.producerMessage);
-				messagesToExpander[0] = (float)panelTheme;
-				messagesToExpander[1] = (((writeMode & 0x2) == 0) && editingSequence) ? 1.0f : 0.0f;// lights[WRITE_SEL_LIGHTS + 0].setBrightness()
-				messagesToExpander[2] = (((writeMode & 0x1) == 0) && editingSequence) ? 1.0f : 0.0f;// lights[WRITE_SEL_LIGHTS + 1].setBrightness()
+				writerToExpander.values[0] = (float)panelTheme;
+				writerToExpander.values[1] = (((writeMode & 0x2) == 0) && editingSequence) ? 1.0f : 0.0f;// lights[WRITE_SEL_LIGHTS + 0].setBrightness()
+				writerToExpander.values[2] = (((writeMode & 0x1) == 0) && editingSequence) ? 1.0f : 0.0f;// lights[WRITE_SEL_LIGHTS + 1].setBrightness()
 				for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
-					messagesToExpander[3 + trkn] = (editingSequence && ((writeMode & 0x1) == 0) && (multiTracks || seq.getTrackIndexEdit() == trkn)) ? 1.0f : 0.0f;
+					writerToExpander.values[3 + trkn] = (editingSequence && ((writeMode & 0x1) == 0) && (multiTracks || seq.getTrackIndexEdit() == trkn)) ? 1.0f : 0.0f;
 				}	
-				rightExpander.module->leftExpander.messageFlipRequested = true;
+				writerToExpander.send(rightExpander.module, rightExpander.module->leftExpander);
 			}
 		}// lightRefreshCounter
 				
@@ -1231,13 +1253,14 @@ struct Foundry : Module {
 
 
 struct FoundryWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 	
 	template <int NUMCHAR>
-	struct DisplayWidget : TransparentWidget {// a centered display, must derive from this
+	struct DisplayWidget : CachedDisplayWidget {// a centered display, must derive from this
 		Foundry *module;
 		std::shared_ptr<Font> font;
 		char displayStr[NUMCHAR + 1];
+		char overlayChar = 0;// returned by printText()
 		static const int textFontSize = 15;
 		static constexpr float textOffsetY = 19.9f; // 18.2f for 14 pt, 19.7f for 15pt
 		
@@ -1253,7 +1276,13 @@ struct FoundryWidget : ModuleWidget {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 		
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			overlayChar = printText();
+			state += displayStr;
+			state += overlayChar;
+		}
+		
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, textFontSize);
 			nvgFontFaceId(args.vg, font->handle);
 			nvgTextLetterSpacing(args.vg, -0.4);
@@ -1263,12 +1292,10 @@ struct FoundryWidget : ModuleWidget {
 			std::string initString(NUMCHAR,'~');
 			nvgText(args.vg, textPos.x, textPos.y, initString.c_str(), NULL);
 			nvgFillColor(args.vg, textColor);
-			char overlayChar = printText();
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 			if (overlayChar != 0) {
-				displayStr[0] = overlayChar;
-				displayStr[1] = 0;
-				nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
+				char overlayStr[2] = {overlayChar, 0};
+				nvgText(args.vg, textPos.x, textPos.y, overlayStr, NULL);
 			}
 		}
 		
@@ -1276,16 +1303,18 @@ struct FoundryWidget : ModuleWidget {
 	};
 	
 	struct VelocityDisplayWidget : DisplayWidget<4> {
+		NoteLabelCache noteLabel;
+		
 		VelocityDisplayWidget(Vec _pos, Vec _size, Foundry *_module) : DisplayWidget(_pos, _size, _module) {};
 
-		void draw(const DrawArgs &args) override {
+		void drawDisplay(const DrawArgs &args) override {
 			static const float offsetXfrac = 3.5f;
 			NVGcolor textColor = prepareDisplay(args.vg, &box, textFontSize);
 			nvgFontFaceId(args.vg, font->handle);
 			nvgTextLetterSpacing(args.vg, -0.4);
 
 			Vec textPos = Vec(6.3f, textOffsetY);
-			char useRed = printText();
+			char useRed = overlayChar;// printText() returns the color instead of an overlay char for this display
 			if (useRed == 1)
 				textColor = nvgRGB(0xE0, 0xD0, 0x30);
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
@@ -1296,8 +1325,8 @@ struct FoundryWidget : ModuleWidget {
 				textColor = nvgRGB(0xFF, 0x2C, 0x20);
 			nvgFillColor(args.vg, textColor);
 			nvgText(args.vg, textPos.x + offsetXfrac, textPos.y, &displayStr[1], NULL);
-			displayStr[1] = 0;
-			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
+			char firstStr[2] = {displayStr[0], 0};
+			nvgText(args.vg, textPos.x, textPos.y, firstStr, NULL);
 		}
 
 		char printText() override {
@@ -1336,7 +1365,7 @@ struct FoundryWidget : ModuleWidget {
 						unsigned int velocityDisp = (unsigned)(attributesVisual.getVelocityVal());
 						if (module->velocityMode > 0) {// velocity is 0-127 or semitone
 							if (module->velocityMode == 2)// semitone
-								printNote(((float)velocityDisp)/12.0f - (module->velocityBipol ? 5.0f : 0.0f), &displayStr[1], true);// given str pointer must be 4 chars (3 display and one end of string)
+								noteLabel.print(((float)velocityDisp)/12.0f - (module->velocityBipol ? 5.0f : 0.0f), &displayStr[1], true);// given str pointer must be 4 chars (3 display and one end of string)
 							else// 0-127
 								snprintf(displayStr, 5, " %3u", std::min(velocityDisp, (unsigned int)127));
 							displayStr[0] = displayStr[1];
@@ -1707,6 +1736,16 @@ struct FoundryWidget : ModuleWidget {
 		expItem->model = modelFoundryExpander;
 		expItem->posit = box.pos.plus(math::Vec(box.size.x,0));
 		menu->addChild(expItem);	
+
+#ifdef IM_PROFILE
+		menu->addChild(new MenuLabel());// empty line
+
+		ProfileMenuItem *profItem = createMenuItem<ProfileMenuItem>("Performance", RIGHT_ARROW);
+		profItem->profiler = &module->profiler;
+		profItem->moduleName = "Foundry";
+		profItem->moduleId = module->id;
+		menu->addChild(profItem);
+#endif
 	}	
 		
 	struct CKSSNotify : CKSSNoRandom {
@@ -1784,8 +1823,8 @@ struct FoundryWidget : ModuleWidget {
 					if (module->isEditingSequence()) {
 						for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
 							bool expanderPresent = (module->rightExpander.module && module->rightExpander.module->model == modelFoundryExpander);
-							float *messagesFromExpander = (float*)module->rightExpander.consumerMessage;// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
-							if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS + trkn])) {
+							ExpanderMessage<Foundry::messageSize> *messageFromExpander = (ExpanderMessage<Foundry::messageSize>*)module->rightExpander.consumerMessage;
+							if (!expanderPresent || !messageFromExpander->isValid() || std::isnan(messageFromExpander->values[Sequencer::NUM_TRACKS + trkn])) {
 								if (module->multiTracks || (trkn == module->seq.getTrackIndexEdit())) {
 									module->seq.setSeqIndexEdit(0, trkn);
 								}
@@ -1844,8 +1883,10 @@ struct FoundryWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/Foundry.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/Foundry_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/Foundry_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -2113,14 +2154,6 @@ struct FoundryWidget : ModuleWidget {
 		addInput(createDynamicPortCentered<IMPort>(Vec(columnRulerB11, rowRulerBHigh), true, module, Foundry::RUNCV_INPUT, module ? &module->panelTheme : NULL));
 		addInput(createDynamicPortCentered<IMPort>(Vec(columnRulerB11, rowRulerBLow), true, module, Foundry::RESET_INPUT, module ? &module->panelTheme : NULL));	
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((Foundry*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((Foundry*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelFoundry = createModel<Foundry, FoundryWidget>("Foundry");
@@ -41,12 +41,14 @@ struct FoundryExpander : Module {
 	};
 	
 	// Expander
-	float leftMessages[2][1 + 2 + Sequencer::NUM_TRACKS] = {};// messages from mother
+	ExpanderMessage<1 + 2 + Sequencer::NUM_TRACKS> leftMessages[2] = {};// messages from mother
+	ExpanderMessageReader<1 + 2 + Sequencer::NUM_TRACKS> readerFromMother;
+	ExpanderMessageWriter<NUM_INPUTS + 2> writerToMother;
 
 
 	// No need to save
 	int panelTheme;
-	unsigned int expanderRefreshCounter = 0;	
+	ExpanderRefreshCounter expanderRefresh;	
 
 
 	FoundryExpander() {
@@ -55,23 +57,20 @@ struct FoundryExpander : Module {
 		configParam(SYNC_SEQCV_PARAM, 0.0f, 1.0f, 0.0f, "Sync Seq#");// 1.0f is top position
 		configParam(WRITEMODE_PARAM, 0.0f, 1.0f, 0.0f, "Write mode");
 	
-		leftExpander.producerMessage = leftMessages[0];
-		leftExpander.consumerMessage = leftMessages[1];
+		leftExpander.producerMessage = &leftMessages[0];
+		leftExpander.consumerMessage = &leftMessages[1];
 		
 		panelTheme = (loadDarkAsDefault() ? 1 : 0);
 	}
 
 
 	void process(const ProcessArgs &args) override {		
-		expanderRefreshCounter++;
-		if (expanderRefreshCounter >= expanderRefreshStepSkips) {
-			expanderRefreshCounter = 0;
+		if (expanderRefresh.process()) {
 			
 			bool motherPresent = leftExpander.module && leftExpander.module->model == modelFoundry;
-			float *messagesFromMother = (float*)leftExpander.consumerMessage;// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
 			if (motherPresent) {
 				// To Mother
-				float *messagesToMother = (float*)leftExpander.module->rightExpander.producerMessage;
+				float *messagesToMother = writerToMother.values;
 				int i = 0;
 				for (; i < GATECV_INPUT; i++) {
 					messagesToMother[i] = (inputs[i].isConnected() ? inputs[i].getVoltage() : std::numeric_limits<float>::quiet_NaN());
@@ -81,25 +80,35 @@ struct FoundryExpander : Module {
 				}
 				messagesToMother[i++] = params[SYNC_SEQCV_PARAM].getValue();
 				messagesToMother[i++] = params[WRITEMODE_PARAM].getValue();
-				leftExpander.module->rightExpander.messageFlipRequested = true;
-
-				// From Mother
-				panelTheme = clamp((int)(messagesFromMother[0] + 0.5f), 0, 1);
+				expanderRefresh.update(writerToMother.send(leftExpander.module, leftExpander.module->rightExpander));
 			}		
 
 			// From Mother
-			lights[WRITE_SEL_LIGHTS + 0].setBrightness(motherPresent ? messagesFromMother[1] : 0.0f);
-			lights[WRITE_SEL_LIGHTS + 1].setBrightness(motherPresent ? messagesFromMother[2] : 0.0f);			
-			for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
-				lights[WRITECV2_LIGHTS + trkn].setBrightness(motherPresent ? messagesFromMother[trkn + 3] : 0.0f);
-			}	
-		}// expanderRefreshCounter
+			ExpanderMessage<1 + 2 + Sequencer::NUM_TRACKS> *messageFromMother = readerFromMother.read(leftExpander, motherPresent);
+			if (messageFromMother && readerFromMother.hasChanged(0))
+				panelTheme = clamp((int)(messageFromMother->values[0] + 0.5f), 0, 1);
+			if (messageFromMother == NULL) {
+				lights[WRITE_SEL_LIGHTS + 0].setBrightness(0.0f);
+				lights[WRITE_SEL_LIGHTS + 1].setBrightness(0.0f);			
+				for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
+					lights[WRITECV2_LIGHTS + trkn].setBrightness(0.0f);
+				}	
+			}
+			else if (readerFromMother.changed != 0) {// lights only change with a new message
+				float *messagesFromMother = messageFromMother->values;
+				lights[WRITE_SEL_LIGHTS + 0].setBrightness(messagesFromMother[1]);
+				lights[WRITE_SEL_LIGHTS + 1].setBrightness(messagesFromMother[2]);			
+				for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
+					lights[WRITECV2_LIGHTS + trkn].setBrightness(messagesFromMother[trkn + 3]);
+				}	
+			}
+		}// expanderRefresh
 	}// process()
 };
 
 
 struct FoundryExpanderWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 	
 	FoundryExpanderWidget(FoundryExpander *module) {
 		setModule(module);
@@ -107,8 +116,10 @@ struct FoundryExpanderWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/FoundryExpander.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/FoundryExpander_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/FoundryExpander_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -177,14 +188,6 @@ struct FoundryExpanderWidget : ModuleWidget {
 		
 		addInput(createDynamicPortCentered<IMPort>(Vec(colRulerExp + colOffsetX, rowRulerBLow), true, module, FoundryExpander::WRITE_SRC_INPUT, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((FoundryExpander*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((FoundryExpander*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelFoundryExpander = createModel<FoundryExpander, FoundryExpanderWidget>("Foundry-Expander");
@@ -9,18 +9,6 @@
 const std::string SequencerKernel::modeLabels[NUM_MODES] = {"FWD", "REV", "PPG", "PEN", "BRN", "RND", "TKA"};
 
 
-const uint64_t SequencerKernel::advGateHitMaskLow[NUM_GATES] = 
-{0x0000000000FFFFFF, 0x0000FFFF0000FFFF, 0x0000FFFFFFFFFFFF, 0x0000FFFF00000000, 0xFFFFFFFFFFFFFFFF, 0xFFFFFFFFFFFFFFFF, 
-//				25%					TRI		  			50%					T23		  			75%					FUL		
- 0x000000000000FFFF, 0xFFFF000000FFFFFF, 0x0000FFFF00000000, 0xFFFF000000000000, 0x0000000000000000, 0};
-//  			TR1 				DUO		  			TR2 	     		D2		  			TR3  TRIG		
-const uint64_t SequencerKernel::advGateHitMaskHigh[NUM_GATES] = 
-{0x0000000000000000, 0x000000000000FFFF, 0x0000000000000000, 0x000000000000FFFF, 0x00000000000000FF, 0x00000000FFFFFFFF, 
-//				25%					TRI		  			50%					T23		  			75%					FUL		
- 0x0000000000000000, 0x00000000000000FF, 0x0000000000000000, 0x00000000000000FF, 0x000000000000FFFF, 0};
-//  			TR1 				DUO		  			TR2 	     		D2		  			TR3  TRIG		
-
-
 void SequencerKernel::construct(int _id, SequencerKernel *_masterKernel, bool* _holdTiedNotesPtr, int* _stopAtEndOfSongPtr) {// don't want regaular constructor mechanism
 	id = _id;
 	ids = "id" + std::to_string(id) + "_";
@@ -560,11 +548,7 @@ void SequencerKernel::calcGateCode(bool editingSequence) {// uses stepIndexRun a
 				gateCode = (ppqnCount == 0 ? 3 : 0);// trig on first ppqnCount
 			}
 			else {
-				uint64_t shiftAmt = ppqnCount * (96 / ppsFiltered);
-				if (shiftAmt >= 64)
-					gateCode = (int)((advGateHitMaskHigh[gateType] >> (shiftAmt - (uint64_t)64)) & (uint64_t)0x1);
-				else
-					gateCode = (int)((advGateHitMaskLow[gateType] >> shiftAmt) & (uint64_t)0x1);
+				gateCode = gatePatterns[gateType].getAdvGate(ppqnCount, ppsFiltered, GatePattern::TICKS);
 			}
 		}
 	}
@@ -7,6 +7,7 @@
 
 
 #include "ImpromptuModular.hpp"
+#include "GatePatternUtil.hpp"
 
 
 class StepAttributes {
@@ -164,8 +165,6 @@ class SequencerKernel {
 	
 	// Gate types
 	static const int NUM_GATES = 12;	
-	static const uint64_t advGateHitMaskLow[NUM_GATES];		
-	static const uint64_t advGateHitMaskHigh[NUM_GATES];
 
 	// Constants
 	static constexpr float INIT_CV = 0.0f;
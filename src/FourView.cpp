@@ -89,13 +89,14 @@ struct FourView : Module {
 
 
 struct FourViewWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 
-	struct NotesDisplayWidget : TransparentWidget {
+	struct NotesDisplayWidget : CachedDisplayWidget {
 		FourView* module;
 		int baseIndex;
 		std::shared_ptr<Font> font;
 		char text[4];
+		NoteLabelCache noteLabel;
 
 		NotesDisplayWidget(Vec _pos, Vec _size, FourView* _module, int _baseIndex) {
 			box.size = _size;
@@ -108,13 +109,18 @@ struct FourViewWidget : ModuleWidget {
 		void cvToStr() {
 			if (module != NULL && module->inputs[FourView::CV_INPUTS + baseIndex].isConnected()) {
 				float cvVal = module->inputs[FourView::CV_INPUTS + baseIndex].getVoltage();
-				printNote(cvVal, text, module->showSharp);
+				noteLabel.print(cvVal, text, module->showSharp);
 			}
 			else
 				snprintf(text, 4," - ");
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			cvToStr();
+			state += text;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 17);
 			nvgFontFaceId(args.vg, font->handle);
 			nvgTextLetterSpacing(args.vg, -1.5);
@@ -123,7 +129,6 @@ struct FourViewWidget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
 			nvgFillColor(args.vg, textColor);
-			cvToStr();
 			nvgText(args.vg, textPos.x, textPos.y, text, NULL);
 		}
 	};
@@ -176,8 +181,10 @@ struct FourViewWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/FourView.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/FourView_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/FourView_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -214,14 +221,6 @@ struct FourViewWidget : ModuleWidget {
 		addOutput(createDynamicPortCentered<IMPort>(Vec(centerX + offsetX, posY2), false, module, FourView::CV_OUTPUTS + 2, module ? &module->panelTheme : NULL));
 		addOutput(createDynamicPortCentered<IMPort>(Vec(centerX + offsetX, posY2 + spacingY2), false, module, FourView::CV_OUTPUTS + 3, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((FourView*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((FourView*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelFourView = createModel<FourView, FourViewWidget>("Four-View");
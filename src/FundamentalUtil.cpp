@@ -36,6 +36,110 @@ void LadderFilter::process(float input, float dt) {
 
 
 
+// Wavetables
+
+SineTable::SineTable() {
+	for (int i = 0; i < TABLE_SIZE + 16; i++) {
+		table[i] = (float)std::sin(2.0 * M_PI * (double)(i % TABLE_SIZE) / TABLE_SIZE);
+	}
+}
+
+
+void MipMappedWaveTable::init(const float *source) {
+	// harmonic analysis of the source cycle (done once, so a plain DFT is good enough)
+	static const int NUM_HARM = TABLE_SIZE / 2 - 1;
+	std::vector<double> cosTable(TABLE_SIZE);
+	for (int n = 0; n < TABLE_SIZE; n++) {
+		cosTable[n] = std::cos(2.0 * M_PI * (double)n / TABLE_SIZE);
+	}
+	std::vector<double> a(NUM_HARM + 1, 0.0);
+	std::vector<double> b(NUM_HARM + 1, 0.0);
+	double dc = 0.0;
+	for (int n = 0; n < TABLE_SIZE; n++) {
+		dc += source[n];
+	}
+	dc /= TABLE_SIZE;
+	for (int k = 1; k <= NUM_HARM; k++) {
+		for (int n = 0; n < TABLE_SIZE; n++) {
+			int idx = (k * n) % TABLE_SIZE;
+			a[k] += source[n] * cosTable[idx];
+			b[k] += source[n] * cosTable[(idx + TABLE_SIZE * 3 / 4) % TABLE_SIZE];// sin(x) = cos(x - pi/2)
+		}
+		a[k] *= 2.0 / TABLE_SIZE;
+		b[k] *= 2.0 / TABLE_SIZE;
+	}
+	
+	// resynthesis, from the narrowest level (one harmonic) to the widest, adding one octave of harmonics per level
+	std::vector<double> acc(TABLE_SIZE, dc);
+	int kStart = 1;
+	for (int level = NUM_LEVELS - 1; level >= 0; level--) {
+		int kEnd = std::min((TABLE_SIZE / 2) >> level, NUM_HARM);
+		for (int k = kStart; k <= kEnd; k++) {
+			for (int n = 0; n < TABLE_SIZE; n++) {
+				int idx = (k * n) % TABLE_SIZE;
+				acc[n] += a[k] * cosTable[idx] + b[k] * cosTable[(idx + TABLE_SIZE * 3 / 4) % TABLE_SIZE];
+			}
+		}
+		kStart = kEnd + 1;
+		for (int i = 0; i < ROW_SIZE; i++) {
+			levels[level][i] = (float)acc[i % TABLE_SIZE];
+		}
+	}
+}
+
+
+WaveTableBank::WaveTableBank() {
+	static const int N = MipMappedWaveTable::TABLE_SIZE;
+	std::vector<float> source(N);
+	
+	// analog shapes, same as the oversampled VCO (see VoltageControlledOscillator::process())
+	for (int n = 0; n < N; n++) {
+		float phase = (float)n / N;
+		if (phase < 0.5f)
+			source[n] = 1.f - 16.f * std::pow(phase - 0.25f, 2);
+		else
+			source[n] = -1.f + 16.f * std::pow(phase - 0.75f, 2);
+		source[n] *= 1.08f;
+	}
+	sinAnalog.init(source.data());
+	for (int n = 0; n < N; n++) {
+		source[n] = 1.25f * interpolateLinear(triTable, (float)n / N * 2047.f);
+	}
+	triAnalog.init(source.data());
+	for (int n = 0; n < N; n++) {
+		source[n] = 1.66f * interpolateLinear(sawTable, (float)n / N * 2047.f);
+	}
+	sawAnalog.init(source.data());
+	
+	// digital shapes
+	for (int n = 0; n < N; n++) {
+		float phase = (float)n / N;
+		if (phase < 0.25f)
+			source[n] = 4.f * phase;
+		else if (phase < 0.75f)
+			source[n] = 2.f - 4.f * phase;
+		else
+			source[n] = -4.f + 4.f * phase;
+	}
+	triDigital.init(source.data());
+	for (int n = 0; n < N; n++) {
+		float phase = (float)n / N;
+		if (phase < 0.5f)
+			source[n] = 2.f * phase;
+		else
+			source[n] = -2.f + 2.f * phase;
+	}
+	sawDigital.init(source.data());
+}
+
+
+const WaveTableBank &getWaveTableBank() {
+	static const WaveTableBank bank;
+	return bank;
+}
+
+
+
 // From Fundamental VCO.cpp
 
 void VoltageControlledOscillator::setPitch(float pitchKnob, float pitchCv) {
@@ -52,7 +156,7 @@ void VoltageControlledOscillator::setPitch(float pitchKnob, float pitchCv) {
 	}
 	pitch += pitchCv;
 	// Note C4
-	freq = 261.626f * std::pow(2.0f, pitch / 12.0f);
+	freq = voltToFreq(pitch * (1.0f / 12.0f), 261.626f);
 };
 
 void VoltageControlledOscillator::setPulseWidth(float pulseWidth) {
@@ -91,6 +195,11 @@ void VoltageControlledOscillator::process(float deltaTime, float syncValue) {
 	if (syncDirection)
 		deltaPhase *= -1.0f;
 
+	if (wavetable) {
+		processWaveTable(deltaPhase, syncIndex, deltaTime);
+		return;
+	}
+
 	sqrFilter.setCutoff(40.0f * deltaTime);
 
 	for (int i = 0; i < OVERSAMPLE; i++) {
@@ -149,6 +258,46 @@ void VoltageControlledOscillator::process(float deltaTime, float syncValue) {
 	}
 };
 
+void VoltageControlledOscillator::processWaveTable(float deltaPhase, int syncIndex, float deltaTime) {
+	// one sample per step, band-limiting is done by the choice of mip level instead of oversampling
+	if (syncIndex >= 0) {
+		if (soft) {
+			syncDirection = !syncDirection;
+			deltaPhase *= -1.0f;
+		}
+		else {
+			phase = 0.0f;
+		}
+	}
+	
+	int level = MipMappedWaveTable::getLevel(deltaPhase);
+	float pwPhase = phase + 1.5f - pw;
+	pwPhase -= std::floor(pwPhase);
+	float sqrPhase = phase + 0.5f;
+	sqrPhase -= std::floor(sqrPhase);
+	if (analog) {
+		sinValue = tables->sinAnalog.process(level, phase);
+		triValue = tables->triAnalog.process(level, phase);
+		sawValue = tables->sawAnalog.process(level, phase);
+	}
+	else {
+		sinValue = tables->sine.process(phase);
+		triValue = tables->triDigital.process(level, phase);
+		sawValue = tables->sawDigital.process(level, phase);
+	}
+	// pulse as the difference of two band-limited saws
+	sqrValue = tables->sawDigital.process(level, pwPhase) - tables->sawDigital.process(level, sqrPhase) + 2.0f * pw - 1.0f;
+	if (analog) {
+		sqrFilter.setCutoff(40.0f * deltaTime * OVERSAMPLE);// same corner frequency as the oversampled filter
+		sqrFilter.process(sqrValue);
+		sqrValue = 0.71f * sqrFilter.highpass();
+	}
+	
+	// Advance phase
+	phase += deltaPhase;
+	phase = eucMod(phase, 1.0f);
+}
+
 	
 	
 // From Fundamental VCO.cpp
@@ -17,6 +17,60 @@ extern float sawTable[2048];// see end of file
 extern float triTable[2048];// see end of file
 
 
+// Band-limited wavetables, built once and shared read-only by all oscillator instances
+
+struct SineTable {
+	static const int TABLE_SIZE = 2048;
+	alignas(64) float table[TABLE_SIZE + 16];// guard point for interpolation without wrapping, padded to a cache line
+	
+	SineTable();
+	float process(float phase) const {// phase must be in [0.0f : 1.0f]
+		float pos = phase * TABLE_SIZE;
+		int i = (int)pos;
+		return crossfade(table[i], table[i + 1], pos - i);
+	}
+};
+
+
+struct MipMappedWaveTable {
+	static const int TABLE_SIZE = 2048;
+	static const int ROW_SIZE = TABLE_SIZE + 16;// guard point, padded to keep each level cache-line aligned
+	static const int NUM_LEVELS = 11;// level l holds harmonics 1 to (TABLE_SIZE / 2) >> l (level 0 is capped to TABLE_SIZE / 2 - 1)
+	alignas(64) float levels[NUM_LEVELS][ROW_SIZE];
+	
+	void init(const float *source);// source is one cycle of TABLE_SIZE samples
+	static int getLevel(float deltaPhase) {// highest bandwidth level that does not alias at the given phase increment per sample
+		deltaPhase = std::fabs(deltaPhase);
+		int level = 0;
+		float maxDeltaPhase = 1.0f / TABLE_SIZE;
+		while (level < NUM_LEVELS - 1 && deltaPhase > maxDeltaPhase) {
+			level++;
+			maxDeltaPhase *= 2.0f;
+		}
+		return level;
+	}
+	float process(int level, float phase) const {// phase must be in [0.0f : 1.0f]
+		float pos = phase * TABLE_SIZE;
+		int i = (int)pos;
+		return crossfade(levels[level][i], levels[level][i + 1], pos - i);
+	}
+};
+
+
+struct WaveTableBank {
+	SineTable sine;
+	MipMappedWaveTable sinAnalog;
+	MipMappedWaveTable triAnalog;
+	MipMappedWaveTable sawAnalog;
+	MipMappedWaveTable triDigital;
+	MipMappedWaveTable sawDigital;
+	
+	WaveTableBank();
+};
+
+const WaveTableBank &getWaveTableBank();// built on first call
+
+
 // From Fundamental VCF
 struct LadderFilter {
 	float omega0;
@@ -56,6 +110,8 @@ struct VoltageControlledOscillator {
 	float pitch;
 	bool syncEnabled = false;
 	bool syncDirection = false;
+	bool wavetable = false;// when true, use the mip-mapped wavetables at the base sample rate instead of oversampling
+	const WaveTableBank *tables = &getWaveTableBank();
 
 	dsp::Decimator<OVERSAMPLE, QUALITY> sinDecimator;
 	dsp::Decimator<OVERSAMPLE, QUALITY> triDecimator;
@@ -71,25 +127,84 @@ struct VoltageControlledOscillator {
 	float triBuffer[OVERSAMPLE] = {};
 	float sawBuffer[OVERSAMPLE] = {};
 	float sqrBuffer[OVERSAMPLE] = {};
+	
+	// Outputs when in wavetable mode
+	float sinValue = 0.0f;
+	float triValue = 0.0f;
+	float sawValue = 0.0f;
+	float sqrValue = 0.0f;
 
 	void setPitch(float pitchKnob, float pitchCv);
 	void setPulseWidth(float pulseWidth);
 	void process(float deltaTime, float syncValue);
+	void processWaveTable(float deltaPhase, int syncIndex, float deltaTime);
 
 	float sin() {
-		return sinDecimator.process(sinBuffer);
+		return wavetable ? sinValue : sinDecimator.process(sinBuffer);
 	}
 	float tri() {
-		return triDecimator.process(triBuffer);
+		return wavetable ? triValue : triDecimator.process(triBuffer);
 	}
 	float saw() {
-		return sawDecimator.process(sawBuffer);
+		return wavetable ? sawValue : sawDecimator.process(sawBuffer);
 	}
 	float sqr() {
-		return sqrDecimator.process(sqrBuffer);
+		return wavetable ? sqrValue : sqrDecimator.process(sqrBuffer);
 	}
 	float light() {
-		return std::sin(2*M_PI * phase);
+		return tables->sine.process(phase);
+	}
+};
+
+
+
+// Recursive sine/cosine pair rotated by a fixed angle per step (a few multiplies per sample)
+// The rotation is only recalculated when the phase increment changes, and every ANCHOR_STEPS steps the pair 
+//   is renormalized by re-anchoring it to the owner's phase accumulator, so that neither magnitude nor phase 
+//   errors can accumulate over long run times (the phase accumulator is what tri(), saw() and sqr() use)
+struct QuadratureOscillator {
+	static const int ANCHOR_STEPS = 64;
+	float sinVal = 0.0f;
+	float cosVal = 1.0f;
+	float rotSin = 0.0f;
+	float rotCos = 1.0f;
+	float rotDeltaPhase = 0.0f;
+	int anchorCount = 0;
+	
+	void anchor(float phase, const SineTable *sineTable) {// phase must be in [0.0f : 1.0f[
+		float cosPhase = phase + 0.25f;
+		if (cosPhase >= 1.0f)
+			cosPhase -= 1.0f;
+		sinVal = sineTable->process(phase);
+		cosVal = sineTable->process(cosPhase);
+		anchorCount = 0;
+	}
+	void setRotation(float deltaPhase, const SineTable *sineTable) {// deltaPhase must be in [0.0f : 0.5f]
+		if (deltaPhase <= 1.0f / 16.0f) {
+			// small angles (all LFO rates at 11 kHz and above): Taylor series, exact to float precision up to pi/8, 
+			//   since the table's interpolation error would accumulate over the ANCHOR_STEPS rotations
+			float x = 2.0f * float(M_PI) * deltaPhase;
+			float x2 = x * x;
+			rotSin = x * (1.0f - x2 * (1.0f / 6.0f) * (1.0f - x2 * (1.0f / 20.0f) * (1.0f - x2 * (1.0f / 42.0f))));
+			rotCos = 1.0f - x2 * 0.5f * (1.0f - x2 * (1.0f / 12.0f) * (1.0f - x2 * (1.0f / 30.0f) * (1.0f - x2 * (1.0f / 56.0f))));
+		}
+		else {
+			rotSin = sineTable->process(deltaPhase);
+			rotCos = sineTable->process(deltaPhase + 0.25f);
+		}
+	}
+	void step(float deltaPhase, float phase, const SineTable *sineTable) {// phase is the owner's phase after it was advanced by deltaPhase
+		if (++anchorCount >= ANCHOR_STEPS) {
+			anchor(phase, sineTable);
+			return;
+		}
+		if (deltaPhase != rotDeltaPhase) {
+			rotDeltaPhase = deltaPhase;
+			setRotation(deltaPhase, sineTable);
+		}
+		float newSin = sinVal * rotCos + cosVal * rotSin;
+		cosVal = cosVal * rotCos - sinVal * rotSin;
+		sinVal = newSin;
 	}
 };
 
@@ -102,12 +217,15 @@ struct LowFrequencyOscillator {
 	float freq = 1.0f;
 	bool offset = false;
 	bool invert = false;
+	bool useSine = true;// can be set to false when sin() and light() are not used, to skip the quadrature oscillator
 	Trigger resetTrigger;
+	const SineTable *sineTable = &getWaveTableBank().sine;
+	QuadratureOscillator quad;
 
 	LowFrequencyOscillator() {}
 	void setPitch(float pitch) {
 		pitch = std::fmin(pitch, 8.0f);
-		freq = std::pow(2.0f, pitch);
+		freq = fastExp2(pitch);
 	}
 	void setPulseWidth(float pw_) {
 		const float pwMin = 0.01f;
@@ -116,6 +234,7 @@ struct LowFrequencyOscillator {
 	void setReset(float reset) {
 		if (resetTrigger.process(reset / 0.01f)) {
 			phase = 0.0f;
+			quad.anchor(phase, sineTable);
 		}
 	}
 	void step(float dt) {
@@ -123,12 +242,14 @@ struct LowFrequencyOscillator {
 		phase += deltaPhase;
 		if (phase >= 1.0f)
 			phase -= 1.0f;
+		if (useSine)
+			quad.step(deltaPhase, phase, sineTable);
 	}
 	float sin() {
 		if (offset)
-			return 1.0f - std::cos(2*M_PI * phase) * (invert ? -1.0f : 1.0f);
+			return 1.0f - quad.cosVal * (invert ? -1.0f : 1.0f);
 		else
-			return std::sin(2*M_PI * phase) * (invert ? -1.0f : 1.0f);
+			return quad.sinVal * (invert ? -1.0f : 1.0f);
 	}
 	float tri(float x) {
 		return 4.0f * std::fabs(x - std::round(x));
@@ -153,7 +274,7 @@ struct LowFrequencyOscillator {
 		return offset ? sqr + 1.0f : sqr;
 	}
 	float light() {
-		return std::sin(2*M_PI * phase);
+		return quad.sinVal;
 	}
 };
 
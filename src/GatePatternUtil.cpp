@@ -0,0 +1,33 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//***********************************************************************************************
+
+
+#include "GatePatternUtil.hpp"
+
+
+const GatePattern gatePatterns[NUM_GATE_PATTERNS] = {
+	GatePattern::fromMask24(0x00003F),// 25%
+	GatePattern::fromMask24(0x0F0F0F),// TRI
+	GatePattern::fromMask24(0x000FFF),// 50%
+	GatePattern::fromMask24(0x0F0F00),// T23
+	GatePattern::fromMask24(0x03FFFF),// 75%
+	GatePattern::fromMask24(0xFFFFFF),// FUL
+	GatePattern::fromMask24(0x00000F),// TR1
+	GatePattern::fromMask24(0x03F03F),// DUO
+	GatePattern::fromMask24(0x000F00),// TR2
+	GatePattern::fromMask24(0x03F000),// D2
+	GatePattern::fromMask24(0x0F0000),// TR3
+	GatePattern::fromMask24(0)// TRIG (handled separately by the sequencers)
+};
+
+
+GatePattern GatePattern::fromMask24(uint32_t mask24) {
+	GatePattern pattern;
+	pattern.clear();
+	for (int i = 0; i < 24; i++) {
+		if ((mask24 >> i) & (uint32_t)0x1)
+			pattern.bits[i >> 3] |= ((uint32_t)0xF << ((i & 0x7) * 4));// ticks 4i to 4i+3
+	}
+	return pattern;
+}
@@ -0,0 +1,48 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//***********************************************************************************************
+
+#ifndef GATE_PATTERN_UTIL_HPP
+#define GATE_PATTERN_UTIL_HPP
+
+
+#include "ImpromptuModular.hpp"
+
+
+// Gate pattern of one step (advanced gate types), shared by the Phrase and Gate sequencers and Foundry.
+// Bit n is the gate state at tick n, with 96 ticks per step.
+
+struct GatePattern {
+	static const int TICKS = 96;
+	static const int NUM_WORDS = TICKS / 32;
+	uint32_t bits[NUM_WORDS];
+
+	void clear() {
+		for (int i = 0; i < NUM_WORDS; i++)
+			bits[i] = 0;
+	}
+
+	inline bool hit(int tick) const {
+		return ((bits[tick >> 5] >> (tick & 0x1F)) & (uint32_t)0x1) != 0;
+	}
+
+	inline int getAdvGate(int ppqnCount, int pulsesPerStep, int grid) const {
+		// grid is the number of ticks per step used to quantize the pulses (24 for the Phrase and Gate sequencers, TICKS for Foundry),
+		//   so that pulse counts that do not divide TICKS fall on the same ticks as before
+		return hit(ppqnCount * (grid / pulsesPerStep) * (TICKS / grid)) ? 1 : 0;
+	}
+
+	static GatePattern fromMask24(uint32_t mask24);// 24 tick mask, each bit covers 4 ticks
+};
+
+
+// Standard gate types (gate type numbers are those stored in the step attributes, TRIG has no pattern)
+enum GatePatternIds {GATE_25, GATE_TRI, GATE_50, GATE_T23, GATE_75, GATE_FUL, GATE_TR1, GATE_DUO, GATE_TR2, GATE_D2, GATE_TR3, GATE_TRIG, NUM_GATE_PATTERNS};
+
+extern const GatePattern gatePatterns[NUM_GATE_PATTERNS];
+
+// GateSeq64 gate modes are a subset of the standard gate types
+static const int gateModeToPatternGS[8] = {GATE_25, GATE_DUO, GATE_D2, GATE_TR1, GATE_TR2, GATE_TR3, GATE_T23, GATE_TRI};
+
+
+#endif
@@ -13,6 +13,7 @@
 
 
 #include "GateSeq64Util.hpp"
+#include "ProfileUtil.hpp"
 
 
 struct GateSeq64 : Module {
@@ -55,7 +56,10 @@ struct GateSeq64 : Module {
 	
 	
 	// Expander
-	float rightMessages[2][6] = {};// messages from expander
+	ExpanderMessage<6 + 1 + 12> rightMessages[2] = {};// messages from expander (its inputs, then the number of chained gates and the chained gates)
+	ExpanderMessageReader<6 + 1 + 12> readerFromExpander;
+	ExpanderMessageWriter<1> writerToExpander;
+	ExpanderMessageWriter<1 + 12> writerToChain;// to a GateSeq64 chained on the left through its expander
 		
 
 	// Constants
@@ -77,10 +81,16 @@ struct GateSeq64 : Module {
 	int sequence;
 	int phrases;// 1 to 64
 	StepAttributesGS attributes[MAX_SEQS][64];
+	uint64_t gateBits[MAX_SEQS];// no need to save, gates of attributes as one bitset per sequence (bit s is step s), kept in sync by setGate(), setGateRow() and updateGateBits()
 	SeqAttributesGS sequences[MAX_SEQS];
+	PagedStepsGS pages[MAX_SEQS];// the pages of each sequence that are not loaded in attributes
+	int loadedPage[MAX_SEQS];// page of each sequence that is in attributes (the one shown and edited)
 	int phrase[64];// This is the song (series of phases; a phrase is a patten number)
 	bool resetOnRun;
 	bool stopAtEndOfSong;
+	bool preRollProb;// probabilities drawn per pass and shown on the step lights
+	bool polyGates;// first gate output also carries the four rows as poly channels
+	bool mergeChainedGates;// poly gate output also carries the rows of the GateSeq64s chained on the right through the expander
 
 	// No need to save, with reset
 	int displayState;
@@ -103,16 +113,21 @@ struct GateSeq64 : Module {
 	unsigned long phraseIndexRunHistory;
 	int stepIndexRun[4];
 	unsigned long stepIndexRunHistory;
+	int pageIndexRun;
 	int ppqnCount;
 	int gateCode[4];
 
 	// No need to save, no reset
+	ProbabilityPreRoll probPreRoll;
 	int stepConfigSync = 0;// 0 means no sync requested, 1 means soft sync (no reset lengths), 2 means hard (reset lengths)
 	RefreshCounter refresh;
+#ifdef IM_PROFILE
+	ModuleProfiler profiler;
+#endif
 	float resetLight = 0.0f;
 	int sequenceKnob = 0;
 	Trigger modesTrigger;
-	Trigger stepTriggers[64];
+	TriggerBank<64> stepTriggers;
 	Trigger copyTrigger;
 	Trigger pasteTrigger;
 	Trigger runningTrigger;
@@ -122,7 +137,7 @@ struct GateSeq64 : Module {
 	Trigger write0Trigger;
 	Trigger write1Trigger;
 	Trigger stepLTrigger;
-	Trigger gModeTriggers[8];
+	TriggerBank<8> gModeTriggers;
 	Trigger probTrigger;
 	Trigger seqCVTrigger;
 	dsp::BooleanTrigger editingSequenceTrigger;
@@ -160,12 +175,8 @@ struct GateSeq64 : Module {
 	GateSeq64() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		
-		rightExpander.producerMessage = rightMessages[0];
-		rightExpander.consumerMessage = rightMessages[1];
-		
-		// must init those that have no-connect info to non-connected, or else mother may read 0.0 init value if ever refresh limiters make it such that after a connection of expander the mother reads before the first pass through the expander's writing code, and this may do something undesired (ex: change track in Foundry on expander connected while track CV jack is empty)
-		rightMessages[1][0] = std::numeric_limits<float>::quiet_NaN();
-		rightMessages[1][1] = std::numeric_limits<float>::quiet_NaN();
+		rightExpander.producerMessage = &rightMessages[0];
+		rightExpander.consumerMessage = &rightMessages[1];
 		
 		char strBuf[32];
 		// Step LED buttons and GateMode lights
@@ -215,13 +226,19 @@ struct GateSeq64 : Module {
 			for (int s = 0; s < 64; s++) {
 				attributes[i][s].init();
 			}
+			updateGateBits(i);
 			sequences[i].init(16 * getStepConfig(), MODE_FWD);
+			pages[i].init();
+			loadedPage[i] = 0;
 		}
 		for (int i = 0; i < 64; i++) {
 			phrase[i] = 0;
 		}
 		resetOnRun = false;
 		stopAtEndOfSong = false;
+		preRollProb = false;
+		polyGates = false;
+		mergeChainedGates = false;
 		resetNonJson(false);
 	}
 	void resetNonJson(bool delayed) {// delay thread sensitive parts (i.e. schedule them so that process() will do them)
@@ -258,10 +275,12 @@ struct GateSeq64 : Module {
 		stepIndexRun[0] = (sequences[seq].getRunMode() == MODE_REV ? sequences[seq].getLength() - 1 : 0);
 		fillStepIndexRunVector(sequences[seq].getRunMode(), sequences[seq].getLength());
 		stepIndexRunHistory = 0;
+		pageIndexRun = 0;
 
 		ppqnCount = 0;
+		probPreRoll.reset();
 		for (int i = 0; i < 4; i += stepConfig)
-			gateCode[i] = calcGateCode(attributes[seq][(i * 16) + stepIndexRun[i]], 0, pulsesPerStep);
+			gateCode[i] = calcGateCode(getRunAttribute(seq, (i * 16) + stepIndexRun[i]), 0, pulsesPerStep, preRollGate(seq, (i * 16) + stepIndexRun[i], 0));
 	}
 	
 	
@@ -270,6 +289,7 @@ struct GateSeq64 : Module {
 			for (int s = 0; s < 64; s++) {
 				attributes[sequence][s].randomize();
 			}
+			updateGateBits(sequence);
 			sequences[sequence].randomize(16 * stepConfig, NUM_MODES);// ok to use stepConfig since CONFIG_PARAM is not randomizable		
 		}
 	}
@@ -314,7 +334,35 @@ struct GateSeq64 : Module {
 			for (int s = 0; s < 64; s++) {
 				json_array_insert_new(attributesJ, s + (i * 64), json_integer(attributes[i][s].getAttribute()));
 			}
-		json_object_set_new(rootJ, "attributes2", attributesJ);// "2" appended so no break patches
+		json_object_set_new(rootJ, "attributes2", attributesJ);// "2" appended so no break patches (these are the loaded pages)
+		
+		// pages (only for the sequences that have more than one page or that have steps in other pages)
+		json_t *pagesJ = json_array();
+		for (int i = 0; i < MAX_SEQS; i++) {
+			json_t *stepsJ = json_array();// pairs of step (page * 64 + step in page) and attribute, for the steps of the other pages that are not in the init state
+			for (int p = 0; p < PagedStepsGS::MAX_PAGES; p++) {
+				if (p == loadedPage[i])
+					continue;
+				for (int s = 0; s < 64; s++) {
+					unsigned short attrib = pages[i].getAttribute(p, s).getAttribute();
+					if (attrib != StepAttributesGS::ATT_MSK_INITSTATE) {
+						json_array_append_new(stepsJ, json_integer(p * 64 + s));
+						json_array_append_new(stepsJ, json_integer(attrib));
+					}
+				}
+			}
+			if (pages[i].numPages == 1 && loadedPage[i] == 0 && json_array_size(stepsJ) == 0) {
+				json_decref(stepsJ);
+				continue;
+			}
+			json_t *seqPagesJ = json_object();
+			json_object_set_new(seqPagesJ, "sequence", json_integer(i));
+			json_object_set_new(seqPagesJ, "numPages", json_integer(pages[i].numPages));
+			json_object_set_new(seqPagesJ, "loadedPage", json_integer(loadedPage[i]));
+			json_object_set_new(seqPagesJ, "steps", stepsJ);
+			json_array_append_new(pagesJ, seqPagesJ);
+		}
+		json_object_set_new(rootJ, "pages", pagesJ);
 		
 		// sequences
 		json_t *sequencesJ = json_array();
@@ -334,6 +382,15 @@ struct GateSeq64 : Module {
 		// stopAtEndOfSong
 		json_object_set_new(rootJ, "stopAtEndOfSong", json_boolean(stopAtEndOfSong));
 
+		// preRollProb
+		json_object_set_new(rootJ, "preRollProb", json_boolean(preRollProb));
+
+		// polyGates
+		json_object_set_new(rootJ, "polyGates", json_boolean(polyGates));
+
+		// mergeChainedGates
+		json_object_set_new(rootJ, "mergeChainedGates", json_boolean(mergeChainedGates));
+
 		return rootJ;
 	}
 
@@ -423,6 +480,47 @@ struct GateSeq64 : Module {
 				}
 			}
 		}
+		for (int i = 0; i < MAX_SEQS; i++)
+			updateGateBits(i);
+		
+		// pages
+		for (int i = 0; i < MAX_SEQS; i++) {
+			pages[i].init();
+			loadedPage[i] = 0;
+		}
+		json_t *pagesJ = json_object_get(rootJ, "pages");
+		if (pagesJ) {
+			StepAttributesGS pageSteps[PagedStepsGS::MAX_PAGES * 64];
+			for (size_t n = 0; n < json_array_size(pagesJ); n++) {
+				json_t *seqPagesJ = json_array_get(pagesJ, n);
+				json_t *sequenceJ = json_object_get(seqPagesJ, "sequence");
+				json_t *numPagesJ = json_object_get(seqPagesJ, "numPages");
+				json_t *loadedPageJ = json_object_get(seqPagesJ, "loadedPage");
+				json_t *stepsJ = json_object_get(seqPagesJ, "steps");
+				if (!sequenceJ || !numPagesJ || !loadedPageJ || !stepsJ)
+					continue;
+				int i = clamp((int)json_integer_value(sequenceJ), 0, MAX_SEQS - 1);
+				pages[i].numPages = clamp((int)json_integer_value(numPagesJ), 1, PagedStepsGS::MAX_PAGES);
+				loadedPage[i] = clamp((int)json_integer_value(loadedPageJ), 0, pages[i].numPages - 1);
+				for (int s = 0; s < PagedStepsGS::MAX_PAGES * 64; s++)
+					pageSteps[s].init();
+				for (size_t k = 0; k + 1 < json_array_size(stepsJ); k += 2) {
+					int s = (int)json_integer_value(json_array_get(stepsJ, k));
+					if (s >= 0 && s < PagedStepsGS::MAX_PAGES * 64)
+						pageSteps[s].setAttribute((unsigned short)json_integer_value(json_array_get(stepsJ, k + 1)));
+				}
+				for (int p = 0; p < PagedStepsGS::MAX_PAGES; p++) {
+					if (p == loadedPage[i] || pages[i].storePage(p, &pageSteps[p * 64]))
+						continue;
+					for (int s = p * 64; s < p * 64 + 64; s++) {// more probabilities and gate modes than the pool holds (edited patch), keep only the gates
+						bool gate = pageSteps[s].getGate();
+						pageSteps[s].init();
+						pageSteps[s].setGate(gate);
+					}
+					pages[i].storePage(p, &pageSteps[p * 64]);
+				}
+			}
+		}
 		
 		// sequences
 		json_t *sequencesJ = json_object_get(rootJ, "sequences");
@@ -515,6 +613,21 @@ struct GateSeq64 : Module {
 		if (stopAtEndOfSongJ)
 			stopAtEndOfSong = json_is_true(stopAtEndOfSongJ);
 		
+		// preRollProb
+		json_t *preRollProbJ = json_object_get(rootJ, "preRollProb");
+		if (preRollProbJ)
+			preRollProb = json_is_true(preRollProbJ);
+		
+		// polyGates
+		json_t *polyGatesJ = json_object_get(rootJ, "polyGates");
+		if (polyGatesJ)
+			polyGates = json_is_true(polyGatesJ);
+		
+		// mergeChainedGates
+		json_t *mergeChainedGatesJ = json_object_get(rootJ, "mergeChainedGates");
+		if (mergeChainedGatesJ)
+			mergeChainedGates = json_is_true(mergeChainedGatesJ);
+		
 		resetNonJson(true);
 	}
 
@@ -530,6 +643,7 @@ struct GateSeq64 : Module {
 
 		
 		//********** Buttons, knobs, switches and inputs **********
+		PROFILE_BEGIN(profiler, PROF_INPUTS);
 
 		// Edit mode		
 		bool editingSequence = isEditingSequence();// true = editing sequence, false = editing song
@@ -622,6 +736,7 @@ struct GateSeq64 : Module {
 					if (seqCopied) {// non-crossed paste (seq vs song)
 						for (int i = 0, s = startCP; i < countCP; i++, s++)
 							attributes[sequence][s] = attribCPbuffer[i];
+						updateGateBits(sequence);
 						if (params[CPMODE_PARAM].getValue() > 1.5f) {// all
 							sequences[sequence].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
 							if (sequences[sequence].getLength() > 16 * stepConfig)
@@ -632,11 +747,11 @@ struct GateSeq64 : Module {
 						if (params[CPMODE_PARAM].getValue() > 1.5f) { // ALL (init steps)
 							for (int s = 0; s < 64; s++)
 								attributes[sequence][s].init();
+							updateGateBits(sequence);
 						}
 						else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (randomize gates)
-							for (int s = 0; s < 64; s++)
-								if ( (random::u32() & 0x1) != 0)
-									attributes[sequence][s].toggleGate();
+							uint64_t toggleBits = (((uint64_t)random::u32()) << 32) | (uint64_t)random::u32();
+							setGateRow(sequence, gateBits[sequence] ^ toggleBits);
 						}
 						else {// 8 (randomize probs)
 							for (int s = 0; s < 64; s++) {
@@ -677,9 +792,10 @@ struct GateSeq64 : Module {
 			}
 			
 			// Write CV inputs 
-			bool expanderPresent = (rightExpander.module && rightExpander.module->model == modelGateSeq64Expander);
-			float *messagesFromExpander = (float*)rightExpander.consumerMessage;// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
-			if (expanderPresent) {
+			ExpanderMessage<6 + 1 + 12> *messageFromExpander = readerFromExpander.read(rightExpander, rightExpander.module && rightExpander.module->model == modelGateSeq64Expander);
+			bool expanderPresent = (messageFromExpander != NULL);
+			float *messagesFromExpander = (expanderPresent ? messageFromExpander->values : NULL);
+			if (expanderPresent && (readerFromExpander.hasChanged(2) || readerFromExpander.hasChanged(3) || readerFromExpander.hasChanged(4))) {// triggers can't fire on unchanged inputs
 				bool writeTrig = writeTrigger.process(messagesFromExpander[2]);
 				bool write0Trig = write0Trigger.process(messagesFromExpander[4]);
 				bool write1Trig = write1Trigger.process(messagesFromExpander[3]);
@@ -695,10 +811,10 @@ struct GateSeq64 : Module {
 								attributes[sequence][stepIndexEdit].setGateP(false);
 							}
 							if (!std::isnan(messagesFromExpander[0]))
-								attributes[sequence][stepIndexEdit].setGate(messagesFromExpander[0] >= 1.0f);
+								setGate(sequence, stepIndexEdit, messagesFromExpander[0] >= 1.0f);
 						}
 						else {// write1 or write0			
-							attributes[sequence][stepIndexEdit].setGate(write1Trig);
+							setGate(sequence, stepIndexEdit, write1Trig);
 						}
 						// Autostep (after grab all active inputs)
 						stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, 64);
@@ -709,7 +825,7 @@ struct GateSeq64 : Module {
 			}
 
 			// Step left CV input
-			if (expanderPresent && stepLTrigger.process(messagesFromExpander[5])) {
+			if (expanderPresent && readerFromExpander.hasChanged(5) && stepLTrigger.process(messagesFromExpander[5])) {
 				if (editingSequence) {
 					blinkNum = blinkNumInit;
 					stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit - 1, 64);					
@@ -717,23 +833,26 @@ struct GateSeq64 : Module {
 			}
 
 			// Step LED button presses
-			int stepPressed = -1;
-			for (int i = 0; i < 64; i++) {
-				if (stepTriggers[i].process(params[STEP_PARAMS + i].getValue()))
-					stepPressed = i;
-			}		
+			uint64_t stepsPressed = stepTriggers.process(params, STEP_PARAMS);
+			int stepPressed = (stepsPressed != 0 ? 63 - __builtin_clzll(stepsPressed) : -1);// the last one when many are pressed
 			if (stepPressed != -1) {
 				if (editingSequence) {
 					if (displayState == DISP_LENGTH) {
 						sequences[sequence].setLength(stepPressed % (16 * stepConfig) + 1);
 						revertDisplay = (long) (revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
-					else if (displayState == DISP_MODES) {
+					else if (displayState == DISP_MODES) {// pages: first row selects the page to edit, second row sets the number of pages
+						if (stepPressed < 16) {
+							if (stepPressed < pages[sequence].numPages)
+								selectPage(sequence, stepPressed);
+						}
+						else if (stepPressed < 32)
+							setNumPages(sequence, stepPressed - 16 + 1);
 					}
 					else {						
 						// version 1
-						/*if (!attributes[sequence][stepPressed].getGate()) {// clicked inactive, so turn gate on
-							attributes[sequence][stepPressed].setGate(true);
+						/*if (!getGate(sequence, stepPressed)) {// clicked inactive, so turn gate on
+							setGate(sequence, stepPressed, true);
 							if (attributes[sequence][stepPressed].getGateP())
 								displayProbInfo = (long) (displayProbInfoTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 							else
@@ -741,7 +860,7 @@ struct GateSeq64 : Module {
 						}
 						else {// clicked active
 							if (stepIndexEdit == stepPressed && blinkNum != 0) {// only if coming from current step, turn off
-								attributes[sequence][stepPressed].setGate(false);
+								setGate(sequence, stepPressed, false);
 								displayProbInfo = 0l;
 							}
 							else {
@@ -753,15 +872,15 @@ struct GateSeq64 : Module {
 						}*/
 						
 						// version 2
-						if (!attributes[sequence][stepPressed].getGate()) {// clicked inactive, so turn gate on
-							attributes[sequence][stepPressed].setGate(true);
+						if (!getGate(sequence, stepPressed)) {// clicked inactive, so turn gate on
+							setGate(sequence, stepPressed, true);
 							if (attributes[sequence][stepPressed].getGateP())
 								displayProbInfo = (long) (displayProbInfoTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 							else
 								displayProbInfo = 0l;
 						}
 						else {// clicked active
-							attributes[sequence][stepPressed].setGate(false);
+							setGate(sequence, stepPressed, false);
 							displayProbInfo = 0l;
 						}				
 						
@@ -807,7 +926,7 @@ struct GateSeq64 : Module {
 				blinkNum = blinkNumInit;
 				
 				// version 1
-				/*if (editingSequence && attributes[sequence][stepIndexEdit].getGate()) {
+				/*if (editingSequence && getGate(sequence, stepIndexEdit)) {
 					if (attributes[sequence][stepIndexEdit].getGateP()) {
 						displayProbInfo = 0l;
 						attributes[sequence][stepIndexEdit].setGateP(false);
@@ -820,7 +939,7 @@ struct GateSeq64 : Module {
 				
 				// version 2
 				if (editingSequence) {
-					if (attributes[sequence][stepIndexEdit].getGate()) {// gate is on and pressed gatep
+					if (getGate(sequence, stepIndexEdit)) {// gate is on and pressed gatep
 						if (attributes[sequence][stepIndexEdit].getGateP()) {
 							displayProbInfo = 0l;
 							attributes[sequence][stepIndexEdit].setGateP(false);
@@ -831,7 +950,7 @@ struct GateSeq64 : Module {
 						}
 					}
 					else {// gate is off and pressed gatep button
-						attributes[sequence][stepIndexEdit].setGate(true);
+						setGate(sequence, stepIndexEdit, true);
 						displayProbInfo = (long) (displayProbInfoTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 						attributes[sequence][stepIndexEdit].setGateP(true);
 					}
@@ -840,17 +959,17 @@ struct GateSeq64 : Module {
 			}
 			
 			// GateMode buttons
-			for (int i = 0; i < 8; i++) {
-				if (gModeTriggers[i].process(params[GMODE_PARAMS + i].getValue())) {
-					blinkNum = blinkNumInit;
-					if (editingSequence && attributes[sequence][stepIndexEdit].getGate()) {
-						if (ppsRequirementMet(i)) {
-							editingPpqn = 0l;
-							attributes[sequence][stepIndexEdit].setGateMode(i);
-						}
-						else {
-							editingPpqn = (long) (editingPpqnTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-						}
+			uint64_t gModesPressed = gModeTriggers.process(params, GMODE_PARAMS);
+			for (; gModesPressed != 0; gModesPressed &= (gModesPressed - 1)) {
+				int i = __builtin_ctzll(gModesPressed);
+				blinkNum = blinkNumInit;
+				if (editingSequence && getGate(sequence, stepIndexEdit)) {
+					if (ppsRequirementMet(i)) {
+						editingPpqn = 0l;
+						attributes[sequence][stepIndexEdit].setGateMode(i);
+					}
+					else {
+						editingPpqn = (long) (editingPpqnTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
 				}
 			}
@@ -922,6 +1041,7 @@ struct GateSeq64 : Module {
 		
 		
 		//********** Clock and reset **********
+		PROFILE_NEXT(PROF_CLOCK);
 		
 		// Clock
 		if (running && clockIgnoreOnReset == 0l) {
@@ -933,14 +1053,16 @@ struct GateSeq64 : Module {
 				int newSeq = sequence;// good value when editingSequence, overwrite if not editingSequence
 				if (ppqnCount == 0) {
 					if (editingSequence) {
-						moveIndexRunMode(&stepIndexRun[0], sequences[sequence].getLength(), sequences[sequence].getRunMode(), &stepIndexRunHistory);
+						if (moveIndexRunMode(&stepIndexRun[0], sequences[sequence].getLength(), sequences[sequence].getRunMode(), &stepIndexRunHistory))
+							movePageIndexRun(sequence);
 					}
 					else {
+						int oldPageIndexRun = pageIndexRun;
 						int oldStepIndexRun0 = stepIndexRun[0];
 						int oldStepIndexRun1 = stepIndexRun[1];
 						int oldStepIndexRun2 = stepIndexRun[2];
 						int oldStepIndexRun3 = stepIndexRun[3];
-						if (moveIndexRunMode(&stepIndexRun[0], sequences[phrase[phraseIndexRun]].getLength(), sequences[phrase[phraseIndexRun]].getRunMode(), &stepIndexRunHistory)) {
+						if (moveIndexRunMode(&stepIndexRun[0], sequences[phrase[phraseIndexRun]].getLength(), sequences[phrase[phraseIndexRun]].getRunMode(), &stepIndexRunHistory) && movePageIndexRun(phrase[phraseIndexRun])) {
 							int oldPhraseIndexRun = phraseIndexRun;
 							bool songLoopOver = moveIndexRunMode(&phraseIndexRun, phrases, runModeSong, &phraseIndexRunHistory);
 							// check for end of song if needed
@@ -951,6 +1073,7 @@ struct GateSeq64 : Module {
 								stepIndexRun[2] = oldStepIndexRun2;
 								stepIndexRun[3] = oldStepIndexRun3;
 								phraseIndexRun = oldPhraseIndexRun;
+								pageIndexRun = oldPageIndexRun;
 							}
 							else {							
 								stepIndexRun[0] = (sequences[phrase[phraseIndexRun]].getRunMode() == MODE_REV ? sequences[phrase[phraseIndexRun]].getLength() - 1 : 0);// must always refresh after phraseIndexRun has changed
@@ -967,7 +1090,7 @@ struct GateSeq64 : Module {
 				}
 				for (int i = 0; i < 4; i += stepConfig) { 
 					if (gateCode[i] != -1 || ppqnCount == 0)
-						gateCode[i] = calcGateCode(attributes[newSeq][(i * 16) + stepIndexRun[i]], ppqnCount, pulsesPerStep);
+						gateCode[i] = calcGateCode(getRunAttribute(newSeq, (i * 16) + stepIndexRun[i]), ppqnCount, pulsesPerStep, preRollGate(newSeq, (i * 16) + stepIndexRun[i], ppqnCount));
 				}
 			}
 		}	
@@ -984,6 +1107,7 @@ struct GateSeq64 : Module {
 	
 		
 		//********** Outputs and lights **********
+		PROFILE_NEXT(PROF_OUTPUTS);
 				
 		// Gate outputs
 		if (running) {
@@ -995,8 +1119,45 @@ struct GateSeq64 : Module {
 			for (int i = 0; i < 4; i++)
 				outputs[GATE_OUTPUTS + i].setVoltage(0.0f);	
 		}
+		
+		// Gates of the GateSeq64s chained on the right through the expander (GateSeq64 - expander - GateSeq64 - expander ...)
+		PROFILE_NEXT(PROF_EXPANDER);
+		int numChained = 0;
+		float *chainedGates = NULL;
+		if (rightExpander.module && rightExpander.module->model == modelGateSeq64Expander) {
+			ExpanderMessage<6 + 1 + 12> *messageFromExpander = (ExpanderMessage<6 + 1 + 12>*)rightExpander.consumerMessage;
+			if (messageFromExpander->isValid()) {// read directly, since the reader's changes are those between input refreshes
+				numChained = clamp((int)(messageFromExpander->values[6] + 0.5f), 0, 12);
+				chainedGates = &messageFromExpander->values[7];
+			}
+		}
+		
+		// Poly gate output (rows on channels 1 to 4, then the chained rows)
+		if (polyGates) {
+			for (int i = 1; i < 4; i++)
+				outputs[GATE_OUTPUTS + 0].setVoltage(outputs[GATE_OUTPUTS + i].getVoltage(), i);
+			int numPolyChained = (mergeChainedGates ? numChained : 0);
+			for (int c = 0; c < numPolyChained; c++)
+				outputs[GATE_OUTPUTS + 0].setVoltage(chainedGates[c], 4 + c);
+			outputs[GATE_OUTPUTS + 0].setChannels(4 + numPolyChained);
+		}
+		else
+			outputs[GATE_OUTPUTS + 0].setChannels(1);
+		
+		// To a GateSeq64 chained on the left (through its expander), sent on every sample since these are gates
+		if (leftExpander.module && leftExpander.module->model == modelGateSeq64Expander) {
+			float *messagesToChain = writerToChain.values;
+			for (int i = 0; i < 4; i++)
+				messagesToChain[1 + i] = outputs[GATE_OUTPUTS + i].getVoltage();
+			int numToChain = (numChained > 8 ? 12 : 4 + numChained);// the first GateSeq64 has the other 4 of the 16 channels
+			for (int c = 4; c < numToChain; c++)
+				messagesToChain[1 + c] = chainedGates[c - 4];
+			messagesToChain[0] = (float)numToChain;
+			writerToChain.send(leftExpander.module, leftExpander.module->rightExpander);
+		}
 
 		// lights
+		PROFILE_NEXT(PROF_LIGHTS);
 		if (refresh.processLights()) {
 			// Step LED button lights
 			if (infoCopyPaste != 0l) {
@@ -1010,6 +1171,7 @@ struct GateSeq64 : Module {
 			else {
 				int row = -1;
 				int col = -1;
+				bool runPageShown = (getRunPage(sequence) == loadedPage[sequence]);// show the run position only when its page is loaded
 				for (int i = 0; i < 64; i++) {
 					row = i >> (3 + stepConfig);//i / (16 * stepConfig);// optimized (not equivalent code, but in this case has same effect)
 					if (stepConfig == 2 && row == 1) 
@@ -1024,14 +1186,25 @@ struct GateSeq64 : Module {
 							else 
 								setGreenRed3(STEP_LIGHTS + i * 3, 0.0f, 0.0f);
 						}
+						else if (displayState == DISP_MODES) {// pages: first row is the page being edited (green) and played (red), second row is the number of pages
+							int numPages = pages[sequence].numPages;
+							if (i < 16)
+								setGreenRed3(STEP_LIGHTS + i * 3, i == loadedPage[sequence] ? 1.0f : (i < numPages ? 0.32f : 0.0f), (running && i == getRunPage(sequence)) ? 1.0f : 0.0f);
+							else if (i < 32)
+								setGreenRed3(STEP_LIGHTS + i * 3, (i - 16) < (numPages - 1) ? 0.32f : ((i - 16) == (numPages - 1) ? 1.0f : 0.0f), 0.0f);
+							else
+								setGreenRed3(STEP_LIGHTS + i * 3, 0.0f, 0.0f);
+						}
 						else {
-							float stepHereOffset = ((stepIndexRun[row] == col) && running) ? 0.71f : 1.0f;
+							float stepHereOffset = ((stepIndexRun[row] == col) && running && runPageShown) ? 0.71f : 1.0f;
 							long blinkCountMarker = (long) (0.67f * sampleRate / RefreshCounter::displayRefreshStepSkips);							
-							if (attributes[sequence][i].getGate()) {
+							if (getGate(sequence, i)) {
 								bool blinkEnableOn = (displayState != DISP_MODES) && (blinkCount < blinkCountMarker);
 								if (attributes[sequence][i].getGateP()) {
 									if (i == stepIndexEdit)// more orange than yellow
 										setGreenRed3(STEP_LIGHTS + i * 3, blinkEnableOn ? 1.0f : 0.0f, blinkEnableOn ? 1.0f : 0.0f);
+									else if (preRollProb && running && runPageShown && probPreRoll.isUpcomingMiss(sequence * PagedStepsGS::MAX_PAGES + loadedPage[sequence], i))// dim yellow when pre-rolled to not play
+										setGreenRed3(STEP_LIGHTS + i * 3, 0.22f, 0.22f);
 									else// more yellow
 										setGreenRed3(STEP_LIGHTS + i * 3, stepHereOffset, stepHereOffset);
 								}
@@ -1046,7 +1219,7 @@ struct GateSeq64 : Module {
 								if (i == stepIndexEdit && blinkCount > blinkCountMarker && displayState != DISP_MODES)
 									setGreenRed3(STEP_LIGHTS + i * 3, 0.22f, 0.0f);
 								else
-									setGreenRed3(STEP_LIGHTS + i * 3, ((stepIndexRun[row] == col) && running) ? 0.32f : 0.0f, 0.0f);
+									setGreenRed3(STEP_LIGHTS + i * 3, ((stepIndexRun[row] == col) && running && runPageShown) ? 0.32f : 0.0f, 0.0f);
 							}
 						}
 					}
@@ -1066,7 +1239,7 @@ struct GateSeq64 : Module {
 							float red = (i == (phraseIndexEdit) && ((editingPhraseSongRunning > 0l) || !running)) ? 1.0f : 0.0f;
 							float white = 0.0f;
 							if (green == 0.0f && red == 0.0f && displayState != DISP_MODES){
-								white = (attributes[phrase[phraseIndexRun]][i].getGate() ? 0.45f : 0.0f);
+								white = (getGate(phrase[phraseIndexRun], i) ? 0.45f : 0.0f);
 								if (attributes[phrase[phraseIndexRun]][i].getGateP())
 									white = 0.14f;
 							}
@@ -1078,7 +1251,7 @@ struct GateSeq64 : Module {
 			}
 			
 			// GateType lights
-			if (pulsesPerStep != 1 && editingSequence && attributes[sequence][stepIndexEdit].getGate()) {
+			if (pulsesPerStep != 1 && editingSequence && getGate(sequence, stepIndexEdit)) {
 				if (editingPpqn != 0) {
 					for (int i = 0; i < 8; i++) {
 						if (ppsRequirementMet(i))
@@ -1142,10 +1315,10 @@ struct GateSeq64 : Module {
 				}
 			}		
 			// To Expander
+			PROFILE_NEXT(PROF_EXPANDER);
 			if (rightExpander.module && rightExpander.module->model == modelGateSeq64Expander) {
-				float *messagesToExpander = (float*)(rightExpander.module->leftExpander.producerMessage);
-				messagesToExpander[0] = (float)panelTheme;
-				rightExpander.module->leftExpander.messageFlipRequested = true;
+				writerToExpander.values[0] = (float)panelTheme;
+				writerToExpander.send(rightExpander.module, rightExpander.module->leftExpander);
 			}
 		}// lightRefreshCounter
 
@@ -1161,13 +1334,74 @@ struct GateSeq64 : Module {
 		setGreenRed(id, green, red);
 		lights[id + 2].setBrightness(0.0f);
 	}
+	
+	inline bool getGate(int seqn, int stepn) {
+		return ((gateBits[seqn] >> stepn) & (uint64_t)0x1) != 0;
+	}
+	inline void setGate(int seqn, int stepn, bool gateState) {
+		attributes[seqn][stepn].setGate(gateState);
+		uint64_t stepMask = ((uint64_t)0x1) << stepn;
+		gateBits[seqn] = (gateState ? (gateBits[seqn] | stepMask) : (gateBits[seqn] & ~stepMask));
+	}
+	void setGateRow(int seqn, uint64_t bits) {// row-wide gate operations are done on the bitset and then written to the attributes
+		gateBits[seqn] = bits;
+		for (int s = 0; s < 64; s++)
+			attributes[seqn][s].setGate(((bits >> s) & (uint64_t)0x1) != 0);
+	}
+	void updateGateBits(int seqn) {// must be called after whole attributes are written (init, randomize, paste, fromJson)
+		uint64_t bits = 0;
+		for (int s = 0; s < 64; s++) {
+			if (attributes[seqn][s].getGate())
+				bits |= ((uint64_t)0x1) << s;
+		}
+		gateBits[seqn] = bits;
+	}
+	
+	int preRollGate(int seqn, int stepn, int ppqnCount) {// pre-rolled probability outcome for calcGateCode(), -1 when not pre-rolling
+		if (!preRollProb || ppqnCount != 0 || !getRunAttribute(seqn, stepn).getGateP())
+			return -1;
+		return probPreRoll.play(seqn * PagedStepsGS::MAX_PAGES + getRunPage(seqn), stepn, 64, [this, seqn](int s) {
+			StepAttributesGS attribute = getRunAttribute(seqn, s);
+			return attribute.getGateP() ? ((float)(attribute.getGatePVal()) / 100.0f) : 1.0f;
+		}) ? 1 : 0;
+	}
+	
+	// Pages
+	inline int getRunPage(int seqn) {// pageIndexRun can be out of range for a step after a change of sequence or of number of pages
+		return (pageIndexRun < pages[seqn].numPages ? pageIndexRun : 0);
+	}
+	inline StepAttributesGS getRunAttribute(int seqn, int stepn) {// step of the page being played
+		int page = getRunPage(seqn);
+		return (page == loadedPage[seqn] ? attributes[seqn][stepn] : pages[seqn].getAttribute(page, stepn));
+	}
+	bool movePageIndexRun(int seqn) {// called when the steps cross their boundary, returns true when the last page was played
+		if (++pageIndexRun < pages[seqn].numPages)
+			return false;
+		pageIndexRun = 0;
+		return true;
+	}
+	bool selectPage(int seqn, int page) {// loads a page in attributes, where it is edited; returns false when the pages' pool is too full to store the current page
+		if (page == loadedPage[seqn])
+			return true;
+		if (!pages[seqn].storePage(loadedPage[seqn], attributes[seqn]))
+			return false;
+		pages[seqn].loadPage(page, attributes[seqn]);
+		loadedPage[seqn] = page;
+		updateGateBits(seqn);
+		return true;
+	}
+	void setNumPages(int seqn, int numPages) {// pages beyond numPages keep their steps
+		if (loadedPage[seqn] >= numPages && !selectPage(seqn, numPages - 1))
+			return;
+		pages[seqn].numPages = numPages;
+	}
 
 };// GateSeq64 : module
 
 struct GateSeq64Widget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 		
-	struct SequenceDisplayWidget : TransparentWidget {
+	struct SequenceDisplayWidget : CachedDisplayWidget {
 		GateSeq64 *module;
 		std::shared_ptr<Font> font;
 		char displayStr[4];
@@ -1181,14 +1415,7 @@ struct GateSeq64Widget : ModuleWidget {
 				snprintf(displayStr, 4, "%s", modeLabels[num].c_str());
 		}
 
-		void draw(const DrawArgs &args) override {
-			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
-			nvgFontFaceId(args.vg, font->handle);
-			Vec textPos = Vec(6, 24);
-			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
-			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
-			nvgFillColor(args.vg, textColor);				
-			
+		void printState(DisplayState &state) override {
 			if (module == NULL) {
 				snprintf(displayStr, 4, "  1");
 			}
@@ -1260,6 +1487,16 @@ struct GateSeq64Widget : ModuleWidget {
 					snprintf(displayStr, 4, "%c%2u", specialCode, (unsigned)(dispVal) + 1 );
 				}
 			}
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
+			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
+			nvgFontFaceId(args.vg, font->handle);
+			Vec textPos = Vec(6, 24);
+			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
+			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
+			nvgFillColor(args.vg, textColor);
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};	
@@ -1283,6 +1520,24 @@ struct GateSeq64Widget : ModuleWidget {
 			module->stopAtEndOfSong = !module->stopAtEndOfSong;
 		}
 	};
+	struct PreRollProbItem : MenuItem {
+		GateSeq64 *module;
+		void onAction(const event::Action &e) override {
+			module->preRollProb = !module->preRollProb;
+		}
+	};
+	struct PolyGatesItem : MenuItem {
+		GateSeq64 *module;
+		void onAction(const event::Action &e) override {
+			module->polyGates = !module->polyGates;
+		}
+	};
+	struct MergeChainedGatesItem : MenuItem {
+		GateSeq64 *module;
+		void onAction(const event::Action &e) override {
+			module->mergeChainedGates = !module->mergeChainedGates;
+		}
+	};
 	struct AutoseqItem : MenuItem {
 		GateSeq64 *module;
 		void onAction(const event::Action &e) override {
@@ -1349,6 +1604,18 @@ struct GateSeq64Widget : ModuleWidget {
 		loopItem->module = module;
 		menu->addChild(loopItem);
 
+		PreRollProbItem *preRollItem = createMenuItem<PreRollProbItem>("Pre-roll probabilities (show on steps)", CHECKMARK(module->preRollProb));
+		preRollItem->module = module;
+		menu->addChild(preRollItem);
+
+		PolyGatesItem *polyItem = createMenuItem<PolyGatesItem>("Poly gates on first output (4 rows)", CHECKMARK(module->polyGates));
+		polyItem->module = module;
+		menu->addChild(polyItem);
+
+		MergeChainedGatesItem *mergeItem = createMenuItem<MergeChainedGatesItem>("Add rows of chained GateSeq64s to poly gates", CHECKMARK(module->mergeChainedGates));
+		mergeItem->module = module;
+		menu->addChild(mergeItem);
+
 		SeqCVmethodItem *seqcvItem = createMenuItem<SeqCVmethodItem>("Seq CV in level", RIGHT_ARROW);
 		seqcvItem->module = module;
 		menu->addChild(seqcvItem);
@@ -1368,6 +1635,16 @@ struct GateSeq64Widget : ModuleWidget {
 		expItem->model = modelGateSeq64Expander;
 		expItem->posit = box.pos.plus(math::Vec(box.size.x,0));
 		menu->addChild(expItem);	
+
+#ifdef IM_PROFILE
+		menu->addChild(new MenuLabel());// empty line
+
+		ProfileMenuItem *profItem = createMenuItem<ProfileMenuItem>("Performance", RIGHT_ARROW);
+		profItem->profiler = &module->profiler;
+		profItem->moduleName = "GateSeq64";
+		profItem->moduleId = module->id;
+		menu->addChild(profItem);
+#endif
 	}	
 	
 	struct CKSSThreeInvNotify : CKSSThreeInvNoRandom {
@@ -1442,7 +1719,7 @@ struct GateSeq64Widget : ModuleWidget {
 					int step = paramQuantity->paramId - GateSeq64::STEP_PARAMS;
 					if ( (step >= 0) && (step < 64) ) {
 						module->lastStep = step;
-						module->lastValue = !module->attributes[module->sequence][step].getGate();// negate since event to toggle has yet to occur
+						module->lastValue = !module->getGate(module->sequence, step);// negate since event to toggle has yet to occur
 					}
 				}
 			}
@@ -1455,7 +1732,7 @@ struct GateSeq64Widget : ModuleWidget {
 				if (module->isEditingSequence() && module->displayState != GateSeq64::DISP_LENGTH && module->displayState != GateSeq64::DISP_MODES) {
 					int step = paramQuantity->paramId - GateSeq64::STEP_PARAMS;
 					if ( (step != module->lastStep) && (step >= 0) && (step < 64)) {
-						module->attributes[module->sequence][step].setGate(module->lastValue);
+						module->setGate(module->sequence, step, module->lastValue);
 					}
 				}
 			}
@@ -1469,8 +1746,10 @@ struct GateSeq64Widget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/GateSeq64.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/GateSeq64_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/GateSeq64_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -1583,14 +1862,6 @@ struct GateSeq64Widget : ModuleWidget {
 		for (int iSides = 0; iSides < 4; iSides++)
 			addOutput(createDynamicPort<IMPort>(Vec(311, rowRulerC0 + iSides * 40), false, module, GateSeq64::GATE_OUTPUTS + iSides, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((GateSeq64*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((GateSeq64*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelGateSeq64 = createModel<GateSeq64, GateSeq64Widget>("Gate-Seq-64");
@@ -25,51 +25,66 @@ struct GateSeq64Expander : Module {
 
 
 	// Expander
-	float leftMessages[2][1] = {};// messages from mother
+	ExpanderMessage<1> leftMessages[2] = {};// messages from mother
+	ExpanderMessage<13> rightMessages[2] = {};// messages from a GateSeq64 chained on the right (number of gates, then the gates)
+	ExpanderMessageReader<1> readerFromMother;
+	ExpanderMessageWriter<NUM_INPUTS + 1 + 12> writerToMother;
 
 
 	// No need to save
 	int panelTheme;
-	unsigned int expanderRefreshCounter = 0;	
+	ExpanderRefreshCounter expanderRefresh;	
 
 
 	GateSeq64Expander() {
 		config(0, NUM_INPUTS, 0, 0);
 		
-		leftExpander.producerMessage = leftMessages[0];
-		leftExpander.consumerMessage = leftMessages[1];
+		leftExpander.producerMessage = &leftMessages[0];
+		leftExpander.consumerMessage = &leftMessages[1];
+		rightExpander.producerMessage = &rightMessages[0];
+		rightExpander.consumerMessage = &rightMessages[1];
 		
 		panelTheme = (loadDarkAsDefault() ? 1 : 0);
 	}
 
 
 	void process(const ProcessArgs &args) override {		
-		expanderRefreshCounter++;
-		if (expanderRefreshCounter >= expanderRefreshStepSkips) {
-			expanderRefreshCounter = 0;
+		bool chainPresent = (rightExpander.module && rightExpander.module->model == modelGateSeq64);
+		if (expanderRefresh.process() || chainPresent) {// every sample when chained, since gates are forwarded
 			
 			bool motherPresent = (leftExpander.module && leftExpander.module->model == modelGateSeq64);
 			if (motherPresent) {
 				// To Mother
-				float *messagesToMother = (float*)leftExpander.module->rightExpander.producerMessage;
+				float *messagesToMother = writerToMother.values;
 				messagesToMother[0] = (inputs[0].isConnected() ? inputs[0].getVoltage() : std::numeric_limits<float>::quiet_NaN());
 				messagesToMother[1] = (inputs[1].isConnected() ? inputs[1].getVoltage() : std::numeric_limits<float>::quiet_NaN());
 				for (int i = 2; i < NUM_INPUTS; i++) {
 					messagesToMother[i] = inputs[i].getVoltage();
 				}
-				leftExpander.module->rightExpander.messageFlipRequested = true;
-
-				// From Mother
-				float *messagesFromMother = (float*)leftExpander.consumerMessage;
-				panelTheme = clamp((int)(messagesFromMother[0] + 0.5f), 0, 1);
-			}		
-		}// expanderRefreshCounter
+				// gates of the GateSeq64 chained on the right (its rows and those of the GateSeq64s chained after it)
+				int numChained = 0;
+				ExpanderMessage<13> *messageFromChain = (ExpanderMessage<13>*)rightExpander.consumerMessage;
+				if (chainPresent && messageFromChain->isValid()) {
+					numChained = clamp((int)(messageFromChain->values[0] + 0.5f), 0, 12);
+					for (int c = 0; c < numChained; c++) {
+						messagesToMother[NUM_INPUTS + 1 + c] = messageFromChain->values[1 + c];
+					}
+				}
+				messagesToMother[NUM_INPUTS] = (float)numChained;
+				expanderRefresh.update(writerToMother.send(leftExpander.module, leftExpander.module->rightExpander));
+			}
+			
+			// From Mother
+			ExpanderMessage<1> *messageFromMother = readerFromMother.read(leftExpander, motherPresent);
+			if (messageFromMother && readerFromMother.hasChanged(0))
+				panelTheme = clamp((int)(messageFromMother->values[0] + 0.5f), 0, 1);
+		}// expanderRefresh
 	}// process()
 };
 
 
 struct GateSeq64ExpanderWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 	
 	GateSeq64ExpanderWidget(GateSeq64Expander *module) {
 		setModule(module);
@@ -77,8 +92,10 @@ struct GateSeq64ExpanderWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/GateSeq64Expander.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/GateSeq64Expander_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/GateSeq64Expander_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -98,14 +115,6 @@ struct GateSeq64ExpanderWidget : ModuleWidget {
 		addInput(createDynamicPort<IMPort>(Vec(colRulerExp, rowRulerExpTop + rowSpacingExp * 4), true, module, GateSeq64Expander::WRITE1_INPUT, module ? &module->panelTheme : NULL));
 		addInput(createDynamicPort<IMPort>(Vec(colRulerExp, rowRulerExpTop + rowSpacingExp * 5), true, module, GateSeq64Expander::STEPL_INPUT, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((GateSeq64Expander*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((GateSeq64Expander*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelGateSeq64Expander = createModel<GateSeq64Expander, GateSeq64ExpanderWidget>("Gate-Seq-64-Expander");
@@ -8,6 +8,7 @@
 
 #include "ImpromptuModular.hpp"
 #include "PhraseSeqUtil.hpp"
+#include "GatePatternUtil.hpp"
 
 
 class StepAttributesGS {
@@ -66,6 +67,91 @@ class SeqAttributesGS {
 };// class SeqAttributesGS
 
 
+struct PagedStepsGS {
+	// Pages of a sequence (64 steps each, so up to 1024 steps), except the page that is loaded in the module's attributes.
+	// Fixed size so that page changes during process() do not allocate, and sparse: the gates of each page are a bitset, and only the steps
+	// whose probability or gate mode is not the default are kept, in a pool sorted by step number (page * 64 + step in page)
+	static const int MAX_PAGES = 16;
+	static const int MAX_OVERRIDES = 128;// steps with a non default probability or gate mode, over all the pages that are not loaded
+	static const unsigned short ATT_MSK_NOGATE = (unsigned short)~StepAttributesGS::ATT_MSK_GATE;
+	int numPages;// 1 to MAX_PAGES
+	uint64_t gateBits[MAX_PAGES];// bit s is step s of the page
+	int numOverrides;
+	unsigned short overrideSteps[MAX_OVERRIDES];// step numbers, sorted
+	unsigned short overrideAttributes[MAX_OVERRIDES];// attributes without the gate
+	
+	void init() {
+		numPages = 1;
+		numOverrides = 0;
+		for (int p = 0; p < MAX_PAGES; p++)
+			gateBits[p] = 0;
+	}
+	
+	int findOverride(int stepNum) {// index of the first override at or after stepNum
+		int lo = 0;
+		int hi = numOverrides;
+		while (lo < hi) {
+			int mid = (lo + hi) >> 1;
+			if (overrideSteps[mid] < stepNum)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+	
+	inline StepAttributesGS getAttribute(int page, int stepn) {
+		int stepNum = page * 64 + stepn;
+		int o = findOverride(stepNum);
+		StepAttributesGS attribute;
+		attribute.setAttribute((o < numOverrides && overrideSteps[o] == stepNum) ? overrideAttributes[o] : StepAttributesGS::ATT_MSK_INITSTATE);
+		attribute.setGate(((gateBits[page] >> stepn) & (uint64_t)0x1) != 0);
+		return attribute;
+	}
+	
+	bool storePage(int page, StepAttributesGS* pageSteps) {// pageSteps is the 64 steps of the page, returns false (and stores nothing) when the pool is too full
+		int numNew = 0;
+		for (int s = 0; s < 64; s++) {
+			if ((pageSteps[s].getAttribute() & ATT_MSK_NOGATE) != StepAttributesGS::ATT_MSK_INITSTATE)
+				numNew++;
+		}
+		int first = findOverride(page * 64);
+		int last = findOverride(page * 64 + 64);
+		if (numOverrides - (last - first) + numNew > MAX_OVERRIDES)
+			return false;
+		std::memmove(&overrideSteps[first + numNew], &overrideSteps[last], (numOverrides - last) * sizeof(unsigned short));
+		std::memmove(&overrideAttributes[first + numNew], &overrideAttributes[last], (numOverrides - last) * sizeof(unsigned short));
+		numOverrides += numNew - (last - first);
+		uint64_t bits = 0;
+		for (int s = 0; s < 64; s++) {
+			if (pageSteps[s].getGate())
+				bits |= ((uint64_t)0x1) << s;
+			unsigned short attrib = pageSteps[s].getAttribute() & ATT_MSK_NOGATE;
+			if (attrib != StepAttributesGS::ATT_MSK_INITSTATE) {
+				overrideSteps[first] = (unsigned short)(page * 64 + s);
+				overrideAttributes[first++] = attrib;
+			}
+		}
+		gateBits[page] = bits;
+		return true;
+	}
+	void loadPage(int page, StepAttributesGS* pageSteps) {// the page's overrides are then freed, storePage() puts them back
+		int first = findOverride(page * 64);
+		int last = findOverride(page * 64 + 64);
+		for (int s = 0; s < 64; s++)
+			pageSteps[s].setAttribute(StepAttributesGS::ATT_MSK_INITSTATE);
+		for (int o = first; o < last; o++)
+			pageSteps[overrideSteps[o] - page * 64].setAttribute(overrideAttributes[o]);
+		for (int s = 0; s < 64; s++)
+			pageSteps[s].setGate(((gateBits[page] >> s) & (uint64_t)0x1) != 0);
+		std::memmove(&overrideSteps[first], &overrideSteps[last], (numOverrides - last) * sizeof(unsigned short));
+		std::memmove(&overrideAttributes[first], &overrideAttributes[last], (numOverrides - last) * sizeof(unsigned short));
+		numOverrides -= (last - first);
+		gateBits[page] = 0;
+	}
+};
+
+
 //*****************************************************************************
 
 
@@ -92,18 +178,15 @@ inline bool calcGate(int gateCode, Trigger clockTrigger) {
 }		
 
 
-//										1/4		DUO			D2			TR1		TR2		TR3 		TR23	   TRI
-const uint32_t advGateHitMaskGS[8] = {0x00003F, 0x03F03F, 0x03F000, 0x00000F, 0x000F00, 0x0F0000, 0x0F0F00, 0x0F0F0F};
-
-int getAdvGateGS(int ppqnCount, int pulsesPerStep, int gateMode) { 
-	uint32_t shiftAmt = ppqnCount * (24 / pulsesPerStep);
-	return (int)((advGateHitMaskGS[gateMode] >> shiftAmt) & (uint32_t)0x1);
+inline int getAdvGateGS(int ppqnCount, int pulsesPerStep, int gateMode) { 
+	return gatePatterns[gateModeToPatternGS[gateMode]].getAdvGate(ppqnCount, pulsesPerStep, 24);
 }	
 
 
-int calcGateCode(StepAttributesGS attribute, int ppqnCount, int pulsesPerStep) {
+inline int calcGateCode(StepAttributesGS attribute, int ppqnCount, int pulsesPerStep, int preRolled = -1) {
 	// -1 = gate off for whole step, 0 = gate off for current ppqn, 1 = gate on, 2 = clock high
-	if (ppqnCount == 0 && attribute.getGateP() && !(random::uniform() < ((float)(attribute.getGatePVal())/100.0f)))// random::uniform is [0.0, 1.0), see include/util/common.hpp
+	// preRolled: -1 = draw the probability now, else pre-rolled outcome (see ProbabilityPreRoll)
+	if (ppqnCount == 0 && attribute.getGateP() && !(preRolled == -1 ? (random::uniform() < ((float)(attribute.getGatePVal())/100.0f)) : (preRolled == 1)))// random::uniform is [0.0, 1.0), see include/util/common.hpp
 		return -1;
 	if (!attribute.getGate())
 		return 0;
@@ -12,10 +12,13 @@
 
 
 Plugin *pluginInstance;
+PluginSettings pluginSettings;
+RefreshScheduler refreshScheduler;
 
 
 void init(rack::Plugin *p) {
 	pluginInstance = p;
+	pluginSettings.load();
 
 	p->addModel(modelTact);
 	p->addModel(modelTact1);
@@ -40,7 +43,35 @@ void init(rack::Plugin *p) {
 
 
 // General objects
-// none
+
+int RefreshScheduler::acquire() {
+	// slots are visited so that each run of 16 has all the input refresh phases (slot % 16) and light refresh phases 
+	//   spread over the whole interval: the phases are bit reversed counts, and the upper nibble is offset by the lower one
+	static const int bitReverse4[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+	std::lock_guard<std::mutex> lock(slotsMutex);
+	int bestSlot = 0;
+	int bestLoad = std::numeric_limits<int>::max();
+	for (int i = 0; i < NUM_SLOTS; i++) {
+		int lo = bitReverse4[i & 0xF];
+		int slot = lo | (((lo + bitReverse4[i >> 4]) & 0xF) << 4);
+		if (load[slot] < bestLoad) {
+			bestSlot = slot;
+			bestLoad = load[slot];
+		}
+	}
+	load[bestSlot]++;
+	return bestSlot;
+}
+
+void RefreshScheduler::release(int slot) {
+	std::lock_guard<std::mutex> lock(slotsMutex);
+	load[slot]--;
+}
+
+int RefreshScheduler::getLoad(int slot) {
+	std::lock_guard<std::mutex> lock(slotsMutex);
+	return load[slot];
+}
 
 
 // General functions
@@ -61,30 +92,46 @@ NVGcolor prepareDisplay(NVGcontext *vg, Rect *box, int fontSize) {
 	return textColor;
 }
 
-void printNote(float cvVal, char* text, bool sharp) {// text must be at least 4 chars long (three displayed chars plus end of string)
-	static const char noteLettersSharp[12] = {'C', 'C', 'D', 'D', 'E', 'F', 'F', 'G', 'G', 'A', 'A', 'B'};
-	static const char noteLettersFlat [12] = {'C', 'D', 'D', 'E', 'E', 'F', 'G', 'G', 'A', 'A', 'B', 'B'};
-	static const char isBlackKey      [12] = { 0,   1,   0,   1,   0,   0,   1,   0,   1,   0,   1,   0 };
+struct NoteLabelTable {
+	// the labels printed by printNote(), indexed by sharp/flat and by semitone (octave slot * 12 + note), 
+	//   where octave slots are octaves -1 (printed as '_') to 10 (printed as ':')
+	static const int NUM_OCTAVE_SLOTS = 12;
+	char labels[2][NUM_OCTAVE_SLOTS * 12][4];
+	
+	NoteLabelTable() {
+		static const char noteLettersSharp[12] = {'C', 'C', 'D', 'D', 'E', 'F', 'F', 'G', 'G', 'A', 'A', 'B'};
+		static const char noteLettersFlat [12] = {'C', 'D', 'D', 'E', 'E', 'F', 'G', 'G', 'A', 'A', 'B', 'B'};
+		static const char isBlackKey      [12] = { 0,   1,   0,   1,   0,   0,   1,   0,   1,   0,   1,   0 };
+		for (int sharp = 0; sharp < 2; sharp++) {
+			for (int octaveSlot = 0; octaveSlot < NUM_OCTAVE_SLOTS; octaveSlot++) {
+				int octave = octaveSlot - 1;
+				for (int indexNote = 0; indexNote < 12; indexNote++) {
+					char* text = labels[sharp][octaveSlot * 12 + indexNote];
+					// note letter
+					text[0] = sharp ? noteLettersSharp[indexNote] : noteLettersFlat[indexNote];
+					// octave number
+					if (octave < 0 || octave > 9)
+						text[1] = (octave > 9) ? ':' : '_';
+					else
+						text[1] = (char) ( 0x30 + octave);
+					// sharp/flat
+					text[2] = ' ';
+					if (isBlackKey[indexNote] == 1)
+						text[2] = (sharp ? '\"' : 'b' );
+					text[3] = 0;
+				}
+			}
+		}
+	}
+};
+static const NoteLabelTable noteLabelTable;
 
+void printNote(float cvVal, char* text, bool sharp) {// text must be at least 4 chars long (three displayed chars plus end of string)
 	float cvValOffset = cvVal + 10.0f;// to properly handle negative note voltages
 	int indexNote =  clamp( (int)((cvValOffset - std::floor(cvValOffset)) * 12.0f + 0.5f),  0,  11);
-	
-	// note letter
-	text[0] = sharp ? noteLettersSharp[indexNote] : noteLettersFlat[indexNote];
-	
-	// octave number
 	int octave = (int) std::round(std::floor(cvVal)+4.0f);
-	if (octave < 0 || octave > 9)
-		text[1] = (octave > 9) ? ':' : '_';
-	else
-		text[1] = (char) ( 0x30 + octave);
-	
-	// sharp/flat
-	text[2] = ' ';
-	if (isBlackKey[indexNote] == 1)
-		text[2] = (sharp ? '\"' : 'b' );
-	
-	text[3] = 0;
+	int octaveSlot = clamp(octave + 1, 0, NoteLabelTable::NUM_OCTAVE_SLOTS - 1);
+	std::memcpy(text, noteLabelTable.labels[sharp ? 1 : 0][octaveSlot * 12 + indexNote], 4);
 }
 
 int moveIndex(int index, int indexNext, int numSteps) {
@@ -109,41 +156,59 @@ int moveIndex(int index, int indexNext, int numSteps) {
 }
 
 
-void saveDarkAsDefault(bool darkAsDefault) {
+json_t *PluginSettings::toJson() {
 	json_t *settingsJ = json_object();
+	
+	// darkAsDefault
 	json_object_set_new(settingsJ, "darkAsDefault", json_boolean(darkAsDefault));
-	std::string settingsFilename = asset::user("ImpromptuModular.json");
-	FILE *file = fopen(settingsFilename.c_str(), "w");
-	if (file) {
-		json_dumpf(settingsJ, file, JSON_INDENT(2) | JSON_REAL_PRECISION(9));
-		fclose(file);
-	}
-	json_decref(settingsJ);
+	
+	return settingsJ;
 }
 
-bool loadDarkAsDefault() {
-	bool ret = false;
+void PluginSettings::fromJson(json_t *settingsJ) {
+	// darkAsDefault
+	json_t *darkAsDefaultJ = json_object_get(settingsJ, "darkAsDefault");
+	if (darkAsDefaultJ)
+		darkAsDefault = json_boolean_value(darkAsDefaultJ);
+}
+
+void PluginSettings::load() {
 	std::string settingsFilename = asset::user("ImpromptuModular.json");
 	FILE *file = fopen(settingsFilename.c_str(), "r");
 	if (!file) {
-		saveDarkAsDefault(false);
-		return ret;
+		// no settings file yet, keep the defaults
+		return;
 	}
 	json_error_t error;
 	json_t *settingsJ = json_loadf(file, 0, &error);
+	fclose(file);
 	if (!settingsJ) {
-		// invalid setting json file
+		// invalid setting json file, keep the defaults
+		return;
+	}
+	fromJson(settingsJ);
+	json_decref(settingsJ);
+}
+
+void PluginSettings::save() {
+	json_t *settingsJ = toJson();
+	std::string settingsFilename = asset::user("ImpromptuModular.json");
+	FILE *file = fopen(settingsFilename.c_str(), "w");
+	if (file) {
+		json_dumpf(settingsJ, file, JSON_INDENT(2) | JSON_REAL_PRECISION(9));
 		fclose(file);
-		saveDarkAsDefault(false);
-		return ret;
 	}
-	json_t *darkAsDefaultJ = json_object_get(settingsJ, "darkAsDefault");
-	if (darkAsDefaultJ)
-		ret = json_boolean_value(darkAsDefaultJ);
-	
-	fclose(file);
 	json_decref(settingsJ);
-	return ret;
+}
+
+
+void saveDarkAsDefault(bool darkAsDefault) {
+	pluginSettings.darkAsDefault = darkAsDefault;
+	pluginSettings.save();
+}
+
+bool loadDarkAsDefault() {
+	return pluginSettings.darkAsDefault;
 }
 
 
@@ -12,6 +12,7 @@
 
 
 #include "rack.hpp"
+#include <mutex>
 #include "comp/DynamicComponents.hpp"
 #include "comp/GenericComponents.hpp"
 
@@ -54,14 +55,40 @@ static const unsigned int expanderRefreshStepSkips = 64;
 
 // General objects
 
+struct RefreshScheduler {
+	// Plugin-wide assignment of the start values (slots) of the modules' refresh counters: each new counter takes the 
+	//   least loaded slot, so that the light refreshes, and the input refreshes that occur every 16 samples, are spread 
+	//   evenly over the modules of the patch instead of relying on random start values
+	static const int NUM_SLOTS = 256;
+	int load[NUM_SLOTS] = {};// number of refresh counters in each slot
+	std::mutex slotsMutex;
+	
+	int acquire();
+	void release(int slot);
+	int getLoad(int slot);
+};
+
+extern RefreshScheduler refreshScheduler;
+
+
 struct RefreshCounter {
 	// Note: because of stagger, and asyncronous dataFromJson, should not assume this processInputs() will return true on first run
 	// of module::process()
-	static const unsigned int displayRefreshStepSkips = 256;
+	static const unsigned int displayRefreshStepSkips = RefreshScheduler::NUM_SLOTS;
 	static const unsigned int userInputsStepSkipMask = 0xF;// sub interval of displayRefreshStepSkips, since inputs should be more responsive than lights
 	// above value should make it such that inputs are sampled > 1kHz so as to not miss 1ms triggers
 	
-	unsigned int refreshCounter = (random::u32() % displayRefreshStepSkips);// stagger start values to avoid processing peaks when many Geo and Impromptu modules in the patch
+	unsigned int refreshCounter;
+	int slot;
+	
+	RefreshCounter() {
+		slot = refreshScheduler.acquire();
+		refreshCounter = (unsigned int)slot;// stagger start values to avoid processing peaks when many Impromptu modules in the patch
+	}
+	RefreshCounter(const RefreshCounter&) = delete;
+	~RefreshCounter() {
+		refreshScheduler.release(slot);
+	}
 	
 	bool processInputs() {
 		return ((refreshCounter & userInputsStepSkipMask) == 0);
@@ -77,6 +104,117 @@ struct RefreshCounter {
 };
 
 
+// Messages between a module and its expander (and between chained modules): a header followed by the values, which 
+//   keep their indexes and conventions (ex: NaN for an unconnected input). A message of another protocol version 
+//   is ignored, and the changed mask lets the consumer skip the values that did not change since its last read.
+static const uint32_t expanderProtocolVersion = 1;
+
+template<int N>
+struct ExpanderMessage {
+	uint32_t version;// 0 until the producer has sent its first message
+	uint32_t seqNum;
+	uint32_t changed;// bit i: values[i] changed since the previous message (values 31 and up share bit 31)
+	float values[N];
+	
+	bool isValid() const {
+		return version == expanderProtocolVersion;
+	}
+};
+
+
+template<int N>
+struct ExpanderMessageWriter {
+	// Producer side: values are set and then sent to the peer; nothing is sent when no value changed, 
+	//   since the peer's consumer message already holds them (unless it is not valid, as when the peer 
+	//   is restored by an undo with the same id and cleared messages)
+	float values[N] = {};
+	float sentValues[N] = {};// own copy of the last message sent, since the two message buffers alternate
+	uint32_t seqNum = 0;
+	int peerId = -1;
+	
+	bool send(Module *peer, Module::Expander &peerExpander) {// returns true when a message was sent
+		uint32_t changed = 0;
+		if (peer->id != peerId || !((ExpanderMessage<N>*)peerExpander.consumerMessage)->isValid()) {// new or reset peer: all values are changed
+			changed = 0xFFFFFFFF;
+			peerId = peer->id;
+		}
+		else {
+			for (int i = 0; i < N; i++) {
+				if (std::memcmp(&values[i], &sentValues[i], sizeof(float)) != 0)// bitwise, so that an unchanged NaN is unchanged
+					changed |= ((uint32_t)0x1 << std::min(i, 31));
+			}
+			if (changed == 0)
+				return false;
+		}
+		std::memcpy(sentValues, values, sizeof(sentValues));
+		ExpanderMessage<N> *message = (ExpanderMessage<N>*)peerExpander.producerMessage;
+		message->version = expanderProtocolVersion;
+		message->seqNum = ++seqNum;
+		message->changed = changed;
+		std::memcpy(message->values, values, sizeof(sentValues));
+		peerExpander.messageFlipRequested = true;
+		return true;
+	}
+};
+
+
+template<int N>
+struct ExpanderMessageReader {
+	// Consumer side: read() each time the values are used, then hasChanged() tells which values changed since the 
+	//   previous read (all of them after missed messages, or when the peer is new or was absent)
+	int peerId = -1;
+	uint32_t seqNum = 0;
+	uint32_t changed = 0;
+	
+	ExpanderMessage<N>* read(Module::Expander &expander, bool peerPresent) {// returns NULL when the peer is absent or has not sent a valid message
+		ExpanderMessage<N> *message = (ExpanderMessage<N>*)expander.consumerMessage;
+		if (!peerPresent || !message->isValid()) {
+			peerId = -1;
+			changed = 0;
+			return NULL;
+		}
+		if (expander.module->id != peerId || message->seqNum - seqNum > 1) {
+			changed = 0xFFFFFFFF;
+		}
+		else {
+			changed = (message->seqNum != seqNum ? message->changed : 0);
+		}
+		peerId = expander.module->id;
+		seqNum = message->seqNum;
+		return message;
+	}
+	bool hasChanged(int i) const {
+		return ((changed >> std::min(i, 31)) & 0x1) != 0;
+	}
+};
+
+
+struct ExpanderRefreshCounter {
+	// Adaptive rate of the exchanges of an expander with its mother: every expanderRefreshStepSkips samples while 
+	//   the values sent are static, with the interval halving on each exchange that sends changed values, down to 
+	//   the mothers' input refresh rate for inputs that are modulated (sending faster is wasted, since the 
+	//   mothers don't read the values faster), and doubling back on each exchange that does not
+	static const unsigned int minStepSkips = RefreshCounter::userInputsStepSkipMask + 1;
+	unsigned int stepSkips = expanderRefreshStepSkips;
+	unsigned int refreshCounter = 0;
+	
+	bool process() {
+		refreshCounter++;
+		bool process = refreshCounter >= stepSkips;
+		if (process) {
+			refreshCounter = 0;
+		}
+		return process;
+	}
+	void update(bool sentChanges) {
+		if (sentChanges)
+			stepSkips = (stepSkips > minStepSkips ? stepSkips >> 1 : minStepSkips);
+		else
+			stepSkips = (stepSkips < expanderRefreshStepSkips ? stepSkips << 1 : expanderRefreshStepSkips);
+	}
+};
+
+
 struct Trigger : dsp::SchmittTrigger {
 	// implements a 0.1V - 1.0V SchmittTrigger (see include/dsp/digital.hpp) instead of 
 	//   calling SchmittTriggerInstance.process(math::rescale(in, 0.1f, 1.f, 0.f, 1.f))
@@ -99,6 +237,35 @@ struct Trigger : dsp::SchmittTrigger {
 };	
 
 
+template<int N>
+struct TriggerBank {
+	// N Triggers (see above) evaluated together four at a time: the states are the bits of a mask, and process() 
+	//   returns the mask of the rising edges (bit n for input n), so that callers only visit the set bits
+	static const int NUM_PADDED = (N + 3) & ~0x3;
+	uint64_t state = ~(uint64_t)0;// high, as in dsp::SchmittTrigger, so that an input already high does not trigger
+	
+	uint64_t process(const float *in) {// in has NUM_PADDED values
+		uint64_t high = 0;
+		uint64_t low = 0;
+		for (int n = 0; n < NUM_PADDED; n += 4) {
+			simd::float_4 v = simd::float_4::load(&in[n]);
+			high |= ((uint64_t)simd::movemask(v >= simd::float_4(1.0f)) << n);
+			low |= ((uint64_t)simd::movemask(v <= simd::float_4(0.1f)) << n);
+		}
+		uint64_t rising = high & ~state;
+		state = (state | high) & ~low;
+		return rising;
+	}
+	uint64_t process(std::vector<Param> &params, int firstId) {// params firstId to firstId + N - 1
+		float in[NUM_PADDED] = {};
+		for (int n = 0; n < N; n++) {
+			in[n] = params[firstId + n].getValue();
+		}
+		return process(in);
+	}
+};
+
+
 struct HoldDetect {
 	long modeHoldDetect;// 0 when not detecting, downward counter when detecting
 	
@@ -131,6 +298,31 @@ struct HoldDetect {
 // General functions
 
 
+// Fast 2^x for V/oct pitch and BPM CV conversions, about three times as fast as std::pow(2.0f, x)
+// Degree 5 polynomial on the fractional part, exponent set directly; max relative error is 1.8e-7 over 
+//   [-126 : 126], which is 0.0003 cents (at the level of float rounding itself)
+// Both are checked by fastExp2Accuracy and the fastExp2 benchmark in test/TestFundamentalUtil.cpp
+inline float fastExp2(float x) {
+	if (x < -126.0f)// not using clamp() so that no call to fmin/fmax is generated
+		x = -126.0f;
+	else if (x > 126.0f)
+		x = 126.0f;
+	int xi = (int)x;
+	if (x < (float)xi)
+		xi--;// floor
+	float f = x - (float)xi;
+	float p = 0.9999998984f + f * (0.6931544897f + f * (0.2401418182f + f * (0.05586033708f + f * (0.008949590423f + f * 0.001893754058f))));
+	int32_t bits;
+	std::memcpy(&bits, &p, sizeof(float));
+	bits += xi * (1 << 23);
+	std::memcpy(&p, &bits, sizeof(float));
+	return p;
+}
+
+inline float voltToFreq(float volts, float freqAtZeroVolts) {// V/oct
+	return freqAtZeroVolts * fastExp2(volts);
+}
+
 inline bool calcWarningFlash(long count, long countInit) {
 	if ( (count > (countInit * 2l / 4l) && count < (countInit * 3l / 4l)) || (count < (countInit * 1l / 4l)) )
 		return false;
@@ -139,10 +331,105 @@ inline bool calcWarningFlash(long count, long countInit) {
 
 NVGcolor prepareDisplay(NVGcontext *vg, Rect *box, int fontSize);
 
+struct DisplayState {
+	// what a segment display shows, printed in a fixed buffer so that the comparison done on every frame does not allocate
+	static const int CAPACITY = 64;// longer states are truncated
+	char text[CAPACITY];
+	int length = 0;
+	
+	void clear() {
+		length = 0;
+	}
+	DisplayState &operator+=(const char *str) {
+		while (*str != 0 && length < CAPACITY)
+			text[length++] = *str++;
+		return *this;
+	}
+	DisplayState &operator+=(char c) {
+		if (length < CAPACITY)
+			text[length++] = c;
+		return *this;
+	}
+	bool operator==(const DisplayState &other) const {
+		return length == other.length && std::memcmp(text, other.text, length) == 0;
+	}
+};
+
+struct CachedDisplayWidget : FramebufferWidget {
+	// Shared base of the segment displays, drawn in a framebuffer that is only redrawn when what is displayed changes:
+	//   derived displays print what they show (text and any color choice) in printState(), which is called on every frame, 
+	//   and draw it in drawDisplay(), which is only called when the printed state differs from the drawn one
+	static constexpr float margin = 2.0f;// room for the border stroke around the box
+	
+	struct DisplaySurface : TransparentWidget {
+		CachedDisplayWidget *display;
+		void draw(const DrawArgs &args) override {
+			nvgTranslate(args.vg, margin, margin);
+			display->drawDisplay(args);
+		}
+	};
+	DisplaySurface *surface;
+	DisplayState state;
+	DisplayState drawnState;
+	
+	CachedDisplayWidget() {
+		surface = new DisplaySurface();
+		surface->display = this;
+		addChild(surface);
+	}
+	
+	virtual void printState(DisplayState &state) = 0;
+	virtual void drawDisplay(const DrawArgs &args) = 0;
+	
+	void step() override {
+		state.clear();
+		printState(state);
+		if (!(state == drawnState)) {
+			drawnState = state;
+			dirty = true;
+		}
+		surface->box = Rect(Vec(-margin, -margin), box.size.plus(Vec(2.0f * margin, 2.0f * margin)));
+		FramebufferWidget::step();
+	}
+};
+
 void printNote(float cvVal, char* text, bool sharp);
 
+struct NoteLabelCache {
+	// note label of a display, only looked up again when the voltage or the sharp/flat setting changes
+	float cvVal = std::numeric_limits<float>::quiet_NaN();// so that the first print looks it up
+	bool sharp = false;
+	char label[4];
+	
+	void invalidate() {
+		cvVal = std::numeric_limits<float>::quiet_NaN();
+	}
+	
+	void print(float _cvVal, char* text, bool _sharp) {// same as printNote()
+		if (_cvVal != cvVal || _sharp != sharp) {
+			cvVal = _cvVal;
+			sharp = _sharp;
+			printNote(cvVal, label, sharp);
+		}
+		std::memcpy(text, label, 4);
+	}
+};
+
 int moveIndex(int index, int indexNext, int numSteps);
 
+// Plugin-wide settings in ImpromptuModular.json (user folder), read once when the plugin is initialized and 
+//   written only when the user changes a setting; a new setting needs its member (with its default value) and its json entries
+struct PluginSettings {
+	bool darkAsDefault = false;
+	
+	json_t *toJson();
+	void fromJson(json_t *settingsJ);
+	void load();// keeps the defaults when the file is missing or invalid, only save() writes the file
+	void save();
+};
+
+extern PluginSettings pluginSettings;
+
 void saveDarkAsDefault(bool darkAsDefault);
 bool loadDarkAsDefault();
 
@@ -12,11 +12,12 @@
 //***********************************************************************************************
 
 
-#include "PhraseSeqUtil.hpp"
+#include "PhraseSeqEngine.hpp"
 #include "comp/PianoKey.hpp"
+#include "ProfileUtil.hpp"
 
 
-struct PhraseSeq16 : Module {
+struct PhraseSeq16 : Module, PhraseSeqEngine<16, 16, NUM_MODES - 1> {
 	enum ParamIds {
 		KEYNOTE_PARAM,
 		KEYGATE_PARAM,
@@ -88,7 +89,9 @@ struct PhraseSeq16 : Module {
 	
 	
 	// Expander
-	float rightMessages[2][5] = {};// messages from expander
+	ExpanderMessage<5> rightMessages[2] = {};// messages from expander
+	ExpanderMessageReader<5> readerFromExpander;
+	ExpanderMessageWriter<1> writerToExpander;
 
 
 	// Constants
@@ -98,35 +101,19 @@ struct PhraseSeq16 : Module {
 	// Need to save, no reset
 	int panelTheme;
 	
-	// Need to save, with reset
+	// Need to save, with reset (song and sequence data are in PhraseSeqEngine)
 	bool autoseq;
 	bool autostepLen;
-	bool holdTiedNotes;
 	int seqCVmethod;// 0 is 0-10V, 1 is C4-D5#, 2 is TrigIncr
 	int pulsesPerStep;// 1 means normal gate mode, alt choices are 4, 6, 12, 24 PPS (Pulses per step)
-	bool running;
-	int runModeSong;
 	int stepIndexEdit;
 	int seqIndexEdit;
 	int phraseIndexEdit;
-	int phrases;//1 to 16
-	SeqAttributes sequences[16];
-	int phrase[16];// This is the song (series of phases; a phrase is a patten number)
-	float cv[16][16];// [-3.0 : 3.917]. First index is patten number, 2nd index is step
-	StepAttributes attributes[16][16];// First index is patten number, 2nd index is step (see enum AttributeBitMasks for details)
 	bool resetOnRun;
 	bool attached;
-	bool stopAtEndOfSong;
 
 	// No need to save, with reset
 	int displayState;
-	float cvCPbuffer[16];// copy paste buffer for CVs
-	StepAttributes attribCPbuffer[16];
-	int phraseCPbuffer[16];
-	SeqAttributes seqAttribCPbuffer;
-	bool seqCopied;
-	int countCP;// number of steps to paste (in case CPMODE_PARAM changes between copy and paste)
-	int startCP;
 	unsigned long editingGate;// 0 when no edit gate, downward step counter timer when edit gate
 	unsigned long editingType;// similar to editingGate, but just for showing remanent gate type (nothing played); uses editingGateKeyLight
 	long infoCopyPaste;// 0 when no info, positive downward step counter timer when copy, negative upward when paste
@@ -138,10 +125,7 @@ struct PhraseSeq16 : Module {
 	long lastGateEdit;
 	long editingPpqn;// 0 when no info, positive downward step counter timer when editing ppqn
 	long clockIgnoreOnReset;
-	int phraseIndexRun;
-	unsigned long phraseIndexRunHistory;
 	int stepIndexRun;
-	unsigned long stepIndexRunHistory;
 	int ppqnCount;
 	int gate1Code;
 	int gate2Code;
@@ -150,6 +134,10 @@ struct PhraseSeq16 : Module {
 
 	// No need to save, no reset
 	RefreshCounter refresh;
+	int expanderRunMode = 0;// mode CV from expander, decoded only when it changes
+#ifdef IM_PROFILE
+	ModuleProfiler profiler;
+#endif
 	float slideCVdelta;// no need to initialize, this goes with slideStepsRemain
 	float editingGateCV;// no need to initialize, this goes with editingGate (output this only when editingGate > 0)
 	int editingGateKeyLight;// no need to initialize, this goes with editingGate (use this only when editingGate > 0)
@@ -160,7 +148,7 @@ struct PhraseSeq16 : Module {
 	Trigger rightTrigger;
 	Trigger runningTrigger;
 	Trigger clockTrigger;
-	Trigger octTriggers[7];
+	TriggerBank<7> octTriggers;
 	Trigger octmTrigger;
 	Trigger gate1Trigger;
 	Trigger gate1ProbTrigger;
@@ -175,7 +163,7 @@ struct PhraseSeq16 : Module {
 	Trigger rotateTrigger;
 	Trigger transposeTrigger;
 	Trigger tiedTrigger;
-	Trigger stepTriggers[16];
+	TriggerBank<16> stepTriggers;
 	Trigger keyNoteTrigger;
 	Trigger keyGateTrigger;
 	Trigger seqCVTrigger;
@@ -189,11 +177,8 @@ struct PhraseSeq16 : Module {
 	PhraseSeq16() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		
-		rightExpander.producerMessage = rightMessages[0];
-		rightExpander.consumerMessage = rightMessages[1];
-
-		// must init those that have no-connect info to non-connected, or else mother may read 0.0 init value if ever refresh limiters make it such that after a connection of expander the mother reads before the first pass through the expander's writing code, and this may do something undesired (ex: change track in Foundry on expander connected while track CV jack is empty)
-		rightMessages[1][4] = std::numeric_limits<float>::quiet_NaN();
+		rightExpander.producerMessage = &rightMessages[0];
+		rightExpander.consumerMessage = &rightMessages[1];
 
 		char strBuf[32];
 		for (int x = 0; x < 16; x++) {
@@ -239,6 +224,7 @@ struct PhraseSeq16 : Module {
 		autoseq = false;
 		autostepLen = false;
 		holdTiedNotes = true;
+		preRollProb = false;
 		seqCVmethod = 0;
 		pulsesPerStep = 1;
 		running = true;
@@ -246,15 +232,7 @@ struct PhraseSeq16 : Module {
 		stepIndexEdit = 0;
 		seqIndexEdit = 0;
 		phraseIndexEdit = 0;
-		phrases = 4;
-		for (int i = 0; i < 16; i++) {
-			sequences[i].init(16, MODE_FWD);
-			phrase[i] = 0;
-			for (int s = 0; s < 16; s++) {
-				cv[i][s] = 0.0f;
-				attributes[i][s].init();
-			}
-		}
+		initSequences(16);
 		resetOnRun = false;
 		attached = false;
 		stopAtEndOfSong = false;
@@ -262,15 +240,7 @@ struct PhraseSeq16 : Module {
 	}
 	void resetNonJson() {
 		displayState = DISP_NORMAL;
-		for (int i = 0; i < 16; i++) {
-			cvCPbuffer[i] = 0.0f;
-			attribCPbuffer[i].init();
-			phraseCPbuffer[i] = 0;
-		}
-		seqAttribCPbuffer.init(16, MODE_FWD);
-		seqCopied = true;
-		countCP = 16;
-		startCP = 0;
+		initCopyPaste();
 		editingGate = 0ul;
 		editingType = 0ul;
 		infoCopyPaste = 0l;
@@ -285,28 +255,18 @@ struct PhraseSeq16 : Module {
 	}
 	void initRun() {// run button activated or run edge in run input jack
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
-		phraseIndexRun = (runModeSong == MODE_REV ? phrases - 1 : 0);
-		phraseIndexRunHistory = 0;
-
-		int seq = (isEditingSequence() ? seqIndexEdit : phrase[phraseIndexRun]);
-		stepIndexRun = (sequences[seq].getRunMode() == MODE_REV ? sequences[seq].getLength() - 1 : 0);
-		stepIndexRunHistory = 0;
+		int seq = initRunIndexes(isEditingSequence(), seqIndexEdit, &stepIndexRun);
 
 		ppqnCount = 0;
-		gate1Code = calcGate1Code(attributes[seq][stepIndexRun], 0, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue());
+		gate1Code = calcGate1Code(attributes[seq][stepIndexRun], 0, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue(), preRollGate1(seq, stepIndexRun, 0, params[GATE1_KNOB_PARAM].getValue()));
 		gate2Code = calcGate2Code(attributes[seq][stepIndexRun], 0, pulsesPerStep);
 		slideStepsRemain = 0ul;
 	}
 	
 	
 	void onRandomize() override {
-		if (isEditingSequence()) {
-			for (int s = 0; s < 16; s++) {
-				cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
-				attributes[seqIndexEdit][s].randomize();
-			}
-			sequences[seqIndexEdit].randomize(16, NUM_MODES - 1);
-		}
+		if (isEditingSequence())
+			randomizeSequence(seqIndexEdit, 16);
 	}
 	
 	
@@ -324,6 +284,9 @@ struct PhraseSeq16 : Module {
 		
 		// holdTiedNotes
 		json_object_set_new(rootJ, "holdTiedNotes", json_boolean(holdTiedNotes));
+
+		// preRollProb
+		json_object_set_new(rootJ, "preRollProb", json_boolean(preRollProb));
 		
 		// seqCVmethod
 		json_object_set_new(rootJ, "seqCVmethod", json_integer(seqCVmethod));
@@ -355,27 +318,8 @@ struct PhraseSeq16 : Module {
 			json_array_insert_new(sequencesJ, i, json_integer(sequences[i].getSeqAttrib()));
 		json_object_set_new(rootJ, "sequences", sequencesJ);
 		
-		// phrase 
-		json_t *phraseJ = json_array();
-		for (int i = 0; i < 16; i++)
-			json_array_insert_new(phraseJ, i, json_integer(phrase[i]));
-		json_object_set_new(rootJ, "phrase", phraseJ);
-
-		// CV
-		json_t *cvJ = json_array();
-		for (int i = 0; i < 16; i++)
-			for (int s = 0; s < 16; s++) {
-				json_array_insert_new(cvJ, s + (i * 16), json_real(cv[i][s]));
-			}
-		json_object_set_new(rootJ, "cv", cvJ);
-
-		// attributes
-		json_t *attributesJ = json_array();
-		for (int i = 0; i < 16; i++)
-			for (int s = 0; s < 16; s++) {
-				json_array_insert_new(attributesJ, s + (i * 16), json_integer(attributes[i][s].getAttribute()));
-			}
-		json_object_set_new(rootJ, "attributes", attributesJ);
+		// phrase, CV and attributes
+		engineToJson(rootJ);
 
 		// resetOnRun
 		json_object_set_new(rootJ, "resetOnRun", json_boolean(resetOnRun));
@@ -412,6 +356,11 @@ struct PhraseSeq16 : Module {
 		else
 			holdTiedNotes = false;// legacy
 		
+		// preRollProb
+		json_t *preRollProbJ = json_object_get(rootJ, "preRollProb");
+		if (preRollProbJ)
+			preRollProb = json_is_true(preRollProbJ);
+		
 		// seqCVmethod
 		json_t *seqCVmethodJ = json_object_get(rootJ, "seqCVmethod");
 		if (seqCVmethodJ)
@@ -547,38 +496,8 @@ struct PhraseSeq16 : Module {
 			}
 		}
 		
-		// phrase
-		json_t *phraseJ = json_object_get(rootJ, "phrase");
-		if (phraseJ)
-			for (int i = 0; i < 16; i++)
-			{
-				json_t *phraseArrayJ = json_array_get(phraseJ, i);
-				if (phraseArrayJ)
-					phrase[i] = json_integer_value(phraseArrayJ);
-			}
-			
-		// CV
-		json_t *cvJ = json_object_get(rootJ, "cv");
-		if (cvJ) {
-			for (int i = 0; i < 16; i++)
-				for (int s = 0; s < 16; s++) {
-					json_t *cvArrayJ = json_array_get(cvJ, s + (i * 16));
-					if (cvArrayJ)
-						cv[i][s] = json_number_value(cvArrayJ);
-				}
-		}
-
-		// attributes
-		json_t *attributesJ = json_object_get(rootJ, "attributes");
-		if (attributesJ) {
-			for (int i = 0; i < 16; i++)
-				for (int s = 0; s < 16; s++) {
-					json_t *attributesArrayJ = json_array_get(attributesJ, s + (i * 16));
-					if (attributesArrayJ)
-						attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
-				}
-		}
-		else {// legacy
+		// phrase, CV and attributes
+		if (!engineFromJson(rootJ)) {// legacy
 			for (int i = 0; i < 16; i++)
 				for (int s = 0; s < 16; s++)
 					attributes[i][s].setAttribute(0u);
@@ -653,30 +572,6 @@ struct PhraseSeq16 : Module {
 	}
 
 
-	void rotateSeq(int seqNum, bool directionRight, int seqLength) {
-		float rotCV;
-		StepAttributes rotAttributes;
-		int iStart = 0;
-		int iEnd = seqLength - 1;
-		int iRot = iStart;
-		int iDelta = 1;
-		if (directionRight) {
-			iRot = iEnd;
-			iDelta = -1;
-		}
-		rotCV = cv[seqNum][iRot];
-		rotAttributes = attributes[seqNum][iRot];
-		for ( ; ; iRot += iDelta) {
-			if (iDelta == 1 && iRot >= iEnd) break;
-			if (iDelta == -1 && iRot <= iStart) break;
-			cv[seqNum][iRot] = cv[seqNum][iRot + iDelta];
-			attributes[seqNum][iRot] = attributes[seqNum][iRot + iDelta];
-		}
-		cv[seqNum][iRot] = rotCV;
-		attributes[seqNum][iRot] = rotAttributes;
-	}
-	
-
 	void process(const ProcessArgs &args) override {
 		float sampleRate = args.sampleRate;
 		static const float gateTime = 0.4f;// seconds
@@ -685,11 +580,16 @@ struct PhraseSeq16 : Module {
 		static const float holdDetectTime = 2.0f;// seconds
 		static const float editGateLengthTime = 3.5f;// seconds
 		
-		bool expanderPresent = (rightExpander.module && rightExpander.module->model == modelPhraseSeqExpander);
-		float *messagesFromExpander = (float*)rightExpander.consumerMessage;// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
+		PROFILE_BEGIN(profiler, PROF_EXPANDER);
+		ExpanderMessage<5> *messageFromExpander = readerFromExpander.read(rightExpander, rightExpander.module && rightExpander.module->model == modelPhraseSeqExpander);
+		bool expanderPresent = (messageFromExpander != NULL);
+		float *messagesFromExpander = (expanderPresent ? messageFromExpander->values : NULL);
+		if (expanderPresent && readerFromExpander.hasChanged(4) && !std::isnan(messagesFromExpander[4]))// decoded on each read, since hasChanged() only holds for the read that received the changes
+			expanderRunMode = (int) clamp( std::round(messagesFromExpander[4] * ((float)NUM_SEQ_MODES - 1.0f) / 10.0f), 0.0f, (float)NUM_SEQ_MODES - 1.0f );
 		
 		
 		//********** Buttons, knobs, switches and inputs **********
+		PROFILE_NEXT(PROF_INPUTS);
 		
 		// Edit mode
 		bool editingSequence = isEditingSequence();// true = editing sequence, false = editing song
@@ -724,9 +624,8 @@ struct PhraseSeq16 : Module {
 			
 			// Mode CV input
 			if (expanderPresent && editingSequence) {
-				float modeCVin = messagesFromExpander[4];
-				if (!std::isnan(modeCVin))
-					sequences[seqIndexEdit].setRunMode((int) clamp( std::round(modeCVin * ((float)NUM_MODES - 1.0f - 1.0f) / 10.0f), 0.0f, (float)NUM_MODES - 1.0f - 1.0f ));
+				if (!std::isnan(messagesFromExpander[4]))
+					sequences[seqIndexEdit].setRunMode(expanderRunMode);
 			}
 			
 			// Attach button
@@ -744,27 +643,7 @@ struct PhraseSeq16 : Module {
 			// Copy button
 			if (copyTrigger.process(params[COPY_PARAM].getValue())) {
 				if (!attached) {
-					startCP = editingSequence ? stepIndexEdit : phraseIndexEdit;
-					countCP = 16;
-					if (params[CPMODE_PARAM].getValue() > 1.5f)// all
-						startCP = 0;
-					else if (params[CPMODE_PARAM].getValue() < 0.5f)// 4
-						countCP = std::min(4, 16 - startCP);
-					else// 8
-						countCP = std::min(8, 16 - startCP);
-					if (editingSequence) {
-						for (int i = 0, s = startCP; i < countCP; i++, s++) {
-							cvCPbuffer[i] = cv[seqIndexEdit][s];
-							attribCPbuffer[i] = attributes[seqIndexEdit][s];
-						}
-						seqAttribCPbuffer.setSeqAttrib(sequences[seqIndexEdit].getSeqAttrib());
-						seqCopied = true;
-					}
-					else {
-						for (int i = 0, p = startCP; i < countCP; i++, p++)
-							phraseCPbuffer[i] = phrase[p];
-						seqCopied = false;// so that a cross paste can be detected
-					}
+					copy(editingSequence, seqIndexEdit, editingSequence ? stepIndexEdit : phraseIndexEdit, params[CPMODE_PARAM].getValue());
 					infoCopyPaste = (long) (revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					displayState = DISP_NORMAL;
 				}
@@ -775,72 +654,8 @@ struct PhraseSeq16 : Module {
 			if (pasteTrigger.process(params[PASTE_PARAM].getValue())) {
 				if (!attached) {
 					infoCopyPaste = (long) (-1 * revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-					startCP = 0;
-					if (countCP <= 8) {
-						startCP = editingSequence ? stepIndexEdit : phraseIndexEdit;
-						countCP = std::min(countCP, 16 - startCP);
-					}
-					// else nothing to do for ALL
-
-					if (editingSequence) {
-						if (seqCopied) {// non-crossed paste (seq vs song)
-							for (int i = 0, s = startCP; i < countCP; i++, s++) {
-								cv[seqIndexEdit][s] = cvCPbuffer[i];
-								attributes[seqIndexEdit][s] = attribCPbuffer[i];
-							}
-							if (params[CPMODE_PARAM].getValue() > 1.5f) {// all
-								sequences[seqIndexEdit].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
-							}
-						}
-						else {// crossed paste to seq (seq vs song)
-							if (params[CPMODE_PARAM].getValue() > 1.5f) { // ALL (init steps)
-								for (int s = 0; s < 16; s++) {
-									//cv[seqIndexEdit][s] = 0.0f;
-									//attributes[seqIndexEdit][s].init();
-									attributes[seqIndexEdit][s].toggleGate1();
-								}
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
-							}
-							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (randomize CVs)
-								for (int s = 0; s < 16; s++)
-									cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
-							}
-							else {// 8 (randomize gate 1)
-								for (int s = 0; s < 16; s++)
-									if ( (random::u32() & 0x1) != 0)
-										attributes[seqIndexEdit][s].toggleGate1();
-							}
-							startCP = 0;
-							countCP = 16;
-							infoCopyPaste *= 2l;
-						}
-					}
-					else {
-						if (!seqCopied) {// non-crossed paste (seq vs song)
-							for (int i = 0, p = startCP; i < countCP; i++, p++)
-								phrase[p] = phraseCPbuffer[i];
-						}
-						else {// crossed paste to song (seq vs song)
-							if (params[CPMODE_PARAM].getValue() > 1.5f) { // ALL (init phrases)
-								for (int p = 0; p < 16; p++)
-									phrase[p] = 0;
-							}
-							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (phrases increase from 1 to 16)
-								for (int p = 0; p < 16; p++)
-									phrase[p] = p;						
-							}
-							else {// 8 (randomize phrases)
-								for (int p = 0; p < 16; p++)
-									phrase[p] = random::u32() % 16;
-							}
-							startCP = 0;
-							countCP = 16;
-							infoCopyPaste *= 2l;
-						}					
-					}
+					if (paste(editingSequence, seqIndexEdit, editingSequence ? stepIndexEdit : phraseIndexEdit, params[CPMODE_PARAM].getValue(), 16))
+						infoCopyPaste *= 2l;// crossed paste
 					displayState = DISP_NORMAL;
 				}
 				else
@@ -899,11 +714,8 @@ struct PhraseSeq16 : Module {
 			}
 			
 			// Step button presses
-			int stepPressed = -1;
-			for (int i = 0; i < 16; i++) {
-				if (stepTriggers[i].process(params[STEP_PHRASE_PARAMS + i].getValue()))
-					stepPressed = i;
-			}
+			uint64_t stepsPressed = stepTriggers.process(params, STEP_PHRASE_PARAMS);
+			int stepPressed = (stepsPressed != 0 ? 63 - __builtin_clzll(stepsPressed) : -1);// the last one when many are pressed
 			if (stepPressed != -1) {
 				if (displayState == DISP_LENGTH) {
 					if (editingSequence)
@@ -983,7 +795,7 @@ struct PhraseSeq16 : Module {
 					else if (displayState == DISP_MODE) {
 						if (editingSequence) {
 							if (!expanderPresent || std::isnan(messagesFromExpander[4])) {
-								sequences[seqIndexEdit].setRunMode(clamp(sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, (NUM_MODES - 1 - 1)));
+								sequences[seqIndexEdit].setRunMode(clamp(sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, (NUM_SEQ_MODES - 1)));
 							}
 						}
 						else {
@@ -1046,19 +858,19 @@ struct PhraseSeq16 : Module {
 			}	
 			
 			// Octave buttons
-			for (int i = 0; i < 7; i++) {
-				if (octTriggers[i].process(params[OCTAVE_PARAM + i].getValue())) {
-					if (editingSequence) {
-						displayState = DISP_NORMAL;
-						if (attributes[seqIndexEdit][stepIndexEdit].getTied())
-							tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-						else {			
-							cv[seqIndexEdit][stepIndexEdit] = applyNewOct(cv[seqIndexEdit][stepIndexEdit], 6 - i);
-							propagateCVtoTied(seqIndexEdit, stepIndexEdit);
-							editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-							editingGateCV = cv[seqIndexEdit][stepIndexEdit];
-							editingGateKeyLight = -1;
-						}
+			uint64_t octsPressed = octTriggers.process(params, OCTAVE_PARAM);
+			for (; octsPressed != 0; octsPressed &= (octsPressed - 1)) {
+				int i = __builtin_ctzll(octsPressed);
+				if (editingSequence) {
+					displayState = DISP_NORMAL;
+					if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+						tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
+					else {			
+						cv[seqIndexEdit][stepIndexEdit] = applyNewOct(cv[seqIndexEdit][stepIndexEdit], 6 - i);
+						propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+						editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
+						editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+						editingGateKeyLight = -1;
 					}
 				}
 			}
@@ -1167,6 +979,7 @@ struct PhraseSeq16 : Module {
 		
 		
 		//********** Clock and reset **********
+		PROFILE_NEXT(PROF_CLOCK);
 		
 		// Clock
 		if (running && clockIgnoreOnReset == 0l) {
@@ -1177,29 +990,8 @@ struct PhraseSeq16 : Module {
 
 				int newSeq = seqIndexEdit;// good value when editingSequence, overwrite if not editingSequence
 				if (ppqnCount == 0) {
-					float slideFromCV = 0.0f;
-					if (editingSequence) {
-						slideFromCV = cv[seqIndexEdit][stepIndexRun];
-						moveIndexRunMode(&stepIndexRun, sequences[seqIndexEdit].getLength(), sequences[seqIndexEdit].getRunMode(), &stepIndexRunHistory);
-					}
-					else {
-						slideFromCV = cv[phrase[phraseIndexRun]][stepIndexRun];
-						int oldStepIndexRun = stepIndexRun;
-						if (moveIndexRunMode(&stepIndexRun, sequences[phrase[phraseIndexRun]].getLength(), sequences[phrase[phraseIndexRun]].getRunMode(), &stepIndexRunHistory)) {
-							int oldPhraseIndexRun = phraseIndexRun;
-							bool songLoopOver = moveIndexRunMode(&phraseIndexRun, phrases, runModeSong, &phraseIndexRunHistory);
-							// check for end of song if needed
-							if (songLoopOver && stopAtEndOfSong) {
-								running = false;
-								stepIndexRun = oldStepIndexRun;
-								phraseIndexRun = oldPhraseIndexRun;
-							}
-							else {
-								stepIndexRun = (sequences[phrase[phraseIndexRun]].getRunMode() == MODE_REV ? sequences[phrase[phraseIndexRun]].getLength() - 1 : 0);// must always refresh after phraseIndexRun has changed
-							}
-						}
-						newSeq = phrase[phraseIndexRun];
-					}
+					float slideFromCV = cv[editingSequence ? seqIndexEdit : phrase[phraseIndexRun]][stepIndexRun];
+					newSeq = moveRunIndexes(editingSequence, seqIndexEdit, &stepIndexRun);
 					
 					// Slide
 					if (attributes[newSeq][stepIndexRun].getSlide()) {
@@ -1217,7 +1009,7 @@ struct PhraseSeq16 : Module {
 						newSeq = phrase[phraseIndexRun];
 				}
 				if (gate1Code != -1 || ppqnCount == 0)
-					gate1Code = calcGate1Code(attributes[newSeq][stepIndexRun], ppqnCount, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue());
+					gate1Code = calcGate1Code(attributes[newSeq][stepIndexRun], ppqnCount, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue(), preRollGate1(newSeq, stepIndexRun, ppqnCount, params[GATE1_KNOB_PARAM].getValue()));
 				gate2Code = calcGate2Code(attributes[newSeq][stepIndexRun], ppqnCount, pulsesPerStep);
 				clockPeriod = 0ul;				
 			}
@@ -1236,6 +1028,7 @@ struct PhraseSeq16 : Module {
 		
 		
 		//********** Outputs and lights **********
+		PROFILE_NEXT(PROF_OUTPUTS);
 				
 		// CV and gates outputs
 		int seq = editingSequence ? seqIndexEdit : phrase[phraseIndexRun];
@@ -1258,6 +1051,7 @@ struct PhraseSeq16 : Module {
 			slideStepsRemain--;
 		
 		// lights
+		PROFILE_NEXT(PROF_LIGHTS);
 		if (refresh.processLights()) {
 			// Step/phrase lights
 			for (int i = 0; i < 16; i++) {
@@ -1477,10 +1271,10 @@ struct PhraseSeq16 : Module {
 				revertDisplay--;
 			}			
 			// To Expander
+			PROFILE_NEXT(PROF_EXPANDER);
 			if (rightExpander.module && rightExpander.module->model == modelPhraseSeqExpander) {
-				float *messagesToExpander = (float*)(rightExpander.module->leftExpander.producerMessage);
-				messagesToExpander[0] = (float)panelTheme;
-				rightExpander.module->leftExpander.messageFlipRequested = true;
+				writerToExpander.values[0] = (float)panelTheme;
+				writerToExpander.send(rightExpander.module, rightExpander.module->leftExpander);
 			}
 		}// lightRefreshCounter
 		
@@ -1495,46 +1289,6 @@ struct PhraseSeq16 : Module {
 		lights[id + 1].setBrightness(red);
 	}
 
-	inline void propagateCVtoTied(int seqn, int stepn) {
-		for (int i = stepn + 1; i < 16; i++) {
-			if (!attributes[seqn][i].getTied())
-				break;
-			cv[seqn][i] = cv[seqn][i - 1];
-		}	
-	}
-
-	void activateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(true);
-		if (stepn > 0) 
-			propagateCVtoTied(seqn, stepn - 1);
-		
-		if (holdTiedNotes) {// new method
-			attributes[seqn][stepn].setGate1(true);
-			for (int i = std::max(stepn, 1); i < 16 && attributes[seqn][i].getTied(); i++) {
-				attributes[seqn][i].setGate1Mode(attributes[seqn][i - 1].getGate1Mode());
-				attributes[seqn][i - 1].setGate1Mode(5);
-				attributes[seqn][i - 1].setGate1(true);
-			}
-		}
-		else {// old method
-			if (stepn > 0) {
-				attributes[seqn][stepn] = attributes[seqn][stepn - 1];
-				attributes[seqn][stepn].setTied(true);
-			}
-		}
-	}
-	
-	void deactivateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(false);
-		if (holdTiedNotes) {// new method
-			int lastGateType = attributes[seqn][stepn].getGate1Mode();
-			for (int i = stepn + 1; i < 16 && attributes[seqn][i].getTied(); i++)
-				lastGateType = attributes[seqn][i].getGate1Mode();
-			if (stepn > 0)
-				attributes[seqn][stepn - 1].setGate1Mode(lastGateType);
-		}
-		//else old method, nothing to do
-	}
 	
 	inline void setGateLight(bool gateOn, int lightIndex) {
 		if (!gateOn) {
@@ -1556,9 +1310,9 @@ struct PhraseSeq16 : Module {
 
 
 struct PhraseSeq16Widget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 
-	struct SequenceDisplayWidget : TransparentWidget {
+	struct SequenceDisplayWidget : CachedDisplayWidget {
 		PhraseSeq16 *module;
 		std::shared_ptr<Font> font;
 		char displayStr[4];
@@ -1568,18 +1322,11 @@ struct PhraseSeq16Widget : ModuleWidget {
 		}
 		
 		void runModeToStr(int num) {
-			if (num >= 0 && num < (NUM_MODES - 1))
+			if (num >= 0 && num < PhraseSeq16::NUM_SEQ_MODES)
 				snprintf(displayStr, 4, "%s", modeLabels[num].c_str());
 		}
 
-		void draw(const DrawArgs &args) override {
-			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
-			nvgFontFaceId(args.vg, font->handle);
-			Vec textPos = Vec(6, 24);
-			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
-			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
-			nvgFillColor(args.vg, textColor);
-
+		void printState(DisplayState &state) override {
 			if (module == NULL) {
 				snprintf(displayStr, 4, "  1");
 			}
@@ -1640,6 +1387,16 @@ struct PhraseSeq16Widget : ModuleWidget {
 						module->seqIndexEdit : module->phrase[module->phraseIndexEdit]) + 1 );
 				}
 			}
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
+			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
+			nvgFontFaceId(args.vg, font->handle);
+			Vec textPos = Vec(6, 24);
+			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
+			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
+			nvgFillColor(args.vg, textColor);
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};		
@@ -1674,6 +1431,12 @@ struct PhraseSeq16Widget : ModuleWidget {
 			module->holdTiedNotes = !module->holdTiedNotes;
 		}
 	};
+	struct PreRollProbItem : MenuItem {
+		PhraseSeq16 *module;
+		void onAction(const event::Action &e) override {
+			module->preRollProb = !module->preRollProb;
+		}
+	};
 	struct StopAtEndOfSongItem : MenuItem {
 		PhraseSeq16 *module;
 		void onAction(const event::Action &e) override {
@@ -1740,6 +1503,10 @@ struct PhraseSeq16Widget : ModuleWidget {
 		holdItem->module = module;
 		menu->addChild(holdItem);
 
+		PreRollProbItem *preRollItem = createMenuItem<PreRollProbItem>("Pre-roll gate 1 probabilities", CHECKMARK(module->preRollProb));
+		preRollItem->module = module;
+		menu->addChild(preRollItem);
+
 		StopAtEndOfSongItem *loopItem = createMenuItem<StopAtEndOfSongItem>("Stop at end of song", CHECKMARK(module->stopAtEndOfSong));
 		loopItem->module = module;
 		menu->addChild(loopItem);
@@ -1767,6 +1534,16 @@ struct PhraseSeq16Widget : ModuleWidget {
 		expItem->model = modelPhraseSeqExpander;
 		expItem->posit = box.pos.plus(math::Vec(box.size.x,0));
 		menu->addChild(expItem);	
+
+#ifdef IM_PROFILE
+		menu->addChild(new MenuLabel());// empty line
+
+		ProfileMenuItem *profItem = createMenuItem<ProfileMenuItem>("Performance", RIGHT_ARROW);
+		profItem->profiler = &module->profiler;
+		profItem->moduleName = "PhraseSeq16";
+		profItem->moduleId = module->id;
+		menu->addChild(profItem);
+#endif
 	}	
 	
 	struct SequenceKnob : IMBigKnobInf {
@@ -1782,8 +1559,8 @@ struct PhraseSeq16Widget : ModuleWidget {
 				else if (module->displayState == PhraseSeq16::DISP_MODE) {
 					if (module->isEditingSequence()) {
 						bool expanderPresent = (module->rightExpander.module && module->rightExpander.module->model == modelPhraseSeqExpander);
-						float *messagesFromExpander = (float*)module->rightExpander.consumerMessage;// could be invalid pointer when !expanderPresent, so read it only when expanderPresent						
-						if (!expanderPresent || std::isnan(messagesFromExpander[4])) {
+						ExpanderMessage<5> *messageFromExpander = (ExpanderMessage<5>*)module->rightExpander.consumerMessage;
+						if (!expanderPresent || !messageFromExpander->isValid() || std::isnan(messageFromExpander->values[4])) {
 							module->sequences[module->seqIndexEdit].setRunMode(MODE_FWD);
 						}
 					}
@@ -1827,8 +1604,10 @@ struct PhraseSeq16Widget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/PhraseSeq16.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/PhraseSeq16_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/PhraseSeq16_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -2028,14 +1807,6 @@ struct PhraseSeq16Widget : ModuleWidget {
 		addOutput(createDynamicPort<IMPort>(Vec(columnRulerB6, rowRulerB0), false, module, PhraseSeq16::GATE1_OUTPUT, module ? &module->panelTheme : NULL));
 		addOutput(createDynamicPort<IMPort>(Vec(columnRulerB7, rowRulerB0), false, module, PhraseSeq16::GATE2_OUTPUT, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((PhraseSeq16*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((PhraseSeq16*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelPhraseSeq16 = createModel<PhraseSeq16, PhraseSeq16Widget>("Phrase-Seq-16");
@@ -12,11 +12,12 @@
 //***********************************************************************************************
 
 
-#include "PhraseSeqUtil.hpp"
+#include "PhraseSeqEngine.hpp"
 #include "comp/PianoKey.hpp"
+#include "ProfileUtil.hpp"
 
 
-struct PhraseSeq32 : Module {
+struct PhraseSeq32 : Module, PhraseSeqEngine<32, 32, NUM_MODES> {
 	enum ParamIds {
 		LEFT_PARAM,
 		RIGHT_PARAM,
@@ -59,7 +60,7 @@ struct PhraseSeq32 : Module {
 		NUM_INPUTS
 	};
 	enum OutputIds {
-		CVA_OUTPUT,
+		CVA_OUTPUT,// A and B outputs must be in the same order (see poly outputs)
 		GATE1A_OUTPUT,
 		GATE2A_OUTPUT,
 		CVB_OUTPUT,
@@ -87,7 +88,9 @@ struct PhraseSeq32 : Module {
 	
 	
 	// Expander
-	float rightMessages[2][5] = {};// messages from expander
+	ExpanderMessage<5> rightMessages[2] = {};// messages from expander
+	ExpanderMessageReader<5> readerFromExpander;
+	ExpanderMessageWriter<1> writerToExpander;
 
 
 	// Constants
@@ -97,35 +100,20 @@ struct PhraseSeq32 : Module {
 	// Need to save, no reset
 	int panelTheme;
 	
-	// Need to save, with reset
+	// Need to save, with reset (song and sequence data are in PhraseSeqEngine)
 	bool autoseq;
 	bool autostepLen;
-	bool holdTiedNotes;
 	int seqCVmethod;// 0 is 0-10V, 1 is C4-G6, 2 is TrigIncr
 	int pulsesPerStep;// 1 means normal gate mode, alt choices are 4, 6, 12, 24 PPS (Pulses per step)
-	bool running;
-	int runModeSong;
 	int stepIndexEdit;
 	int seqIndexEdit;
 	int phraseIndexEdit;
-	int phrases;//1 to 32
-	SeqAttributes sequences[32];
-	int phrase[32];// This is the song (series of phases; a phrase is a patten number)
-	float cv[32][32];// [-3.0 : 3.917]. First index is patten number, 2nd index is step
-	StepAttributes attributes[32][32];// First index is patten number, 2nd index is step (see enum AttributeBitMasks for details)
 	bool resetOnRun;
 	bool attached;
-	bool stopAtEndOfSong;
+	bool polyOutputs;// in 2x16, the A outputs also carry channel B as their second poly channel
 
 	// No need to save, with reset
 	int displayState;
-	float cvCPbuffer[32];// copy paste buffer for CVs
-	StepAttributes attribCPbuffer[32];
-	int phraseCPbuffer[32];
-	SeqAttributes seqAttribCPbuffer;
-	bool seqCopied;
-	int countCP;// number of steps to paste (in case CPMODE_PARAM changes between copy and paste)
-	int startCP;
 	unsigned long editingGate;// 0 when no edit gate, downward step counter timer when edit gate
 	unsigned long editingType;// similar to editingGate, but just for showing remanent gate type (nothing played); uses editingGateKeyLight
 	long infoCopyPaste;// 0 when no info, positive downward step counter timer when copy, negative upward when paste
@@ -139,10 +127,7 @@ struct PhraseSeq32 : Module {
 	bool attachedChanB;
 	int stepConfig;
 	long clockIgnoreOnReset;
-	int phraseIndexRun;	
-	unsigned long phraseIndexRunHistory;
 	int stepIndexRun[2];
-	unsigned long stepIndexRunHistory;
 	int ppqnCount;
 	int gate1Code[2];
 	int gate2Code[2];
@@ -151,6 +136,10 @@ struct PhraseSeq32 : Module {
 	// No need to save, no reset
 	int stepConfigSync = 0;// 0 means no sync requested, 1 means soft sync (no reset lengths), 2 means hard (reset lengths)
 	RefreshCounter refresh;
+	int expanderRunMode = 0;// mode CV from expander, decoded only when it changes
+#ifdef IM_PROFILE
+	ModuleProfiler profiler;
+#endif
 	float slideCVdelta[2];// no need to initialize, this is a companion to slideStepsRemain	
 	float editingGateCV;// no need to initialize, this is a companion to editingGate (output this only when editingGate > 0)
 	int editingGateKeyLight;// no need to initialize, this is a companion to editingGate (use this only when editingGate > 0)
@@ -162,7 +151,7 @@ struct PhraseSeq32 : Module {
 	Trigger rightTrigger;
 	Trigger runningTrigger;
 	Trigger clockTrigger;
-	Trigger octTriggers[7];
+	TriggerBank<7> octTriggers;
 	Trigger octmTrigger;
 	Trigger gate1Trigger;
 	Trigger gate1ProbTrigger;
@@ -177,7 +166,7 @@ struct PhraseSeq32 : Module {
 	Trigger rotateTrigger;
 	Trigger transposeTrigger;
 	Trigger tiedTrigger;
-	Trigger stepTriggers[32];
+	TriggerBank<32> stepTriggers;
 	Trigger keyNoteTrigger;
 	Trigger keyGateTrigger;
 	Trigger seqCVTrigger;
@@ -216,11 +205,8 @@ struct PhraseSeq32 : Module {
 	PhraseSeq32() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		
-		rightExpander.producerMessage = rightMessages[0];
-		rightExpander.consumerMessage = rightMessages[1];
-
-		// must init those that have no-connect info to non-connected, or else mother may read 0.0 init value if ever refresh limiters make it such that after a connection of expander the mother reads before the first pass through the expander's writing code, and this may do something undesired (ex: change track in Foundry on expander connected while track CV jack is empty)
-		rightMessages[1][4] = std::numeric_limits<float>::quiet_NaN();
+		rightExpander.producerMessage = &rightMessages[0];
+		rightExpander.consumerMessage = &rightMessages[1];
 
 		configParam(CONFIG_PARAM, 0.0f, 1.0f, 0.0f, "Configuration (1, 2 chan)");
 		char strBuf[32];
@@ -271,6 +257,7 @@ struct PhraseSeq32 : Module {
 		autoseq = false;
 		autostepLen = false;
 		holdTiedNotes = true;
+		preRollProb = false;
 		seqCVmethod = 0;// 0 is 0-10V, 1 is C4-G6, 2 is TrigIncr
 		pulsesPerStep = 1;
 		running = true;
@@ -278,31 +265,16 @@ struct PhraseSeq32 : Module {
 		stepIndexEdit = 0;
 		seqIndexEdit = 0;
 		phraseIndexEdit = 0;
-		phrases = 4;
-		for (int i = 0; i < 32; i++) {
-			sequences[i].init(16 * getStepConfig(), MODE_FWD);
-			phrase[i] = 0;
-			for (int s = 0; s < 32; s++) {
-				cv[i][s] = 0.0f;
-				attributes[i][s].init();
-			}
-		}
+		initSequences(16 * getStepConfig());
 		resetOnRun = false;
 		attached = false;
 		stopAtEndOfSong = false;
+		polyOutputs = false;
 		resetNonJson(false);
 	}
 	void resetNonJson(bool delayed) {// delay thread sensitive parts (i.e. schedule them so that process() will do them)
 		displayState = DISP_NORMAL;
-		for (int i = 0; i < 32; i++) {
-			cvCPbuffer[i] = 0.0f;
-			attribCPbuffer[i].init();
-			phraseCPbuffer[i] = 0;
-		}
-		seqAttribCPbuffer.init(32, MODE_FWD);
-		seqCopied = true;
-		countCP = 32;
-		startCP = 0;
+		initCopyPaste();
 		editingGate = 0ul;
 		editingType = 0ul;
 		infoCopyPaste = 0l;
@@ -324,17 +296,12 @@ struct PhraseSeq32 : Module {
 	}
 	void initRun() {// run button activated, or run edge in run input jack, or stepConfig switch changed, or fromJson()
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
-		phraseIndexRun = (runModeSong == MODE_REV ? phrases - 1 : 0);
-		phraseIndexRunHistory = 0;
-
-		int seq = (isEditingSequence() ? seqIndexEdit : phrase[phraseIndexRun]);
-		stepIndexRun[0] = (sequences[seq].getRunMode() == MODE_REV ? sequences[seq].getLength() - 1 : 0);
+		int seq = initRunIndexes(isEditingSequence(), seqIndexEdit, &stepIndexRun[0]);
 		fillStepIndexRunVector(sequences[seq].getRunMode(), sequences[seq].getLength());
-		stepIndexRunHistory = 0;
 
 		ppqnCount = 0;
 		for (int i = 0; i < 2; i += stepConfig) {
-			gate1Code[i] = calcGate1Code(attributes[seq][(i * 16) + stepIndexRun[i]], 0, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue());
+			gate1Code[i] = calcGate1Code(attributes[seq][(i * 16) + stepIndexRun[i]], 0, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue(), preRollGate1(seq, (i * 16) + stepIndexRun[i], 0, params[GATE1_KNOB_PARAM].getValue()));
 			gate2Code[i] = calcGate2Code(attributes[seq][(i * 16) + stepIndexRun[i]], 0, pulsesPerStep);
 		}
 		slideStepsRemain[0] = 0ul;
@@ -343,13 +310,8 @@ struct PhraseSeq32 : Module {
 
 	
 	void onRandomize() override {
-		if (isEditingSequence()) {
-			for (int s = 0; s < 32; s++) {
-				cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
-				attributes[seqIndexEdit][s].randomize();
-			}
-			sequences[seqIndexEdit].randomize(16 * stepConfig, NUM_MODES);// ok to use stepConfig since CONFIG_PARAM is not randomizable		
-		}
+		if (isEditingSequence())
+			randomizeSequence(seqIndexEdit, 16 * stepConfig);// ok to use stepConfig since CONFIG_PARAM is not randomizable
 	}
 	
 	
@@ -367,6 +329,9 @@ struct PhraseSeq32 : Module {
 		
 		// holdTiedNotes
 		json_object_set_new(rootJ, "holdTiedNotes", json_boolean(holdTiedNotes));
+
+		// preRollProb
+		json_object_set_new(rootJ, "preRollProb", json_boolean(preRollProb));
 		
 		// seqCVmethod
 		json_object_set_new(rootJ, "seqCVmethod", json_integer(seqCVmethod));
@@ -383,30 +348,11 @@ struct PhraseSeq32 : Module {
 		// seqIndexEdit
 		json_object_set_new(rootJ, "sequence", json_integer(seqIndexEdit));
 
-		// phrase 
-		json_t *phraseJ = json_array();
-		for (int i = 0; i < 32; i++)
-			json_array_insert_new(phraseJ, i, json_integer(phrase[i]));
-		json_object_set_new(rootJ, "phrase", phraseJ);
-
 		// phrases
 		json_object_set_new(rootJ, "phrases", json_integer(phrases));
 
-		// CV
-		json_t *cvJ = json_array();
-		for (int i = 0; i < 32; i++)
-			for (int s = 0; s < 32; s++) {
-				json_array_insert_new(cvJ, s + (i * 32), json_real(cv[i][s]));
-			}
-		json_object_set_new(rootJ, "cv", cvJ);
-
-		// attributes
-		json_t *attributesJ = json_array();
-		for (int i = 0; i < 32; i++)
-			for (int s = 0; s < 32; s++) {
-				json_array_insert_new(attributesJ, s + (i * 32), json_integer(attributes[i][s].getAttribute()));
-			}
-		json_object_set_new(rootJ, "attributes", attributesJ);
+		// phrase, CV and attributes
+		engineToJson(rootJ);
 
 		// attached
 		json_object_set_new(rootJ, "attached", json_boolean(attached));
@@ -414,6 +360,9 @@ struct PhraseSeq32 : Module {
 		// stopAtEndOfSong
 		json_object_set_new(rootJ, "stopAtEndOfSong", json_boolean(stopAtEndOfSong));
 
+		// polyOutputs
+		json_object_set_new(rootJ, "polyOutputs", json_boolean(polyOutputs));
+
 		// resetOnRun
 		json_object_set_new(rootJ, "resetOnRun", json_boolean(resetOnRun));
 		
@@ -456,6 +405,11 @@ struct PhraseSeq32 : Module {
 		else
 			holdTiedNotes = false;// legacy
 		
+		// preRollProb
+		json_t *preRollProbJ = json_object_get(rootJ, "preRollProb");
+		if (preRollProbJ)
+			preRollProb = json_is_true(preRollProbJ);
+		
 		// seqCVmethod
 		json_t *seqCVmethodJ = json_object_get(rootJ, "seqCVmethod");
 		if (seqCVmethodJ)
@@ -555,42 +509,13 @@ struct PhraseSeq32 : Module {
 		if (sequenceJ)
 			seqIndexEdit = json_integer_value(sequenceJ);
 		
-		// phrase
-		json_t *phraseJ = json_object_get(rootJ, "phrase");
-		if (phraseJ)
-			for (int i = 0; i < 32; i++)
-			{
-				json_t *phraseArrayJ = json_array_get(phraseJ, i);
-				if (phraseArrayJ)
-					phrase[i] = json_integer_value(phraseArrayJ);
-			}
-		
 		// phrases
 		json_t *phrasesJ = json_object_get(rootJ, "phrases");
 		if (phrasesJ)
 			phrases = json_integer_value(phrasesJ);
 		
-		// CV
-		json_t *cvJ = json_object_get(rootJ, "cv");
-		if (cvJ) {
-			for (int i = 0; i < 32; i++)
-				for (int s = 0; s < 32; s++) {
-					json_t *cvArrayJ = json_array_get(cvJ, s + (i * 32));
-					if (cvArrayJ)
-						cv[i][s] = json_number_value(cvArrayJ);
-				}
-		}
-		
-		// attributes
-		json_t *attributesJ = json_object_get(rootJ, "attributes");
-		if (attributesJ) {
-			for (int i = 0; i < 32; i++)
-				for (int s = 0; s < 32; s++) {
-					json_t *attributesArrayJ = json_array_get(attributesJ, s + (i * 32));
-					if (attributesArrayJ)
-						attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
-				}
-		}
+		// phrase, CV and attributes
+		engineFromJson(rootJ);
 		
 		// attached
 		json_t *attachedJ = json_object_get(rootJ, "attached");
@@ -602,6 +527,11 @@ struct PhraseSeq32 : Module {
 		if (stopAtEndOfSongJ)
 			stopAtEndOfSong = json_is_true(stopAtEndOfSongJ);
 		
+		// polyOutputs
+		json_t *polyOutputsJ = json_object_get(rootJ, "polyOutputs");
+		if (polyOutputsJ)
+			polyOutputs = json_is_true(polyOutputsJ);
+		
 		// resetOnRun
 		json_t *resetOnRunJ = json_object_get(rootJ, "resetOnRun");
 		if (resetOnRunJ)
@@ -620,32 +550,6 @@ struct PhraseSeq32 : Module {
 		resetNonJson(true);
 	}
 
-	void rotateSeq(int seqNum, bool directionRight, int seqLength, bool chanB_16) {
-		// set chanB_16 to false to rotate chan A in 2x16 config (length will be <= 16) or single chan in 1x32 config (length will be <= 32)
-		// set chanB_16 to true  to rotate chan B in 2x16 config (length must be <= 16)
-		float rotCV;
-		StepAttributes rotAttributes;
-		int iStart = chanB_16 ? 16 : 0;
-		int iEnd = iStart + seqLength - 1;
-		int iRot = iStart;
-		int iDelta = 1;
-		if (directionRight) {
-			iRot = iEnd;
-			iDelta = -1;
-		}
-		rotCV = cv[seqNum][iRot];
-		rotAttributes = attributes[seqNum][iRot];
-		for ( ; ; iRot += iDelta) {
-			if (iDelta == 1 && iRot >= iEnd) break;
-			if (iDelta == -1 && iRot <= iStart) break;
-			cv[seqNum][iRot] = cv[seqNum][iRot + iDelta];
-			attributes[seqNum][iRot] = attributes[seqNum][iRot + iDelta];
-		}
-		cv[seqNum][iRot] = rotCV;
-		attributes[seqNum][iRot] = rotAttributes;
-	}
-	
-
 	void process(const ProcessArgs &args) override {
 		float sampleRate = args.sampleRate;
 		static const float gateTime = 0.4f;// seconds
@@ -654,11 +558,16 @@ struct PhraseSeq32 : Module {
 		static const float holdDetectTime = 2.0f;// seconds
 		static const float editGateLengthTime = 3.5f;// seconds
 		
-		bool expanderPresent = (rightExpander.module && rightExpander.module->model == modelPhraseSeqExpander);
-		float *messagesFromExpander = (float*)rightExpander.consumerMessage;// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
+		PROFILE_BEGIN(profiler, PROF_EXPANDER);
+		ExpanderMessage<5> *messageFromExpander = readerFromExpander.read(rightExpander, rightExpander.module && rightExpander.module->model == modelPhraseSeqExpander);
+		bool expanderPresent = (messageFromExpander != NULL);
+		float *messagesFromExpander = (expanderPresent ? messageFromExpander->values : NULL);
+		if (expanderPresent && readerFromExpander.hasChanged(4) && !std::isnan(messagesFromExpander[4]))// decoded on each read, since hasChanged() only holds for the read that received the changes
+			expanderRunMode = (int) clamp( std::round(messagesFromExpander[4] * ((float)NUM_SEQ_MODES - 1.0f) / 10.0f), 0.0f, (float)NUM_SEQ_MODES - 1.0f );
 
 		
 		//********** Buttons, knobs, switches and inputs **********
+		PROFILE_NEXT(PROF_INPUTS);
 		
 		// Edit mode
 		bool editingSequence = isEditingSequence();// true = editing sequence, false = editing song
@@ -710,9 +619,8 @@ struct PhraseSeq32 : Module {
 			
 			// Mode CV input
 			if (expanderPresent && editingSequence) {
-				float modeCVin = messagesFromExpander[4];
-				if (!std::isnan(modeCVin))
-					sequences[seqIndexEdit].setRunMode((int) clamp( std::round(modeCVin * ((float)NUM_MODES - 1.0f) / 10.0f), 0.0f, (float)NUM_MODES - 1.0f ));
+				if (!std::isnan(messagesFromExpander[4]))
+					sequences[seqIndexEdit].setRunMode(expanderRunMode);
 			}
 			
 			// Attach button
@@ -736,27 +644,7 @@ struct PhraseSeq32 : Module {
 			// Copy button
 			if (copyTrigger.process(params[COPY_PARAM].getValue())) {
 				if (!attached) {
-					startCP = editingSequence ? stepIndexEdit : phraseIndexEdit;
-					countCP = 32;
-					if (params[CPMODE_PARAM].getValue() > 1.5f)// all
-						startCP = 0;
-					else if (params[CPMODE_PARAM].getValue() < 0.5f)// 4
-						countCP = std::min(4, 32 - startCP);
-					else// 8
-						countCP = std::min(8, 32 - startCP);
-					if (editingSequence) {
-						for (int i = 0, s = startCP; i < countCP; i++, s++) {
-							cvCPbuffer[i] = cv[seqIndexEdit][s];
-							attribCPbuffer[i] = attributes[seqIndexEdit][s];
-						}
-						seqAttribCPbuffer.setSeqAttrib(sequences[seqIndexEdit].getSeqAttrib());
-						seqCopied = true;
-					}
-					else {
-						for (int i = 0, p = startCP; i < countCP; i++, p++)
-							phraseCPbuffer[i] = phrase[p];
-						seqCopied = false;// so that a cross paste can be detected
-					}
+					copy(editingSequence, seqIndexEdit, editingSequence ? stepIndexEdit : phraseIndexEdit, params[CPMODE_PARAM].getValue());
 					infoCopyPaste = (long) (revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					displayState = DISP_NORMAL;
 				}
@@ -767,74 +655,8 @@ struct PhraseSeq32 : Module {
 			if (pasteTrigger.process(params[PASTE_PARAM].getValue())) {
 				if (!attached) {
 					infoCopyPaste = (long) (-1 * revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-					startCP = 0;
-					if (countCP <= 8) {
-						startCP = editingSequence ? stepIndexEdit : phraseIndexEdit;
-						countCP = std::min(countCP, 32 - startCP);
-					}
-					// else nothing to do for ALL
-
-					if (editingSequence) {
-						if (seqCopied) {// non-crossed paste (seq vs song)
-							for (int i = 0, s = startCP; i < countCP; i++, s++) {
-								cv[seqIndexEdit][s] = cvCPbuffer[i];
-								attributes[seqIndexEdit][s] = attribCPbuffer[i];
-							}
-							if (params[CPMODE_PARAM].getValue() > 1.5f) {// all
-								sequences[seqIndexEdit].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
-								if (sequences[seqIndexEdit].getLength() > 16 * stepConfig)
-									sequences[seqIndexEdit].setLength(16 * stepConfig);
-							}
-						}
-						else {// crossed paste to seq (seq vs song)
-							if (params[CPMODE_PARAM].getValue() > 1.5f) { // ALL (init steps)
-								for (int s = 0; s < 32; s++) {
-									//cv[seqIndexEdit][s] = 0.0f;
-									//attributes[seqIndexEdit][s].init();
-									attributes[seqIndexEdit][s].toggleGate1();
-								}
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
-							}
-							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (randomize CVs)
-								for (int s = 0; s < 32; s++)
-									cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
-							}
-							else {// 8 (randomize gate 1)
-								for (int s = 0; s < 32; s++)
-									if ( (random::u32() & 0x1) != 0)
-										attributes[seqIndexEdit][s].toggleGate1();
-							}
-							startCP = 0;
-							countCP = 32;
-							infoCopyPaste *= 2l;
-						}
-					}
-					else {
-						if (!seqCopied) {// non-crossed paste (seq vs song)
-							for (int i = 0, p = startCP; i < countCP; i++, p++)
-								phrase[p] = phraseCPbuffer[i];
-						}
-						else {// crossed paste to song (seq vs song)
-							if (params[CPMODE_PARAM].getValue() > 1.5f) { // ALL (init phrases)
-								for (int p = 0; p < 32; p++)
-									phrase[p] = 0;
-							}
-							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (phrases increase from 1 to 32)
-								for (int p = 0; p < 32; p++)
-									phrase[p] = p;						
-							}
-							else {// 8 (randomize phrases)
-								for (int p = 0; p < 32; p++)
-									phrase[p] = random::u32() % 32;
-							}
-							startCP = 0;
-							countCP = 32;
-							infoCopyPaste *= 2l;
-						}					
-					}
+					if (paste(editingSequence, seqIndexEdit, editingSequence ? stepIndexEdit : phraseIndexEdit, params[CPMODE_PARAM].getValue(), 16 * stepConfig))
+						infoCopyPaste *= 2l;// crossed paste
 					displayState = DISP_NORMAL;
 				}
 				else
@@ -895,11 +717,8 @@ struct PhraseSeq32 : Module {
 			}
 
 			// Step button presses
-			int stepPressed = -1;
-			for (int i = 0; i < 32; i++) {
-				if (stepTriggers[i].process(params[STEP_PHRASE_PARAMS + i].getValue()))
-					stepPressed = i;
-			}
+			uint64_t stepsPressed = stepTriggers.process(params, STEP_PHRASE_PARAMS);
+			int stepPressed = (stepsPressed != 0 ? 63 - __builtin_clzll(stepsPressed) : -1);// the last one when many are pressed
 			if (stepPressed != -1) {
 				if (displayState == DISP_LENGTH) {
 					if (editingSequence)
@@ -988,7 +807,7 @@ struct PhraseSeq32 : Module {
 					else if (displayState == DISP_MODE) {
 						if (editingSequence) {
 							if (!expanderPresent || std::isnan(messagesFromExpander[4])) {
-								sequences[seqIndexEdit].setRunMode(clamp(sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, NUM_MODES - 1));
+								sequences[seqIndexEdit].setRunMode(clamp(sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, NUM_SEQ_MODES - 1));
 							}
 						}
 						else {
@@ -1025,7 +844,7 @@ struct PhraseSeq32 : Module {
 							sequences[seqIndexEdit].setRotate(clamp(sequences[seqIndexEdit].getRotate() + deltaKnob, -99, 99));
 							if (deltaKnob > 0 && deltaKnob < 201) {// Rotate right, 201 is safety
 								for (int i = deltaKnob; i > 0; i--) {
-									rotateSeq(seqIndexEdit, true, slength, rotChanB);
+									rotateSeq(seqIndexEdit, true, slength, rotChanB ? 16 : 0);
 									if ((stepConfig == 2 || !rotChanB ) && (stepIndexEdit < slength))
 										stepIndexEdit = (stepIndexEdit + 1) % slength;
 									if (rotChanB && (stepIndexEdit < (slength + 16)) && (stepIndexEdit >= 16))
@@ -1034,7 +853,7 @@ struct PhraseSeq32 : Module {
 							}
 							if (deltaKnob < 0 && deltaKnob > -201) {// Rotate left, 201 is safety
 								for (int i = deltaKnob; i < 0; i++) {
-									rotateSeq(seqIndexEdit, false, slength, rotChanB);
+									rotateSeq(seqIndexEdit, false, slength, rotChanB ? 16 : 0);
 									if ((stepConfig == 2 || !rotChanB ) && (stepIndexEdit < slength))
 										stepIndexEdit = (stepIndexEdit + (stepConfig * 16 - 1) ) % slength;
 									if (rotChanB && (stepIndexEdit < (slength + 16)) && (stepIndexEdit >= 16))
@@ -1066,20 +885,20 @@ struct PhraseSeq32 : Module {
 			}	
 			
 			// Octave buttons
-			for (int i = 0; i < 7; i++) {
-				if (octTriggers[i].process(params[OCTAVE_PARAM + i].getValue())) {
-					if (editingSequence) {
-						displayState = DISP_NORMAL;
-						if (attributes[seqIndexEdit][stepIndexEdit].getTied())
-							tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-						else {			
-							cv[seqIndexEdit][stepIndexEdit] = applyNewOct(cv[seqIndexEdit][stepIndexEdit], 6 - i);
-							propagateCVtoTied(seqIndexEdit, stepIndexEdit);
-							editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-							editingGateCV = cv[seqIndexEdit][stepIndexEdit];
-							editingGateKeyLight = -1;
-							editingChannel = (stepIndexEdit >= 16 * stepConfig) ? 1 : 0;
-						}
+			uint64_t octsPressed = octTriggers.process(params, OCTAVE_PARAM);
+			for (; octsPressed != 0; octsPressed &= (octsPressed - 1)) {
+				int i = __builtin_ctzll(octsPressed);
+				if (editingSequence) {
+					displayState = DISP_NORMAL;
+					if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+						tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
+					else {			
+						cv[seqIndexEdit][stepIndexEdit] = applyNewOct(cv[seqIndexEdit][stepIndexEdit], 6 - i);
+						propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+						editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
+						editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+						editingGateKeyLight = -1;
+						editingChannel = (stepIndexEdit >= 16 * stepConfig) ? 1 : 0;
 					}
 				}
 			}
@@ -1189,6 +1008,7 @@ struct PhraseSeq32 : Module {
 		
 		
 		//********** Clock and reset **********
+		PROFILE_NEXT(PROF_CLOCK);
 		
 		// Clock
 		if (running && clockIgnoreOnReset == 0l) {
@@ -1200,32 +1020,10 @@ struct PhraseSeq32 : Module {
 				int newSeq = seqIndexEdit;// good value when editingSequence, overwrite if not editingSequence
 				if (ppqnCount == 0) {
 					float slideFromCV[2] = {0.0f, 0.0f};
-					if (editingSequence) {
-						for (int i = 0; i < 2; i += stepConfig)
-							slideFromCV[i] = cv[seqIndexEdit][(i * 16) + stepIndexRun[i]];
-						moveIndexRunMode(&stepIndexRun[0], sequences[seqIndexEdit].getLength(), sequences[seqIndexEdit].getRunMode(), &stepIndexRunHistory);
-					}
-					else {
-						for (int i = 0; i < 2; i += stepConfig)
-							slideFromCV[i] = cv[phrase[phraseIndexRun]][(i * 16) + stepIndexRun[i]];
-						int oldStepIndexRun0 = stepIndexRun[0];
-						int oldStepIndexRun1 = stepIndexRun[1];
-						if (moveIndexRunMode(&stepIndexRun[0], sequences[phrase[phraseIndexRun]].getLength(), sequences[phrase[phraseIndexRun]].getRunMode(), &stepIndexRunHistory)) {
-							int oldPhraseIndexRun = phraseIndexRun;
-							bool songLoopOver = moveIndexRunMode(&phraseIndexRun, phrases, runModeSong, &phraseIndexRunHistory);
-							// check for end of song if needed
-							if (songLoopOver && stopAtEndOfSong) {
-								running = false;
-								stepIndexRun[0] = oldStepIndexRun0;
-								stepIndexRun[1] = oldStepIndexRun1;
-								phraseIndexRun = oldPhraseIndexRun;
-							}
-							else {
-								stepIndexRun[0] = (sequences[phrase[phraseIndexRun]].getRunMode() == MODE_REV ? sequences[phrase[phraseIndexRun]].getLength() - 1 : 0);// must always refresh after phraseIndexRun has changed
-							}
-						}
-						newSeq = phrase[phraseIndexRun];
-					}
+					int oldSeq = editingSequence ? seqIndexEdit : phrase[phraseIndexRun];
+					for (int i = 0; i < 2; i += stepConfig)
+						slideFromCV[i] = cv[oldSeq][(i * 16) + stepIndexRun[i]];
+					newSeq = moveRunIndexes(editingSequence, seqIndexEdit, &stepIndexRun[0]);// stepIndexRun[1] is unchanged when end of song stops the run
 					if (running)// end of song may have stopped it
 						fillStepIndexRunVector(sequences[newSeq].getRunMode(), sequences[newSeq].getLength());
 
@@ -1248,7 +1046,7 @@ struct PhraseSeq32 : Module {
 				}
 				for (int i = 0; i < 2; i += stepConfig) {
 					if (gate1Code[i] != -1 || ppqnCount == 0)
-						gate1Code[i] = calcGate1Code(attributes[newSeq][(i * 16) + stepIndexRun[i]], ppqnCount, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue());
+						gate1Code[i] = calcGate1Code(attributes[newSeq][(i * 16) + stepIndexRun[i]], ppqnCount, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue(), preRollGate1(newSeq, (i * 16) + stepIndexRun[i], ppqnCount, params[GATE1_KNOB_PARAM].getValue()));
 					gate2Code[i] = calcGate2Code(attributes[newSeq][(i * 16) + stepIndexRun[i]], ppqnCount, pulsesPerStep);	
 				}
 				clockPeriod = 0ul;
@@ -1268,6 +1066,7 @@ struct PhraseSeq32 : Module {
 		
 		
 		//********** Outputs and lights **********
+		PROFILE_NEXT(PROF_OUTPUTS);
 				
 		// CV and gates outputs
 		int seq = editingSequence ? seqIndexEdit : phrase[phraseIndexRun];
@@ -1345,12 +1144,22 @@ struct PhraseSeq32 : Module {
 				}
 			}	
 		}
+		// Poly outputs: channel B on the second channel of the A outputs (CVA, GATE1A, GATE2A), so that a single cable carries both rows
+		for (int i = 0; i < 3; i++) {
+			if (polyOutputs && stepConfig == 1) {
+				outputs[CVA_OUTPUT + i].setVoltage(outputs[CVB_OUTPUT + i].getVoltage(), 1);
+				outputs[CVA_OUTPUT + i].setChannels(2);
+			}
+			else
+				outputs[CVA_OUTPUT + i].setChannels(1);
+		}
 		for (int i = 0; i < 2; i++)
 			if (slideStepsRemain[i] > 0ul)
 				slideStepsRemain[i]--;
 
 		
 		// lights
+		PROFILE_NEXT(PROF_LIGHTS);
 		if (refresh.processLights()) {
 			// Step/phrase lights
 			for (int i = 0; i < 32; i++) {
@@ -1576,10 +1385,10 @@ struct PhraseSeq32 : Module {
 			}		
 			
 			// To Expander
+			PROFILE_NEXT(PROF_EXPANDER);
 			if (rightExpander.module && rightExpander.module->model == modelPhraseSeqExpander) {
-				float *messagesToExpander = (float*)(rightExpander.module->leftExpander.producerMessage);
-				messagesToExpander[0] = (float)panelTheme;
-				rightExpander.module->leftExpander.messageFlipRequested = true;
+				writerToExpander.values[0] = (float)panelTheme;
+				writerToExpander.send(rightExpander.module, rightExpander.module->leftExpander);
 			}
 		}// lightRefreshCounter
 				
@@ -1593,47 +1402,6 @@ struct PhraseSeq32 : Module {
 		lights[id + 1].setBrightness(red);
 	}
 
-	inline void propagateCVtoTied(int seqn, int stepn) {
-		for (int i = stepn + 1; i < 32; i++) {
-			if (!attributes[seqn][i].getTied())
-				break;
-			cv[seqn][i] = cv[seqn][i - 1];
-		}	
-	}
-
-	void activateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(true);
-		if (stepn > 0) 
-			propagateCVtoTied(seqn, stepn - 1);
-		
-		if (holdTiedNotes) {// new method
-			attributes[seqn][stepn].setGate1(true);
-			for (int i = std::max(stepn, 1); i < 32 && attributes[seqn][i].getTied(); i++) {
-				attributes[seqn][i].setGate1Mode(attributes[seqn][i - 1].getGate1Mode());
-				attributes[seqn][i - 1].setGate1Mode(5);
-				attributes[seqn][i - 1].setGate1(true);
-			}
-		}
-		else {// old method
-			if (stepn > 0) {
-				attributes[seqn][stepn] = attributes[seqn][stepn - 1];
-				attributes[seqn][stepn].setTied(true);
-			}
-		}
-	}
-	
-	void deactivateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(false);
-		if (holdTiedNotes) {// new method
-			int lastGateType = attributes[seqn][stepn].getGate1Mode();
-			for (int i = stepn + 1; i < 32 && attributes[seqn][i].getTied(); i++)
-				lastGateType = attributes[seqn][i].getGate1Mode();
-			if (stepn > 0)
-				attributes[seqn][stepn - 1].setGate1Mode(lastGateType);
-		}
-		//else old method, nothing to do
-	}
-	
 	inline void setGateLight(bool gateOn, int lightIndex) {
 		if (!gateOn) {
 			lights[lightIndex + 0].setBrightness(0.0f);
@@ -1654,9 +1422,9 @@ struct PhraseSeq32 : Module {
 
 
 struct PhraseSeq32Widget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 	
-	struct SequenceDisplayWidget : TransparentWidget {
+	struct SequenceDisplayWidget : CachedDisplayWidget {
 		PhraseSeq32 *module;
 		std::shared_ptr<Font> font;
 		char displayStr[4];
@@ -1666,18 +1434,11 @@ struct PhraseSeq32Widget : ModuleWidget {
 		}
 		
 		void runModeToStr(int num) {
-			if (num >= 0 && num < NUM_MODES)
+			if (num >= 0 && num < PhraseSeq32::NUM_SEQ_MODES)
 				snprintf(displayStr, 4, "%s", modeLabels[num].c_str());
 		}
 
-		void draw(const DrawArgs &args) override {
-			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
-			nvgFontFaceId(args.vg, font->handle);
-			Vec textPos = Vec(6, 24);
-			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
-			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
-			nvgFillColor(args.vg, textColor);
-					
+		void printState(DisplayState &state) override {
 			if (module == NULL) {
 				snprintf(displayStr, 4, "  1");
 			}
@@ -1738,6 +1499,16 @@ struct PhraseSeq32Widget : ModuleWidget {
 						module->seqIndexEdit : module->phrase[module->phraseIndexEdit]) + 1 );
 				}
 			}
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
+			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
+			nvgFontFaceId(args.vg, font->handle);
+			Vec textPos = Vec(6, 24);
+			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
+			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
+			nvgFillColor(args.vg, textColor);
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};		
@@ -1772,12 +1543,24 @@ struct PhraseSeq32Widget : ModuleWidget {
 			module->holdTiedNotes = !module->holdTiedNotes;
 		}
 	};
+	struct PreRollProbItem : MenuItem {
+		PhraseSeq32 *module;
+		void onAction(const event::Action &e) override {
+			module->preRollProb = !module->preRollProb;
+		}
+	};
 	struct StopAtEndOfSongItem : MenuItem {
 		PhraseSeq32 *module;
 		void onAction(const event::Action &e) override {
 			module->stopAtEndOfSong = !module->stopAtEndOfSong;
 		}
 	};
+	struct PolyOutputsItem : MenuItem {
+		PhraseSeq32 *module;
+		void onAction(const event::Action &e) override {
+			module->polyOutputs = !module->polyOutputs;
+		}
+	};
 	struct SeqCVmethodItem : MenuItem {
 		struct SeqCVmethodSubItem : MenuItem {
 			PhraseSeq32 *module;
@@ -1838,10 +1621,18 @@ struct PhraseSeq32Widget : ModuleWidget {
 		holdItem->module = module;
 		menu->addChild(holdItem);
 
+		PreRollProbItem *preRollItem = createMenuItem<PreRollProbItem>("Pre-roll gate 1 probabilities", CHECKMARK(module->preRollProb));
+		preRollItem->module = module;
+		menu->addChild(preRollItem);
+
 		StopAtEndOfSongItem *loopItem = createMenuItem<StopAtEndOfSongItem>("Stop at end of song", CHECKMARK(module->stopAtEndOfSong));
 		loopItem->module = module;
 		menu->addChild(loopItem);
 
+		PolyOutputsItem *polyItem = createMenuItem<PolyOutputsItem>("Poly A outputs in 2x16 (A and B)", CHECKMARK(module->polyOutputs));
+		polyItem->module = module;
+		menu->addChild(polyItem);
+
 		SeqCVmethodItem *seqcvItem = createMenuItem<SeqCVmethodItem>("Seq CV in level", RIGHT_ARROW);
 		seqcvItem->module = module;
 		menu->addChild(seqcvItem);
@@ -1865,6 +1656,16 @@ struct PhraseSeq32Widget : ModuleWidget {
 		expItem->model = modelPhraseSeqExpander;
 		expItem->posit = box.pos.plus(math::Vec(box.size.x,0));
 		menu->addChild(expItem);	
+
+#ifdef IM_PROFILE
+		menu->addChild(new MenuLabel());// empty line
+
+		ProfileMenuItem *profItem = createMenuItem<ProfileMenuItem>("Performance", RIGHT_ARROW);
+		profItem->profiler = &module->profiler;
+		profItem->moduleName = "PhraseSeq32";
+		profItem->moduleId = module->id;
+		menu->addChild(profItem);
+#endif
 	}	
 	
 	struct CKSSNotify : CKSSNoRandom {
@@ -1891,8 +1692,8 @@ struct PhraseSeq32Widget : ModuleWidget {
 				else if (module->displayState == PhraseSeq32::DISP_MODE) {
 					if (module->isEditingSequence()) {
 						bool expanderPresent = (module->rightExpander.module && module->rightExpander.module->model == modelPhraseSeqExpander);
-						float *messagesFromExpander = (float*)module->rightExpander.consumerMessage;// could be invalid pointer when !expanderPresent, so read it only when expanderPresent						
-						if (!expanderPresent || std::isnan(messagesFromExpander[4])) {
+						ExpanderMessage<5> *messageFromExpander = (ExpanderMessage<5>*)module->rightExpander.consumerMessage;
+						if (!expanderPresent || !messageFromExpander->isValid() || std::isnan(messageFromExpander->values[4])) {
 							module->sequences[module->seqIndexEdit].setRunMode(MODE_FWD);
 						}
 					}
@@ -1936,8 +1737,10 @@ struct PhraseSeq32Widget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/PhraseSeq32.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/PhraseSeq32_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/PhraseSeq32_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -2143,14 +1946,6 @@ struct PhraseSeq32Widget : ModuleWidget {
 		addOutput(createDynamicPort<IMPort>(Vec(columnRulerB7, rowRulerB0), false, module, PhraseSeq32::GATE1B_OUTPUT, module ? &module->panelTheme : NULL));
 		addOutput(createDynamicPort<IMPort>(Vec(columnRulerB8, rowRulerB0), false, module, PhraseSeq32::GATE2B_OUTPUT, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((PhraseSeq32*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((PhraseSeq32*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelPhraseSeq32 = createModel<PhraseSeq32, PhraseSeq32Widget>("Phrase-Seq-32");
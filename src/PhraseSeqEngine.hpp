@@ -0,0 +1,376 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Run/edit engine shared by PhraseSeq16, PhraseSeq32 and SemiModularSynth
+//***********************************************************************************************
+
+#ifndef PHRASE_SEQ_ENGINE_HPP
+#define PHRASE_SEQ_ENGINE_HPP
+
+
+#include "PhraseSeqUtil.hpp"
+
+
+// STEPS: number of steps per sequence, SEQS: number of sequences (and of phrases in the song),
+// MODES: number of run modes available to sequences (NUM_MODES, or NUM_MODES - 1 when no RN2)
+// The engine only depends on PhraseSeqUtil, so it can be instantiated and run without a Rack module
+
+template <int STEPS, int SEQS, int MODES>
+struct PhraseSeqEngine {
+	static const int NUM_STEPS = STEPS;
+	static const int NUM_SEQS = SEQS;
+	static const int NUM_SEQ_MODES = MODES;
+
+	// Need to save, with reset
+	bool holdTiedNotes;
+	bool running;
+	int runModeSong;
+	int phrases;// 1 to SEQS
+	SeqAttributes sequences[SEQS];
+	int phrase[SEQS];// This is the song (series of phases; a phrase is a patten number)
+	float cv[SEQS][STEPS];// [-3.0 : 3.917]. First index is patten number, 2nd index is step
+	StepAttributes attributes[SEQS][STEPS];// First index is patten number, 2nd index is step (see enum AttributeBitMasks for details)
+	bool stopAtEndOfSong;
+	bool preRollProb;// gate 1 probabilities drawn per pass
+
+	// No need to save, with reset
+	float cvCPbuffer[STEPS];// copy paste buffer for CVs
+	StepAttributes attribCPbuffer[STEPS];
+	int phraseCPbuffer[SEQS];
+	SeqAttributes seqAttribCPbuffer;
+	bool seqCopied;
+	int countCP;// number of steps to paste (in case CPMODE_PARAM changes between copy and paste)
+	int startCP;
+	int phraseIndexRun;
+	unsigned long phraseIndexRunHistory;
+	unsigned long stepIndexRunHistory;
+
+	// No need to save, no reset
+	ProbabilityPreRoll probPreRoll;
+
+
+	static float randomCV() {
+		return ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
+	}
+
+	void initSequences(int seqLength) {
+		phrases = 4;
+		for (int i = 0; i < SEQS; i++) {
+			sequences[i].init(seqLength, MODE_FWD);
+			phrase[i] = 0;
+			for (int s = 0; s < STEPS; s++) {
+				cv[i][s] = 0.0f;
+				attributes[i][s].init();
+			}
+		}
+	}
+
+	void initCopyPaste() {
+		for (int i = 0; i < STEPS; i++) {
+			cvCPbuffer[i] = 0.0f;
+			attribCPbuffer[i].init();
+		}
+		for (int i = 0; i < SEQS; i++) {
+			phraseCPbuffer[i] = 0;
+		}
+		seqAttribCPbuffer.init(STEPS, MODE_FWD);
+		seqCopied = true;
+		countCP = STEPS;
+		startCP = 0;
+	}
+
+	void randomizeSequence(int seqn, int maxSteps) {
+		for (int s = 0; s < STEPS; s++) {
+			cv[seqn][s] = randomCV();
+			attributes[seqn][s].randomize();
+		}
+		sequences[seqn].randomize(maxSteps, MODES);
+	}
+
+
+	// Tied steps
+
+	void propagateCVtoTied(int seqn, int stepn) {
+		for (int i = stepn + 1; i < STEPS; i++) {
+			if (!attributes[seqn][i].getTied())
+				break;
+			cv[seqn][i] = cv[seqn][i - 1];
+		}
+	}
+
+	void activateTiedStep(int seqn, int stepn) {
+		attributes[seqn][stepn].setTied(true);
+		if (stepn > 0)
+			propagateCVtoTied(seqn, stepn - 1);
+
+		if (holdTiedNotes) {// new method
+			attributes[seqn][stepn].setGate1(true);
+			for (int i = std::max(stepn, 1); i < STEPS && attributes[seqn][i].getTied(); i++) {
+				attributes[seqn][i].setGate1Mode(attributes[seqn][i - 1].getGate1Mode());
+				attributes[seqn][i - 1].setGate1Mode(5);
+				attributes[seqn][i - 1].setGate1(true);
+			}
+		}
+		else {// old method
+			if (stepn > 0) {
+				attributes[seqn][stepn] = attributes[seqn][stepn - 1];
+				attributes[seqn][stepn].setTied(true);
+			}
+		}
+	}
+
+	void deactivateTiedStep(int seqn, int stepn) {
+		attributes[seqn][stepn].setTied(false);
+		if (holdTiedNotes) {// new method
+			int lastGateType = attributes[seqn][stepn].getGate1Mode();
+			for (int i = stepn + 1; i < STEPS && attributes[seqn][i].getTied(); i++)
+				lastGateType = attributes[seqn][i].getGate1Mode();
+			if (stepn > 0)
+				attributes[seqn][stepn - 1].setGate1Mode(lastGateType);
+		}
+		//else old method, nothing to do
+	}
+
+
+	// Editing
+
+	void rotateSeq(int seqNum, bool directionRight, int seqLength, int stepOffset = 0) {
+		// rotates steps stepOffset to stepOffset + seqLength - 1
+		float rotCV;
+		StepAttributes rotAttributes;
+		int iStart = stepOffset;
+		int iEnd = iStart + seqLength - 1;
+		int iRot = iStart;
+		int iDelta = 1;
+		if (directionRight) {
+			iRot = iEnd;
+			iDelta = -1;
+		}
+		rotCV = cv[seqNum][iRot];
+		rotAttributes = attributes[seqNum][iRot];
+		for ( ; ; iRot += iDelta) {
+			if (iDelta == 1 && iRot >= iEnd) break;
+			if (iDelta == -1 && iRot <= iStart) break;
+			cv[seqNum][iRot] = cv[seqNum][iRot + iDelta];
+			attributes[seqNum][iRot] = attributes[seqNum][iRot + iDelta];
+		}
+		cv[seqNum][iRot] = rotCV;
+		attributes[seqNum][iRot] = rotAttributes;
+	}
+
+	void copy(bool editingSequence, int seqIndexEdit, int startIndex, float cpMode) {
+		// cpMode is the value of CPMODE_PARAM (0.0f is 4, 1.0f is 8, 2.0f is all)
+		startCP = startIndex;
+		countCP = editingSequence ? STEPS : SEQS;
+		if (cpMode > 1.5f)// all
+			startCP = 0;
+		else if (cpMode < 0.5f)// 4
+			countCP = std::min(4, countCP - startCP);
+		else// 8
+			countCP = std::min(8, countCP - startCP);
+		if (editingSequence) {
+			for (int i = 0, s = startCP; i < countCP; i++, s++) {
+				cvCPbuffer[i] = cv[seqIndexEdit][s];
+				attribCPbuffer[i] = attributes[seqIndexEdit][s];
+			}
+			seqAttribCPbuffer.setSeqAttrib(sequences[seqIndexEdit].getSeqAttrib());
+			seqCopied = true;
+		}
+		else {
+			for (int i = 0, p = startCP; i < countCP; i++, p++)
+				phraseCPbuffer[i] = phrase[p];
+			seqCopied = false;// so that a cross paste can be detected
+		}
+	}
+
+	bool paste(bool editingSequence, int seqIndexEdit, int startIndex, float cpMode, int maxSeqLength) {
+		// returns true when a crossed paste (seq vs song) was done
+		// maxSeqLength is the longest length a pasted sequence can have in the current configuration
+		bool crossed = false;
+		int count = editingSequence ? STEPS : SEQS;
+		startCP = 0;
+		if (countCP <= 8) {
+			startCP = startIndex;
+			countCP = std::min(countCP, count - startCP);
+		}
+		// else nothing to do for ALL
+
+		if (editingSequence) {
+			if (seqCopied) {// non-crossed paste (seq vs song)
+				for (int i = 0, s = startCP; i < countCP; i++, s++) {
+					cv[seqIndexEdit][s] = cvCPbuffer[i];
+					attributes[seqIndexEdit][s] = attribCPbuffer[i];
+				}
+				if (cpMode > 1.5f) {// all
+					sequences[seqIndexEdit].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
+					if (sequences[seqIndexEdit].getLength() > maxSeqLength)
+						sequences[seqIndexEdit].setLength(maxSeqLength);
+				}
+			}
+			else {// crossed paste to seq (seq vs song)
+				if (cpMode > 1.5f) { // ALL (init steps)
+					for (int s = 0; s < STEPS; s++) {
+						//cv[seqIndexEdit][s] = 0.0f;
+						//attributes[seqIndexEdit][s].init();
+						attributes[seqIndexEdit][s].toggleGate1();
+					}
+					sequences[seqIndexEdit].setTranspose(0);
+					sequences[seqIndexEdit].setRotate(0);
+				}
+				else if (cpMode < 0.5f) {// 4 (randomize CVs)
+					for (int s = 0; s < STEPS; s++)
+						cv[seqIndexEdit][s] = randomCV();
+					sequences[seqIndexEdit].setTranspose(0);
+					sequences[seqIndexEdit].setRotate(0);
+				}
+				else {// 8 (randomize gate 1)
+					for (int s = 0; s < STEPS; s++)
+						if ( (random::u32() & 0x1) != 0)
+							attributes[seqIndexEdit][s].toggleGate1();
+				}
+				startCP = 0;
+				countCP = STEPS;
+				crossed = true;
+			}
+		}
+		else {
+			if (!seqCopied) {// non-crossed paste (seq vs song)
+				for (int i = 0, p = startCP; i < countCP; i++, p++)
+					phrase[p] = phraseCPbuffer[i];
+			}
+			else {// crossed paste to song (seq vs song)
+				if (cpMode > 1.5f) { // ALL (init phrases)
+					for (int p = 0; p < SEQS; p++)
+						phrase[p] = 0;
+				}
+				else if (cpMode < 0.5f) {// 4 (phrases increase from 1 to SEQS)
+					for (int p = 0; p < SEQS; p++)
+						phrase[p] = p;
+				}
+				else {// 8 (randomize phrases)
+					for (int p = 0; p < SEQS; p++)
+						phrase[p] = random::u32() % SEQS;
+				}
+				startCP = 0;
+				countCP = SEQS;
+				crossed = true;
+			}
+		}
+		return crossed;
+	}
+
+
+	// Running
+
+	int initRunIndexes(bool editingSequence, int seqIndexEdit, int* stepIndexRun) {
+		// returns the sequence that will be played
+		phraseIndexRun = (runModeSong == MODE_REV ? phrases - 1 : 0);
+		phraseIndexRunHistory = 0;
+
+		int seq = (editingSequence ? seqIndexEdit : phrase[phraseIndexRun]);
+		*stepIndexRun = (sequences[seq].getRunMode() == MODE_REV ? sequences[seq].getLength() - 1 : 0);
+		stepIndexRunHistory = 0;
+		probPreRoll.reset();
+		return seq;
+	}
+
+	int moveRunIndexes(bool editingSequence, int seqIndexEdit, int* stepIndexRun) {
+		// called on each step (i.e. when ppqnCount is 0); moves the step, and the phrase when in song mode,
+		//   and stops the run when the end of the song is reached with stopAtEndOfSong
+		// returns the sequence that will be played
+		if (editingSequence) {
+			moveIndexRunMode(stepIndexRun, sequences[seqIndexEdit].getLength(), sequences[seqIndexEdit].getRunMode(), &stepIndexRunHistory);
+			return seqIndexEdit;
+		}
+		int oldStepIndexRun = *stepIndexRun;
+		if (moveIndexRunMode(stepIndexRun, sequences[phrase[phraseIndexRun]].getLength(), sequences[phrase[phraseIndexRun]].getRunMode(), &stepIndexRunHistory)) {
+			int oldPhraseIndexRun = phraseIndexRun;
+			bool songLoopOver = moveIndexRunMode(&phraseIndexRun, phrases, runModeSong, &phraseIndexRunHistory);
+			// check for end of song if needed
+			if (songLoopOver && stopAtEndOfSong) {
+				running = false;
+				*stepIndexRun = oldStepIndexRun;
+				phraseIndexRun = oldPhraseIndexRun;
+			}
+			else {
+				*stepIndexRun = (sequences[phrase[phraseIndexRun]].getRunMode() == MODE_REV ? sequences[phrase[phraseIndexRun]].getLength() - 1 : 0);// must always refresh after phraseIndexRun has changed
+			}
+		}
+		return phrase[phraseIndexRun];
+	}
+
+	int preRollGate1(int seqn, int stepn, int ppqnCount, float randKnob) {
+		// pre-rolled probability outcome for calcGate1Code(), -1 when not pre-rolling; the knob is read when the pass is rolled
+		if (!preRollProb || ppqnCount != 0 || !attributes[seqn][stepn].getGate1P())
+			return -1;
+		return probPreRoll.play(seqn, stepn, STEPS, [this, seqn, randKnob](int s) {
+			return attributes[seqn][s].getGate1P() ? randKnob : 1.0f;
+		}) ? 1 : 0;
+	}
+
+
+	// Json (sequences are not included since their loading is module specific)
+
+	void engineToJson(json_t *rootJ) {
+		// phrase
+		json_t *phraseJ = json_array();
+		for (int i = 0; i < SEQS; i++)
+			json_array_insert_new(phraseJ, i, json_integer(phrase[i]));
+		json_object_set_new(rootJ, "phrase", phraseJ);
+
+		// CV
+		json_t *cvJ = json_array();
+		for (int i = 0; i < SEQS; i++)
+			for (int s = 0; s < STEPS; s++) {
+				json_array_insert_new(cvJ, s + (i * STEPS), json_real(cv[i][s]));
+			}
+		json_object_set_new(rootJ, "cv", cvJ);
+
+		// attributes
+		json_t *attributesJ = json_array();
+		for (int i = 0; i < SEQS; i++)
+			for (int s = 0; s < STEPS; s++) {
+				json_array_insert_new(attributesJ, s + (i * STEPS), json_integer(attributes[i][s].getAttribute()));
+			}
+		json_object_set_new(rootJ, "attributes", attributesJ);
+	}
+
+	bool engineFromJson(json_t *rootJ) {
+		// returns false when no attributes were found, so that the caller can do its legacy loading
+		// phrase
+		json_t *phraseJ = json_object_get(rootJ, "phrase");
+		if (phraseJ)
+			for (int i = 0; i < SEQS; i++)
+			{
+				json_t *phraseArrayJ = json_array_get(phraseJ, i);
+				if (phraseArrayJ)
+					phrase[i] = json_integer_value(phraseArrayJ);
+			}
+
+		// CV
+		json_t *cvJ = json_object_get(rootJ, "cv");
+		if (cvJ) {
+			for (int i = 0; i < SEQS; i++)
+				for (int s = 0; s < STEPS; s++) {
+					json_t *cvArrayJ = json_array_get(cvJ, s + (i * STEPS));
+					if (cvArrayJ)
+						cv[i][s] = json_number_value(cvArrayJ);
+				}
+		}
+
+		// attributes
+		json_t *attributesJ = json_object_get(rootJ, "attributes");
+		if (attributesJ) {
+			for (int i = 0; i < SEQS; i++)
+				for (int s = 0; s < STEPS; s++) {
+					json_t *attributesArrayJ = json_array_get(attributesJ, s + (i * STEPS));
+					if (attributesArrayJ)
+						attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
+				}
+		}
+		return attributesJ != NULL;
+	}
+};
+
+
+#endif
@@ -26,51 +26,52 @@ struct PhraseSeqExpander : Module {
 
 
 	// Expander
-	float leftMessages[2][1] = {};// messages from mother
+	ExpanderMessage<1> leftMessages[2] = {};// messages from mother
+	ExpanderMessageReader<1> readerFromMother;
+	ExpanderMessageWriter<NUM_INPUTS> writerToMother;
 
 
 	// No need to save
 	int panelTheme;
-	unsigned int expanderRefreshCounter = 0;	
+	ExpanderRefreshCounter expanderRefresh;	
 
 
 	PhraseSeqExpander() {
 		config(0, NUM_INPUTS, 0, 0);
 		
-		leftExpander.producerMessage = leftMessages[0];
-		leftExpander.consumerMessage = leftMessages[1];
+		leftExpander.producerMessage = &leftMessages[0];
+		leftExpander.consumerMessage = &leftMessages[1];
 		
 		panelTheme = (loadDarkAsDefault() ? 1 : 0);
 	}
 
 
 	void process(const ProcessArgs &args) override {		
-		expanderRefreshCounter++;
-		if (expanderRefreshCounter >= expanderRefreshStepSkips) {
-			expanderRefreshCounter = 0;
+		if (expanderRefresh.process()) {
 			
 			bool motherPresent = leftExpander.module && (leftExpander.module->model == modelPhraseSeq16 || leftExpander.module->model == modelPhraseSeq32);
 			if (motherPresent) {
 				// To Mother
-				float *messagesToMother = (float*)leftExpander.module->rightExpander.producerMessage;
+				float *messagesToMother = writerToMother.values;
 				int i = 0;
 				for (; i < NUM_INPUTS - 1; i++) {
 					messagesToMother[i] = inputs[i].getVoltage();
 				}
 				messagesToMother[i] = (inputs[i].isConnected() ? inputs[i].getVoltage() : std::numeric_limits<float>::quiet_NaN());
-				leftExpander.module->rightExpander.messageFlipRequested = true;
-					
-				// From Mother
-				float *messagesFromMother = (float*)leftExpander.consumerMessage;
-				panelTheme = clamp((int)(messagesFromMother[0] + 0.5f), 0, 1);
-			}		
-		}// expanderRefreshCounter			
+				expanderRefresh.update(writerToMother.send(leftExpander.module, leftExpander.module->rightExpander));
+			}
+			
+			// From Mother
+			ExpanderMessage<1> *messageFromMother = readerFromMother.read(leftExpander, motherPresent);
+			if (messageFromMother && readerFromMother.hasChanged(0))
+				panelTheme = clamp((int)(messageFromMother->values[0] + 0.5f), 0, 1);
+		}// expanderRefresh			
 	}// process()
 };
 
 
 struct PhraseSeqExpanderWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 	
 	PhraseSeqExpanderWidget(PhraseSeqExpander *module) {
 		setModule(module);
@@ -78,8 +79,10 @@ struct PhraseSeqExpanderWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/PhraseSeqExpander.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/PhraseSeqExpander_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/PhraseSeqExpander_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -98,14 +101,6 @@ struct PhraseSeqExpanderWidget : ModuleWidget {
 		addInput(createDynamicPort<IMPort>(Vec(colRulerExp, rowRulerExpTop + rowSpacingExp * 3), true, module, PhraseSeqExpander::SLIDECV_INPUT, module ? &module->panelTheme : NULL));
 		addInput(createDynamicPort<IMPort>(Vec(colRulerExp, rowRulerExpTop + rowSpacingExp * 4), true, module, PhraseSeqExpander::MODECV_INPUT, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((PhraseSeqExpander*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((PhraseSeqExpander*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelPhraseSeqExpander = createModel<PhraseSeqExpander, PhraseSeqExpanderWidget>("Phrase-Seq-Expander");
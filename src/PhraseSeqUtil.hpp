@@ -155,11 +155,62 @@ inline int gateModeToKeyLightIndex(StepAttributes attribute, bool isGate1) {// k
 }
 
 
+struct ProbabilityPreRoll {
+	// Probability outcomes of the steps of a sequence (up to 64), drawn in one batch from a per-module RNG when a pass 
+	//   starts, so that they can be shown before the steps play (bit s is step s, set when the step plays).
+	// A new pass starts as soon as a probabilistic step is about to play a second time (or the sequence changes), 
+	//   so every play of a step still has its own draw, as when drawing at each step.
+	uint64_t outcomes = 0;
+	uint64_t played = ~((uint64_t)0);// all set so that the first play rolls
+	int seqn = -1;
+	uint64_t rngState[2];
+	
+	ProbabilityPreRoll() {
+		rngState[0] = (((uint64_t)random::u32()) << 32) | random::u32();
+		rngState[1] = (((uint64_t)random::u32()) << 32) | random::u32() | 0x1;// state must not be all zeros
+	}
+	
+	void reset() {// next play rolls a new pass
+		played = ~((uint64_t)0);
+	}
+	
+	inline uint64_t nextRandom() {// xoroshiro128+
+		uint64_t s0 = rngState[0];
+		uint64_t s1 = rngState[1] ^ s0;
+		rngState[0] = ((s0 << 55) | (s0 >> 9)) ^ s1 ^ (s1 << 14);
+		rngState[1] = (s1 << 36) | (s1 >> 28);
+		return rngState[0] + rngState[1];
+	}
+	
+	template <typename ProbFunc>
+	bool play(int _seqn, int stepn, int numSteps, ProbFunc probOfStep) {
+		// returns the outcome of a probabilistic step, probOfStep(s) is the probability of step s ([0.0 : 1.0], 1.0 or more when not probabilistic)
+		uint64_t stepMask = ((uint64_t)0x1) << stepn;
+		if ((played & stepMask) != 0 || _seqn != seqn) {
+			seqn = _seqn;
+			played = 0;
+			outcomes = 0;
+			for (int s = 0; s < numSteps; s++) {
+				float prob = probOfStep(s);
+				if (prob >= 1.0f || (float)(nextRandom() >> 40) * (1.0f / 16777216.0f) < prob)// same [0.0, 1.0) resolution as random::uniform
+					outcomes |= ((uint64_t)0x1) << s;
+			}
+		}
+		played |= stepMask;
+		return (outcomes & stepMask) != 0;
+	}
+	
+	inline bool isUpcomingMiss(int _seqn, int stepn) {// the step will not play when next reached in this pass
+		return _seqn == seqn && (((~played & ~outcomes) >> stepn) & 0x1) != 0;
+	}
+};
+
+
 
 // Other methods (code in PhraseSeqUtil.cpp)	
 
 int getAdvGate(int ppqnCount, int pulsesPerStep, int gateMode);
-int calcGate1Code(StepAttributes attribute, int ppqnCount, int pulsesPerStep, float randKnob);
+int calcGate1Code(StepAttributes attribute, int ppqnCount, int pulsesPerStep, float randKnob, int preRolled = -1);// preRolled: -1 = draw now, else pre-rolled outcome
 int calcGate2Code(StepAttributes attribute, int ppqnCount, int pulsesPerStep);
 bool moveIndexRunMode(int* index, int numSteps, int runMode, unsigned long* history);
 int keyIndexToGateMode(int keyIndex, int pulsesPerStep);
@@ -0,0 +1,90 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//***********************************************************************************************
+
+
+#include "ProfileUtil.hpp"
+
+
+#ifdef IM_PROFILE
+
+static const char* profileSectionNames[NUM_PROF_SECTIONS] = {"Inputs", "Clock", "Outputs", "Lights", "Expander", "Synth"};
+
+
+std::string ModuleProfiler::toString(const std::string &moduleName, int64_t moduleId) {
+	uint64_t numSamples = samples.load(std::memory_order_relaxed);
+	uint64_t totalNanos = 0;
+	uint64_t sectionNanos[NUM_PROF_SECTIONS];
+	for (int s = 0; s < NUM_PROF_SECTIONS; s++) {
+		sectionNanos[s] = nanos[s].load(std::memory_order_relaxed);
+		totalNanos += sectionNanos[s];
+	}
+	
+	std::string str = string::f("%s (id %lld): %llu samples, %.3f us/sample\n", moduleName.c_str(), (long long)moduleId, (unsigned long long)numSamples, 
+		numSamples == 0 ? 0.0 : (double)totalNanos / 1000.0 / (double)numSamples);
+	for (int s = 0; s < NUM_PROF_SECTIONS; s++) {
+		uint64_t numCalls = calls[s].load(std::memory_order_relaxed);
+		str += string::f("  %s: %.3f us/call, %.3f us/sample, %.1f%%\n", profileSectionNames[s], 
+			numCalls == 0 ? 0.0 : (double)sectionNanos[s] / 1000.0 / (double)numCalls,
+			numSamples == 0 ? 0.0 : (double)sectionNanos[s] / 1000.0 / (double)numSamples,
+			totalNanos == 0 ? 0.0 : (double)sectionNanos[s] * 100.0 / (double)totalNanos);
+	}
+	return str;
+}
+
+
+struct ProfileResetItem : MenuItem {
+	ModuleProfiler *profiler;
+	void onAction(const event::Action &e) override {
+		profiler->resetRequested = true;
+	}
+};
+
+struct ProfileDumpItem : MenuItem {
+	ModuleProfiler *profiler;
+	std::string moduleName;
+	int64_t moduleId;
+	void onAction(const event::Action &e) override {
+		// appends, so that the profiles of several modules can be gathered in one file
+		std::string path = asset::user("ImpromptuModular_profile.txt");
+		FILE *file = std::fopen(path.c_str(), "a");
+		if (!file) {
+			WARN("Could not open profile file %s", path.c_str());
+			return;
+		}
+		std::string str = profiler->toString(moduleName, moduleId);
+		std::fputs(str.c_str(), file);
+		std::fclose(file);
+	}
+};
+
+
+Menu *ProfileMenuItem::createChildMenu() {
+	Menu *menu = new Menu;
+
+	std::string str = profiler->toString(moduleName, moduleId);
+	size_t pos = 0;
+	while (pos < str.size()) {
+		size_t end = str.find('\n', pos);
+		if (end == std::string::npos)
+			end = str.size();
+		MenuLabel *sectionLabel = new MenuLabel();
+		sectionLabel->text = str.substr(pos, end - pos);
+		menu->addChild(sectionLabel);
+		pos = end + 1;
+	}
+
+	ProfileResetItem *resetItem = createMenuItem<ProfileResetItem>("Reset counters", "");
+	resetItem->profiler = profiler;
+	menu->addChild(resetItem);
+
+	ProfileDumpItem *dumpItem = createMenuItem<ProfileDumpItem>("Append to ImpromptuModular_profile.txt", "");
+	dumpItem->profiler = profiler;
+	dumpItem->moduleName = moduleName;
+	dumpItem->moduleId = moduleId;
+	menu->addChild(dumpItem);
+
+	return menu;
+}
+
+#endif
@@ -0,0 +1,109 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//***********************************************************************************************
+
+#ifndef PROFILE_UTIL_HPP
+#define PROFILE_UTIL_HPP
+
+
+#include "ImpromptuModular.hpp"
+
+
+// Profiling of the sections of a module's process(), compiled in only when IM_PROFILE is defined (see Makefile).
+// A section runs from its PROFILE_BEGIN or PROFILE_NEXT to the next PROFILE_NEXT or to the end of the enclosing scope.
+
+enum ProfileSectionIds {PROF_INPUTS, PROF_CLOCK, PROF_OUTPUTS, PROF_LIGHTS, PROF_EXPANDER, PROF_SYNTH, NUM_PROF_SECTIONS};// PROF_SYNTH is the synth part of SemiModularSynth
+
+
+#ifdef IM_PROFILE
+
+#include <atomic>
+#include <chrono>
+
+struct ModuleProfiler {
+	// written by the audio thread only, read by the UI thread
+	std::atomic<uint64_t> nanos[NUM_PROF_SECTIONS];
+	std::atomic<uint64_t> calls[NUM_PROF_SECTIONS];
+	std::atomic<uint64_t> samples;
+	// written by the UI thread, the audio thread does the actual reset so that the counters keep a single writer
+	std::atomic<bool> resetRequested;
+	
+	ModuleProfiler() {
+		clear();
+		resetRequested = false;
+	}
+	
+	void clear() {
+		for (int s = 0; s < NUM_PROF_SECTIONS; s++) {
+			nanos[s].store(0, std::memory_order_relaxed);
+			calls[s].store(0, std::memory_order_relaxed);
+		}
+		samples.store(0, std::memory_order_relaxed);
+	}
+	
+	inline void beginSample() {
+		if (resetRequested.load(std::memory_order_relaxed)) {
+			clear();
+			resetRequested.store(false, std::memory_order_relaxed);
+		}
+		samples.store(samples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	
+	inline void add(int section, uint64_t ns) {// single writer, so no read-modify-write needed
+		nanos[section].store(nanos[section].load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+		calls[section].store(calls[section].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	
+	std::string toString(const std::string &moduleName, int64_t moduleId);// one line per section, for the menu and the dump file
+};
+
+
+struct ProfileScope {
+	ModuleProfiler *profiler;
+	int section;
+	std::chrono::steady_clock::time_point start;
+	
+	ProfileScope(ModuleProfiler *_profiler, int _section) {
+		profiler = _profiler;
+		profiler->beginSample();
+		section = _section;
+		start = std::chrono::steady_clock::now();
+	}
+	
+	~ProfileScope() {
+		stop();
+	}
+	
+	inline void stop() {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		profiler->add(section, std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+		start = now;
+	}
+	
+	inline void next(int _section) {
+		stop();
+		section = _section;
+	}
+};
+
+
+struct ProfileMenuItem : MenuItem {
+	ModuleProfiler *profiler;
+	std::string moduleName;
+	int64_t moduleId;
+	Menu *createChildMenu() override;
+};
+
+
+#define PROFILE_BEGIN(profiler, section) ProfileScope profileScope(&(profiler), section)
+#define PROFILE_NEXT(section) profileScope.next(section)
+
+#else
+
+#define PROFILE_BEGIN(profiler, section)
+#define PROFILE_NEXT(section)
+
+#endif
+
+
+#endif
@@ -14,11 +14,12 @@
 
 
 #include "FundamentalUtil.hpp"
-#include "PhraseSeqUtil.hpp"
+#include "PhraseSeqEngine.hpp"
 #include "comp/PianoKey.hpp"
+#include "ProfileUtil.hpp"
 
 
-struct SemiModularSynth : Module {
+struct SemiModularSynth : Module, PhraseSeqEngine<16, 16, NUM_MODES - 1> {
 	enum ParamIds {
 		// SEQUENCER
 		KEYNOTE_PARAM,// 0.6.12 replaces unused
@@ -183,35 +184,19 @@ struct SemiModularSynth : Module {
 	// Need to save, no reset
 	int panelTheme;
 	
-	// Need to save, with reset
+	// Need to save, with reset (song and sequence data are in PhraseSeqEngine)
 	bool autoseq;
 	bool autostepLen;
-	bool holdTiedNotes;
 	int seqCVmethod;// 0 is 0-10V, 1 is C4-D5#, 2 is TrigIncr
 	int pulsesPerStep;// 1 means normal gate mode, alt choices are 4, 6, 12, 24 PPS (Pulses per step)
-	bool running;
-	SeqAttributes sequences[16];
-	int runModeSong; 
 	int seqIndexEdit;
-	int phrase[16];// This is the song (series of phases; a phrase is a patten number)
-	int phrases;//1 to 16
-	float cv[16][16];// [-3.0 : 3.917]. First index is patten number, 2nd index is step
-	StepAttributes attributes[16][16];// First index is patten number, 2nd index is step (see enum AttributeBitMasks for details)
 	int stepIndexEdit;
 	int phraseIndexEdit;
 	bool resetOnRun;
 	bool attached;
-	bool stopAtEndOfSong;
 
 	// No need to save, with reset
 	int displayState;
-	float cvCPbuffer[16];// copy paste buffer for CVs
-	StepAttributes attribCPbuffer[16];
-	int phraseCPbuffer[16];
-	SeqAttributes seqAttribCPbuffer;
-	bool seqCopied;
-	int countCP;// number of steps to paste (in case CPMODE_PARAM changes between copy and paste)
-	int startCP;
 	unsigned long editingGate;// 0 when no edit gate, downward step counter timer when edit gate
 	unsigned long editingType;// similar to editingGate, but just for showing remanent gate type (nothing played); uses editingGateKeyLight
 	long infoCopyPaste;// 0 when no info, positive downward step counter timer when copy, negative upward when paste
@@ -223,10 +208,7 @@ struct SemiModularSynth : Module {
 	long lastGateEdit;
 	long editingPpqn;// 0 when no info, positive downward step counter timer when editing ppqn
 	long clockIgnoreOnReset;
-	int phraseIndexRun;
-	unsigned long phraseIndexRunHistory;
 	int stepIndexRun;
-	unsigned long stepIndexRunHistory;
 	int ppqnCount;
 	int gate1Code;
 	int gate2Code;
@@ -249,7 +231,17 @@ struct SemiModularSynth : Module {
 	LadderFilter filter;
 	
 	// No need to save, no reset
+	uint32_t scheduleConnectionMask = 0xFFFFFFFF;// connections the section schedule was last built for (see updateSectionSchedule())
+	bool vcoActive = true;
+	bool clkActive = true;
+	bool vcaActive = true;
+	bool adsrActive = true;
+	bool vcfActive = true;
+	bool lfoActive = true;
 	RefreshCounter refresh;
+#ifdef IM_PROFILE
+	ModuleProfiler profiler;
+#endif
 	float slideCVdelta;// no need to initialize, this goes with slideStepsRemain
 	float editingGateCV;// no need to initialize, this goes with editingGate (output this only when editingGate > 0)
 	int editingGateKeyLight;// no need to initialize, this goes with editingGate (use this only when editingGate > 0)
@@ -260,7 +252,7 @@ struct SemiModularSynth : Module {
 	Trigger rightTrigger;
 	Trigger runningTrigger;
 	Trigger clockTrigger;
-	Trigger octTriggers[7];
+	TriggerBank<7> octTriggers;
 	Trigger octmTrigger;
 	Trigger gate1Trigger;
 	Trigger gate1ProbTrigger;
@@ -275,7 +267,7 @@ struct SemiModularSynth : Module {
 	Trigger rotateTrigger;
 	Trigger transposeTrigger;
 	Trigger tiedTrigger;
-	Trigger stepTriggers[16];
+	TriggerBank<16> stepTriggers;
 	Trigger keyNoteTrigger;
 	Trigger keyGateTrigger;
 	Trigger seqCVTrigger;
@@ -364,6 +356,7 @@ struct SemiModularSynth : Module {
 		// CLK 
 		oscillatorClk.offset = true;
 		oscillatorClk.invert = false;
+		oscillatorClk.useSine = false;// only sqr() is used
 		
 		// LFO
 		oscillatorLfo.setPulseWidth(0.5f);
@@ -379,6 +372,7 @@ struct SemiModularSynth : Module {
 		autoseq = false;
 		autostepLen = false;
 		holdTiedNotes = true;
+		preRollProb = false;
 		seqCVmethod = 0;
 		pulsesPerStep = 1;
 		running = true;
@@ -386,22 +380,14 @@ struct SemiModularSynth : Module {
 		stepIndexEdit = 0;
 		seqIndexEdit = 0;
 		phraseIndexEdit = 0;
-		phrases = 4;
-		for (int i = 0; i < 16; i++) {
-			sequences[i].init(16, MODE_FWD);
-			phrase[i] = 0;
-			for (int s = 0; s < 16; s++) {
-				cv[i][s] = 0.0f;
-				attributes[i][s].init();
-			}
-		}
+		initSequences(16);
 		resetOnRun = false;
 		attached = false;
 		stopAtEndOfSong = false;
 		resetNonJson();
 		
 		// VCO
-		// none
+		oscillatorVco.wavetable = false;
 		
 		// CLK
 		clkValue = 0.0f;
@@ -411,15 +397,7 @@ struct SemiModularSynth : Module {
 	}
 	void resetNonJson() {
 		displayState = DISP_NORMAL;
-		for (int i = 0; i < 16; i++) {
-			cvCPbuffer[i] = 0.0f;
-			attribCPbuffer[i].init();
-			phraseCPbuffer[i] = 0;
-		}
-		seqAttribCPbuffer.init(16, MODE_FWD);
-		seqCopied = true;
-		countCP = 16;
-		startCP = 0;
+		initCopyPaste();
 		editingGate = 0ul;
 		editingType = 0ul;
 		infoCopyPaste = 0l;
@@ -434,28 +412,18 @@ struct SemiModularSynth : Module {
 	}
 	void initRun() {// run button activated or run edge in run input jack
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
-		phraseIndexRun = (runModeSong == MODE_REV ? phrases - 1 : 0);
-		phraseIndexRunHistory = 0;
-
-		int seq = (isEditingSequence() ? seqIndexEdit : phrase[phraseIndexRun]);
-		stepIndexRun = (sequences[seq].getRunMode() == MODE_REV ? sequences[seq].getLength() - 1 : 0);
-		stepIndexRunHistory = 0;
+		int seq = initRunIndexes(isEditingSequence(), seqIndexEdit, &stepIndexRun);
 
 		ppqnCount = 0;
-		gate1Code = calcGate1Code(attributes[seq][stepIndexRun], 0, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue());
+		gate1Code = calcGate1Code(attributes[seq][stepIndexRun], 0, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue(), preRollGate1(seq, stepIndexRun, 0, params[GATE1_KNOB_PARAM].getValue()));
 		gate2Code = calcGate2Code(attributes[seq][stepIndexRun], 0, pulsesPerStep);
 		slideStepsRemain = 0ul;
 	}
 
 	
 	void onRandomize() override {
-		if (isEditingSequence()) {
-			for (int s = 0; s < 16; s++) {
-				cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
-				attributes[seqIndexEdit][s].randomize();
-			}
-			sequences[seqIndexEdit].randomize(16, NUM_MODES - 1);
-		}
+		if (isEditingSequence())
+			randomizeSequence(seqIndexEdit, 16);
 	}
 	
 	
@@ -473,6 +441,9 @@ struct SemiModularSynth : Module {
 		
 		// holdTiedNotes
 		json_object_set_new(rootJ, "holdTiedNotes", json_boolean(holdTiedNotes));
+
+		// preRollProb
+		json_object_set_new(rootJ, "preRollProb", json_boolean(preRollProb));
 		
 		// seqCVmethod
 		json_object_set_new(rootJ, "seqCVmethod", json_integer(seqCVmethod));
@@ -504,27 +475,8 @@ struct SemiModularSynth : Module {
 			json_array_insert_new(sequencesJ, i, json_integer(sequences[i].getSeqAttrib()));
 		json_object_set_new(rootJ, "sequences", sequencesJ);
 		
-		// phrase 
-		json_t *phraseJ = json_array();
-		for (int i = 0; i < 16; i++)
-			json_array_insert_new(phraseJ, i, json_integer(phrase[i]));
-		json_object_set_new(rootJ, "phrase", phraseJ);
-
-		// CV
-		json_t *cvJ = json_array();
-		for (int i = 0; i < 16; i++)
-			for (int s = 0; s < 16; s++) {
-				json_array_insert_new(cvJ, s + (i * 16), json_real(cv[i][s]));
-			}
-		json_object_set_new(rootJ, "cv", cvJ);
-
-		// attributes
-		json_t *attributesJ = json_array();
-		for (int i = 0; i < 16; i++)
-			for (int s = 0; s < 16; s++) {
-				json_array_insert_new(attributesJ, s + (i * 16), json_integer(attributes[i][s].getAttribute()));
-			}
-		json_object_set_new(rootJ, "attributes", attributesJ);
+		// phrase, CV and attributes
+		engineToJson(rootJ);
 
 		// resetOnRun
 		json_object_set_new(rootJ, "resetOnRun", json_boolean(resetOnRun));
@@ -535,6 +487,9 @@ struct SemiModularSynth : Module {
 		// stopAtEndOfSong
 		json_object_set_new(rootJ, "stopAtEndOfSong", json_boolean(stopAtEndOfSong));
 
+		// vcoWavetable
+		json_object_set_new(rootJ, "vcoWavetable", json_boolean(oscillatorVco.wavetable));
+
 		return rootJ;
 	}
 
@@ -563,6 +518,11 @@ struct SemiModularSynth : Module {
 		else
 			holdTiedNotes = false;// legacy
 		
+		// preRollProb
+		json_t *preRollProbJ = json_object_get(rootJ, "preRollProb");
+		if (preRollProbJ)
+			preRollProb = json_is_true(preRollProbJ);
+		
 		// seqCVmethod
 		json_t *seqCVmethodJ = json_object_get(rootJ, "seqCVmethod");
 		if (seqCVmethodJ)
@@ -681,37 +641,8 @@ struct SemiModularSynth : Module {
 			}
 		}
 
-		// phrase
-		json_t *phraseJ = json_object_get(rootJ, "phrase");
-		if (phraseJ)
-			for (int i = 0; i < 16; i++)
-			{
-				json_t *phraseArrayJ = json_array_get(phraseJ, i);
-				if (phraseArrayJ)
-					phrase[i] = json_integer_value(phraseArrayJ);
-			}
-			
-		// CV
-		json_t *cvJ = json_object_get(rootJ, "cv");
-		if (cvJ) {
-			for (int i = 0; i < 16; i++)
-				for (int s = 0; s < 16; s++) {
-					json_t *cvArrayJ = json_array_get(cvJ, s + (i * 16));
-					if (cvArrayJ)
-						cv[i][s] = json_number_value(cvArrayJ);
-				}
-		}
-
-		// attributes
-		json_t *attributesJ = json_object_get(rootJ, "attributes");
-		if (attributesJ) {
-			for (int i = 0; i < 16; i++)
-				for (int s = 0; s < 16; s++) {
-					json_t *attributesArrayJ = json_array_get(attributesJ, s + (i * 16));
-					if (attributesArrayJ)
-						attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
-				}
-		}
+		// phrase, CV and attributes
+		engineFromJson(rootJ);
 	
 		// resetOnRun
 		json_t *resetOnRunJ = json_object_get(rootJ, "resetOnRun");
@@ -728,34 +659,15 @@ struct SemiModularSynth : Module {
 		if (stopAtEndOfSongJ)
 			stopAtEndOfSong = json_is_true(stopAtEndOfSongJ);
 		
+		// vcoWavetable
+		json_t *vcoWavetableJ = json_object_get(rootJ, "vcoWavetable");
+		if (vcoWavetableJ)
+			oscillatorVco.wavetable = json_is_true(vcoWavetableJ);
+		
 		resetNonJson();
 	}
 
 
-	void rotateSeq(int seqNum, bool directionRight, int seqLength) {
-		float rotCV;
-		StepAttributes rotAttributes;
-		int iStart = 0;
-		int iEnd = seqLength - 1;
-		int iRot = iStart;
-		int iDelta = 1;
-		if (directionRight) {
-			iRot = iEnd;
-			iDelta = -1;
-		}
-		rotCV = cv[seqNum][iRot];
-		rotAttributes = attributes[seqNum][iRot];
-		for ( ; ; iRot += iDelta) {
-			if (iDelta == 1 && iRot >= iEnd) break;
-			if (iDelta == -1 && iRot <= iStart) break;
-			cv[seqNum][iRot] = cv[seqNum][iRot + iDelta];
-			attributes[seqNum][iRot] = attributes[seqNum][iRot + iDelta];
-		}
-		cv[seqNum][iRot] = rotCV;
-		attributes[seqNum][iRot] = rotAttributes;
-	}
-	
-
 	void process(const ProcessArgs &args) override {
 		float sampleRate = args.sampleRate;
 	
@@ -769,6 +681,7 @@ struct SemiModularSynth : Module {
 		
 		
 		//********** Buttons, knobs, switches and inputs **********
+		PROFILE_BEGIN(profiler, PROF_INPUTS);
 		
 		// Edit mode
 		bool editingSequence = isEditingSequence();// true = editing sequence, false = editing song
@@ -816,27 +729,7 @@ struct SemiModularSynth : Module {
 			// Copy button
 			if (copyTrigger.process(params[COPY_PARAM].getValue())) {
 				if (!attached) {
-					startCP = editingSequence ? stepIndexEdit : phraseIndexEdit;
-					countCP = 16;
-					if (params[CPMODE_PARAM].getValue() > 1.5f)// all
-						startCP = 0;
-					else if (params[CPMODE_PARAM].getValue() < 0.5f)// 4
-						countCP = std::min(4, 16 - startCP);
-					else// 8
-						countCP = std::min(8, 16 - startCP);
-					if (editingSequence) {
-						for (int i = 0, s = startCP; i < countCP; i++, s++) {
-							cvCPbuffer[i] = cv[seqIndexEdit][s];
-							attribCPbuffer[i] = attributes[seqIndexEdit][s];
-						}
-						seqAttribCPbuffer.setSeqAttrib(sequences[seqIndexEdit].getSeqAttrib());
-						seqCopied = true;
-					}
-					else {
-						for (int i = 0, p = startCP; i < countCP; i++, p++)
-							phraseCPbuffer[i] = phrase[p];
-						seqCopied = false;// so that a cross paste can be detected
-					}
+					copy(editingSequence, seqIndexEdit, editingSequence ? stepIndexEdit : phraseIndexEdit, params[CPMODE_PARAM].getValue());
 					infoCopyPaste = (long) (revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					displayState = DISP_NORMAL;
 				}
@@ -847,72 +740,8 @@ struct SemiModularSynth : Module {
 			if (pasteTrigger.process(params[PASTE_PARAM].getValue())) {
 				if (!attached) {
 					infoCopyPaste = (long) (-1 * revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-					startCP = 0;
-					if (countCP <= 8) {
-						startCP = editingSequence ? stepIndexEdit : phraseIndexEdit;
-						countCP = std::min(countCP, 16 - startCP);
-					}
-					// else nothing to do for ALL
-
-					if (editingSequence) {
-						if (seqCopied) {// non-crossed paste (seq vs song)
-							for (int i = 0, s = startCP; i < countCP; i++, s++) {
-								cv[seqIndexEdit][s] = cvCPbuffer[i];
-								attributes[seqIndexEdit][s] = attribCPbuffer[i];
-							}
-							if (params[CPMODE_PARAM].getValue() > 1.5f) {// all
-								sequences[seqIndexEdit].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
-							}
-						}
-						else {// crossed paste to seq (seq vs song)
-							if (params[CPMODE_PARAM].getValue() > 1.5f) { // ALL (init steps)
-								for (int s = 0; s < 16; s++) {
-									//cv[seqIndexEdit][s] = 0.0f;
-									//attributes[seqIndexEdit][s].init();
-									attributes[seqIndexEdit][s].toggleGate1();
-								}
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
-							}
-							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (randomize CVs)
-								for (int s = 0; s < 16; s++)
-									cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
-							}
-							else {// 8 (randomize gate 1)
-								for (int s = 0; s < 16; s++)
-									if ( (random::u32() & 0x1) != 0)
-										attributes[seqIndexEdit][s].toggleGate1();
-							}
-							startCP = 0;
-							countCP = 16;
-							infoCopyPaste *= 2l;
-						}
-					}
-					else {
-						if (!seqCopied) {// non-crossed paste (seq vs song)
-							for (int i = 0, p = startCP; i < countCP; i++, p++)
-								phrase[p] = phraseCPbuffer[i];
-						}
-						else {// crossed paste to song (seq vs song)
-							if (params[CPMODE_PARAM].getValue() > 1.5f) { // ALL (init phrases)
-								for (int p = 0; p < 16; p++)
-									phrase[p] = 0;
-							}
-							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (phrases increase from 1 to 16)
-								for (int p = 0; p < 16; p++)
-									phrase[p] = p;						
-							}
-							else {// 8 (randomize phrases)
-								for (int p = 0; p < 16; p++)
-									phrase[p] = random::u32() % 16;
-							}
-							startCP = 0;
-							countCP = 16;
-							infoCopyPaste *= 2l;
-						}					
-					}
+					if (paste(editingSequence, seqIndexEdit, editingSequence ? stepIndexEdit : phraseIndexEdit, params[CPMODE_PARAM].getValue(), 16))
+						infoCopyPaste *= 2l;// crossed paste
 					displayState = DISP_NORMAL;
 				}
 				else
@@ -971,11 +800,8 @@ struct SemiModularSynth : Module {
 			}
 
 			// Step button presses
-			int stepPressed = -1;
-			for (int i = 0; i < 16; i++) {
-				if (stepTriggers[i].process(params[STEP_PHRASE_PARAMS + i].getValue()))
-					stepPressed = i;
-			}
+			uint64_t stepsPressed = stepTriggers.process(params, STEP_PHRASE_PARAMS);
+			int stepPressed = (stepsPressed != 0 ? 63 - __builtin_clzll(stepsPressed) : -1);// the last one when many are pressed
 			if (stepPressed != -1) {
 				if (displayState == DISP_LENGTH) {
 					if (editingSequence)
@@ -1054,7 +880,7 @@ struct SemiModularSynth : Module {
 					}
 					else if (displayState == DISP_MODE) {
 						if (editingSequence) {
-							sequences[seqIndexEdit].setRunMode(clamp(sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, (NUM_MODES - 1 - 1)));
+							sequences[seqIndexEdit].setRunMode(clamp(sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, (NUM_SEQ_MODES - 1)));
 						}
 						else {
 							runModeSong = clamp(runModeSong + deltaKnob, 0, 6 - 1);
@@ -1115,19 +941,19 @@ struct SemiModularSynth : Module {
 			}	
 			
 			// Octave buttons
-			for (int i = 0; i < 7; i++) {
-				if (octTriggers[i].process(params[OCTAVE_PARAM + i].getValue())) {
-					if (editingSequence) {
-						displayState = DISP_NORMAL;
-						if (attributes[seqIndexEdit][stepIndexEdit].getTied())
-							tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-						else {			
-							cv[seqIndexEdit][stepIndexEdit] = applyNewOct(cv[seqIndexEdit][stepIndexEdit], 6 - i);
-							propagateCVtoTied(seqIndexEdit, stepIndexEdit);
-							editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-							editingGateCV = cv[seqIndexEdit][stepIndexEdit];
-							editingGateKeyLight = -1;
-						}
+			uint64_t octsPressed = octTriggers.process(params, OCTAVE_PARAM);
+			for (; octsPressed != 0; octsPressed &= (octsPressed - 1)) {
+				int i = __builtin_ctzll(octsPressed);
+				if (editingSequence) {
+					displayState = DISP_NORMAL;
+					if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+						tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
+					else {			
+						cv[seqIndexEdit][stepIndexEdit] = applyNewOct(cv[seqIndexEdit][stepIndexEdit], 6 - i);
+						propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+						editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
+						editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+						editingGateKeyLight = -1;
 					}
 				}
 			}
@@ -1236,6 +1062,7 @@ struct SemiModularSynth : Module {
 
 		
 		//********** Clock and reset **********
+		PROFILE_NEXT(PROF_CLOCK);
 		
 		// Clock
 		float clockInput = inputs[CLOCK_INPUT].isConnected() ? inputs[CLOCK_INPUT].getVoltage() : clkValue;// Pre-patching
@@ -1247,29 +1074,8 @@ struct SemiModularSynth : Module {
 
 				int newSeq = seqIndexEdit;// good value when editingSequence, overwrite if not editingSequence
 				if (ppqnCount == 0) {
-					float slideFromCV = 0.0f;
-					if (editingSequence) {
-						slideFromCV = cv[seqIndexEdit][stepIndexRun];
-						moveIndexRunMode(&stepIndexRun, sequences[seqIndexEdit].getLength(), sequences[seqIndexEdit].getRunMode(), &stepIndexRunHistory);
-					}
-					else {
-						slideFromCV = cv[phrase[phraseIndexRun]][stepIndexRun];
-						int oldStepIndexRun = stepIndexRun;
-						if (moveIndexRunMode(&stepIndexRun, sequences[phrase[phraseIndexRun]].getLength(), sequences[phrase[phraseIndexRun]].getRunMode(), &stepIndexRunHistory)) {
-							int oldPhraseIndexRun = phraseIndexRun;
-							bool songLoopOver = moveIndexRunMode(&phraseIndexRun, phrases, runModeSong, &phraseIndexRunHistory);
-							// check for end of song if needed
-							if (songLoopOver && stopAtEndOfSong) {
-								running = false;
-								stepIndexRun = oldStepIndexRun;
-								phraseIndexRun = oldPhraseIndexRun;
-							}
-							else {
-								stepIndexRun = (sequences[phrase[phraseIndexRun]].getRunMode() == MODE_REV ? sequences[phrase[phraseIndexRun]].getLength() - 1 : 0);// must always refresh after phraseIndexRun has changed
-							}
-						}
-						newSeq = phrase[phraseIndexRun];
-					}
+					float slideFromCV = cv[editingSequence ? seqIndexEdit : phrase[phraseIndexRun]][stepIndexRun];
+					newSeq = moveRunIndexes(editingSequence, seqIndexEdit, &stepIndexRun);
 					
 					// Slide
 					if (attributes[newSeq][stepIndexRun].getSlide()) {
@@ -1287,7 +1093,7 @@ struct SemiModularSynth : Module {
 						newSeq = phrase[phraseIndexRun];
 				}
 				if (gate1Code != -1 || ppqnCount == 0)
-					gate1Code = calcGate1Code(attributes[newSeq][stepIndexRun], ppqnCount, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue());
+					gate1Code = calcGate1Code(attributes[newSeq][stepIndexRun], ppqnCount, pulsesPerStep, params[GATE1_KNOB_PARAM].getValue(), preRollGate1(newSeq, stepIndexRun, ppqnCount, params[GATE1_KNOB_PARAM].getValue()));
 				gate2Code = calcGate2Code(attributes[newSeq][stepIndexRun], ppqnCount, pulsesPerStep);
 				clockPeriod = 0ul;				
 			}
@@ -1305,6 +1111,7 @@ struct SemiModularSynth : Module {
 		
 		
 		//********** Outputs and lights **********
+		PROFILE_NEXT(PROF_OUTPUTS);
 				
 		// CV and gates outputs
 		int seq = editingSequence ? seqIndexEdit : phrase[phraseIndexRun];
@@ -1327,6 +1134,7 @@ struct SemiModularSynth : Module {
 			slideStepsRemain--;
 		
 		// lights
+		PROFILE_NEXT(PROF_LIGHTS);
 		if (refresh.processLights()) {
 			// Step/phrase lights
 			for (int i = 0; i < 16; i++) {
@@ -1551,98 +1359,110 @@ struct SemiModularSynth : Module {
 			clockIgnoreOnReset--;
 
 		
+		if (refresh.processInputs()) {
+			updateSectionSchedule();
+		}
+		
+		// CLK (always per sample since it clocks the sequencer through pre-patching)
+		if (clkActive) {
+			if (refresh.processInputs()) {
+				oscillatorClk.setPitch(params[CLK_FREQ_PARAM].getValue() + log2f(pulsesPerStep));
+				oscillatorClk.setPulseWidth(params[CLK_PW_PARAM].getValue());
+			}	
+			oscillatorClk.step(args.sampleTime);
+			oscillatorClk.setReset(inputs[RESET_INPUT].getVoltage() + params[RESET_PARAM].getValue() + params[RUN_PARAM].getValue() + inputs[RUNCV_INPUT].getVoltage());//inputs[RESET_INPUT].getVoltage());
+			clkValue = 5.0f * oscillatorClk.sqr();	
+			outputs[CLK_OUT_OUTPUT].setVoltage(clkValue);
+		}
+		
+		
 		// VCO
-		oscillatorVco.analog = params[VCO_MODE_PARAM].getValue() > 0.0f;
-		float pitchFine = 3.0f * dsp::quadraticBipolar(params[VCO_FINE_PARAM].getValue());
-		float pitchCv = 12.0f * (inputs[VCO_PITCH_INPUT].isConnected() ? inputs[VCO_PITCH_INPUT].getVoltage() : outputs[CV_OUTPUT].getVoltage());// Pre-patching
-		float pitchOctOffset = 12.0f * params[VCO_OCT_PARAM].getValue();
-		if (inputs[VCO_FM_INPUT].isConnected()) {
-			pitchCv += dsp::quadraticBipolar(params[VCO_FM_PARAM].getValue()) * 12.0f * inputs[VCO_FM_INPUT].getVoltage();
+		PROFILE_NEXT(PROF_SYNTH);
+		if (vcoActive) {
+			oscillatorVco.analog = params[VCO_MODE_PARAM].getValue() > 0.0f;
+			float pitchFine = 3.0f * dsp::quadraticBipolar(params[VCO_FINE_PARAM].getValue());
+			float pitchCv = 12.0f * (inputs[VCO_PITCH_INPUT].isConnected() ? inputs[VCO_PITCH_INPUT].getVoltage() : outputs[CV_OUTPUT].getVoltage());// Pre-patching
+			float pitchOctOffset = 12.0f * params[VCO_OCT_PARAM].getValue();
+			if (inputs[VCO_FM_INPUT].isConnected()) {
+				pitchCv += dsp::quadraticBipolar(params[VCO_FM_PARAM].getValue()) * 12.0f * inputs[VCO_FM_INPUT].getVoltage();
+			}
+			oscillatorVco.setPitch(params[VCO_FREQ_PARAM].getValue(), pitchFine + pitchCv + pitchOctOffset);
+			oscillatorVco.setPulseWidth(params[VCO_PW_PARAM].getValue() + params[VCO_PWM_PARAM].getValue() * inputs[VCO_PW_INPUT].getVoltage() / 10.0f);
+			oscillatorVco.syncEnabled = inputs[VCO_SYNC_INPUT].isConnected();
+			oscillatorVco.process(args.sampleTime, inputs[VCO_SYNC_INPUT].getVoltage());
+			if (outputs[VCO_SIN_OUTPUT].isConnected())
+				outputs[VCO_SIN_OUTPUT].setVoltage(5.0f * oscillatorVco.sin());
+			if (outputs[VCO_TRI_OUTPUT].isConnected())
+				outputs[VCO_TRI_OUTPUT].setVoltage(5.0f * oscillatorVco.tri());
+			if (outputs[VCO_SAW_OUTPUT].isConnected())
+				outputs[VCO_SAW_OUTPUT].setVoltage(5.0f * oscillatorVco.saw());
+			//if (outputs[VCO_SQR_OUTPUT].isConnected())
+				outputs[VCO_SQR_OUTPUT].setVoltage(5.0f * oscillatorVco.sqr());		
 		}
-		oscillatorVco.setPitch(params[VCO_FREQ_PARAM].getValue(), pitchFine + pitchCv + pitchOctOffset);
-		oscillatorVco.setPulseWidth(params[VCO_PW_PARAM].getValue() + params[VCO_PWM_PARAM].getValue() * inputs[VCO_PW_INPUT].getVoltage() / 10.0f);
-		oscillatorVco.syncEnabled = inputs[VCO_SYNC_INPUT].isConnected();
-		oscillatorVco.process(args.sampleTime, inputs[VCO_SYNC_INPUT].getVoltage());
-		if (outputs[VCO_SIN_OUTPUT].isConnected())
-			outputs[VCO_SIN_OUTPUT].setVoltage(5.0f * oscillatorVco.sin());
-		if (outputs[VCO_TRI_OUTPUT].isConnected())
-			outputs[VCO_TRI_OUTPUT].setVoltage(5.0f * oscillatorVco.tri());
-		if (outputs[VCO_SAW_OUTPUT].isConnected())
-			outputs[VCO_SAW_OUTPUT].setVoltage(5.0f * oscillatorVco.saw());
-		//if (outputs[VCO_SQR_OUTPUT].isConnected())
-			outputs[VCO_SQR_OUTPUT].setVoltage(5.0f * oscillatorVco.sqr());		
-			
-			
-		// CLK
-		if (refresh.processInputs()) {
-			oscillatorClk.setPitch(params[CLK_FREQ_PARAM].getValue() + log2f(pulsesPerStep));
-			oscillatorClk.setPulseWidth(params[CLK_PW_PARAM].getValue());
-		}	
-		oscillatorClk.step(args.sampleTime);
-		oscillatorClk.setReset(inputs[RESET_INPUT].getVoltage() + params[RESET_PARAM].getValue() + params[RUN_PARAM].getValue() + inputs[RUNCV_INPUT].getVoltage());//inputs[RESET_INPUT].getVoltage());
-		clkValue = 5.0f * oscillatorClk.sqr();	
-		outputs[CLK_OUT_OUTPUT].setVoltage(clkValue);
 		
 		
 		// VCA
-		float vcaIn = inputs[VCA_IN1_INPUT].isConnected() ? inputs[VCA_IN1_INPUT].getVoltage() : outputs[VCO_SQR_OUTPUT].getVoltage();// Pre-patching
-		float vcaLin = inputs[VCA_LIN1_INPUT].isConnected() ? inputs[VCA_LIN1_INPUT].getVoltage() : outputs[ADSR_ENVELOPE_OUTPUT].getVoltage();// Pre-patching
-		float v = vcaIn * params[VCA_LEVEL1_PARAM].getValue();
-		v *= clamp(vcaLin / 10.0f, 0.0f, 1.0f);
-		outputs[VCA_OUT1_OUTPUT].setVoltage(v);
+		if (vcaActive) {
+			float vcaIn = inputs[VCA_IN1_INPUT].isConnected() ? inputs[VCA_IN1_INPUT].getVoltage() : outputs[VCO_SQR_OUTPUT].getVoltage();// Pre-patching
+			float vcaLin = inputs[VCA_LIN1_INPUT].isConnected() ? inputs[VCA_LIN1_INPUT].getVoltage() : outputs[ADSR_ENVELOPE_OUTPUT].getVoltage();// Pre-patching
+			float v = vcaIn * params[VCA_LEVEL1_PARAM].getValue();
+			v *= clamp(vcaLin / 10.0f, 0.0f, 1.0f);
+			outputs[VCA_OUT1_OUTPUT].setVoltage(v);
+		}
 
-				
+		
 		// ADSR
-		float attack = clamp(params[ADSR_ATTACK_PARAM].getValue(), 0.0f, 1.0f);
-		float decay = clamp(params[ADSR_DECAY_PARAM].getValue(), 0.0f, 1.0f);
-		float sustain = clamp(params[ADSR_SUSTAIN_PARAM].getValue(), 0.0f, 1.0f);
-		float release = clamp(params[ADSR_RELEASE_PARAM].getValue(), 0.0f, 1.0f);
-		// Gate
-		float adsrIn = inputs[ADSR_GATE_INPUT].isConnected() ? inputs[ADSR_GATE_INPUT].getVoltage() : outputs[GATE1_OUTPUT].getVoltage();// Pre-patching
-		bool gated = adsrIn >= 1.0f;
-		const float base = 20000.0f;
-		const float maxTime = 10.0f;
-		if (gated) {
-			if (decaying) {
-				// Decay
-				if (decay < 1e-4) {
-					env = sustain;
+		if (adsrActive) {
+			float attack = clamp(params[ADSR_ATTACK_PARAM].getValue(), 0.0f, 1.0f);
+			float decay = clamp(params[ADSR_DECAY_PARAM].getValue(), 0.0f, 1.0f);
+			float sustain = clamp(params[ADSR_SUSTAIN_PARAM].getValue(), 0.0f, 1.0f);
+			float release = clamp(params[ADSR_RELEASE_PARAM].getValue(), 0.0f, 1.0f);
+			// Gate
+			float adsrIn = inputs[ADSR_GATE_INPUT].isConnected() ? inputs[ADSR_GATE_INPUT].getVoltage() : outputs[GATE1_OUTPUT].getVoltage();// Pre-patching
+			bool gated = adsrIn >= 1.0f;
+			const float base = 20000.0f;
+			const float maxTime = 10.0f;
+			if (gated) {
+				if (decaying) {
+					// Decay
+					if (decay < 1e-4) {
+						env = sustain;
+					}
+					else {
+						env += std::pow(base, 1 - decay) / maxTime * (sustain - env) * args.sampleTime;
+					}
 				}
 				else {
-					env += std::pow(base, 1 - decay) / maxTime * (sustain - env) * args.sampleTime;
+					// Attack
+					// Skip ahead if attack is all the way down (infinitely fast)
+					if (attack < 1e-4) {
+						env = 1.0f;
+					}
+					else {
+						env += std::pow(base, 1 - attack) / maxTime * (1.01f - env) * args.sampleTime;
+					}
+					if (env >= 1.0f) {
+						env = 1.0f;
+						decaying = true;
+					}
 				}
 			}
 			else {
-				// Attack
-				// Skip ahead if attack is all the way down (infinitely fast)
-				if (attack < 1e-4) {
-					env = 1.0f;
+				// Release
+				if (release < 1e-4) {
+					env = 0.0f;
 				}
 				else {
-					env += std::pow(base, 1 - attack) / maxTime * (1.01f - env) * args.sampleTime;
-				}
-				if (env >= 1.0f) {
-					env = 1.0f;
-					decaying = true;
+					env += std::pow(base, 1 - release) / maxTime * (0.0f - env) * args.sampleTime;
 				}
+				decaying = false;
 			}
+			outputs[ADSR_ENVELOPE_OUTPUT].setVoltage(10.0f * env);
 		}
-		else {
-			// Release
-			if (release < 1e-4) {
-				env = 0.0f;
-			}
-			else {
-				env += std::pow(base, 1 - release) / maxTime * (0.0f - env) * args.sampleTime;
-			}
-			decaying = false;
-		}
-		outputs[ADSR_ENVELOPE_OUTPUT].setVoltage(10.0f * env);
 		
 		
 		// VCF
-		if (outputs[VCF_LPF_OUTPUT].isConnected() || outputs[VCF_HPF_OUTPUT].isConnected()) {
-		
+		if (vcfActive) {
 			float input = (inputs[VCF_IN_INPUT].isConnected() ? inputs[VCF_IN_INPUT].getVoltage() : outputs[VCA_OUT1_OUTPUT].getVoltage()) / 5.0f;// Pre-patching
 			float drive = clamp(params[VCF_DRIVE_PARAM].getValue() + inputs[VCF_DRIVE_INPUT].getVoltage() / 10.0f, 0.f, 1.f);
 			float gain = std::pow(1.f + drive, 5);
@@ -1658,20 +1478,16 @@ struct SemiModularSynth : Module {
 				pitch += inputs[VCF_FREQ_INPUT].getVoltage() * dsp::quadraticBipolar(params[VCF_FREQ_CV_PARAM].getValue());
 			pitch += params[VCF_FREQ_PARAM].getValue() * 10.f - 5.f;
 			//pitch += dsp::quadraticBipolar(params[FINE_PARAM].getValue() * 2.f - 1.f) * 7.f / 12.f;
-			float cutoff = 261.626f * std::pow(2.f, pitch);
+			float cutoff = voltToFreq(pitch, 261.626f);
 			cutoff = clamp(cutoff, 1.f, 8000.f);
 			filter.setCutoff(cutoff);
 			filter.process(input, args.sampleTime);
 			outputs[VCF_LPF_OUTPUT].setVoltage(5.f * filter.lowpass);
 			outputs[VCF_HPF_OUTPUT].setVoltage(5.f * filter.highpass);	
 		}			
-		else {
-			outputs[VCF_LPF_OUTPUT].setVoltage(0.0f);
-			outputs[VCF_HPF_OUTPUT].setVoltage(0.0f);
-		}
 		
 		// LFO
-		if (outputs[LFO_SIN_OUTPUT].isConnected() || outputs[LFO_TRI_OUTPUT].isConnected()) {
+		if (lfoActive) {
 			if (refresh.processInputs()) {
 				oscillatorLfo.setPitch(params[LFO_FREQ_PARAM].getValue());
 			}
@@ -1682,60 +1498,71 @@ struct SemiModularSynth : Module {
 			outputs[LFO_SIN_OUTPUT].setVoltage(5.0f * (lfoOffset + lfoGain * oscillatorLfo.sin()));
 			outputs[LFO_TRI_OUTPUT].setVoltage(5.0f * (lfoOffset + lfoGain * oscillatorLfo.tri()));	
 		} 
-		else {
-			outputs[LFO_SIN_OUTPUT].setVoltage(0.0f);
-			outputs[LFO_TRI_OUTPUT].setVoltage(0.0f);
-		}			
 		
 	}// process()
 	
-
-	inline void setGreenRed(int id, float green, float red) {
-		lights[id + 0].setBrightness(green);
-		lights[id + 1].setBrightness(red);
-	}
 	
-	inline void propagateCVtoTied(int seqn, int stepn) {
-		for (int i = stepn + 1; i < 16; i++) {
-			if (!attributes[seqn][i].getTied())
-				break;
-			cv[seqn][i] = cv[seqn][i - 1];
-		}	
-	}
-
-	void activateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(true);
-		if (stepn > 0) 
-			propagateCVtoTied(seqn, stepn - 1);
-		
-		if (holdTiedNotes) {// new method
-			attributes[seqn][stepn].setGate1(true);
-			for (int i = std::max(stepn, 1); i < 16 && attributes[seqn][i].getTied(); i++) {
-				attributes[seqn][i].setGate1Mode(attributes[seqn][i - 1].getGate1Mode());
-				attributes[seqn][i - 1].setGate1Mode(5);
-				attributes[seqn][i - 1].setGate1(true);
-			}
+	void updateSectionSchedule() {
+		// dependency graph of the pre-patched routing: a section is active when one of its outputs is connected, 
+		//   or when it feeds an active section through a pre-patched input that has no cable
+		uint32_t mask = 0;
+		int bit = 0;
+		static const int scheduleInputs[4] = {CLOCK_INPUT, VCA_IN1_INPUT, VCA_LIN1_INPUT, VCF_IN_INPUT};
+		for (int i = 0; i < 4; i++, bit++) {
+			if (inputs[scheduleInputs[i]].isConnected())
+				mask |= (1 << bit);
+		}
+		for (int i = VCO_SIN_OUTPUT; i <= LFO_TRI_OUTPUT; i++, bit++) {
+			if (outputs[i].isConnected())
+				mask |= (1 << bit);
 		}
-		else {// old method
-			if (stepn > 0) {
-				attributes[seqn][stepn] = attributes[seqn][stepn - 1];
-				attributes[seqn][stepn].setTied(true);
+		if (mask == scheduleConnectionMask)
+			return;
+		scheduleConnectionMask = mask;
+		
+		bool vcfNew = outputs[VCF_LPF_OUTPUT].isConnected() || outputs[VCF_HPF_OUTPUT].isConnected();
+		bool vcaNew = outputs[VCA_OUT1_OUTPUT].isConnected() || (vcfNew && !inputs[VCF_IN_INPUT].isConnected());
+		bool adsrNew = outputs[ADSR_ENVELOPE_OUTPUT].isConnected() || (vcaNew && !inputs[VCA_LIN1_INPUT].isConnected());
+		bool vcoNew = outputs[VCO_SIN_OUTPUT].isConnected() || outputs[VCO_TRI_OUTPUT].isConnected() || 
+					  outputs[VCO_SAW_OUTPUT].isConnected() || outputs[VCO_SQR_OUTPUT].isConnected() ||
+					  (vcaNew && !inputs[VCA_IN1_INPUT].isConnected());
+		bool lfoNew = outputs[LFO_SIN_OUTPUT].isConnected() || outputs[LFO_TRI_OUTPUT].isConnected();
+		clkActive = outputs[CLK_OUT_OUTPUT].isConnected() || !inputs[CLOCK_INPUT].isConnected();// sequencer is always running
+		
+		// outputs of sections that become idle are cleared once here, so that idle sections cost nothing in process()
+		if (vcoActive && !vcoNew) {
+			for (int i = VCO_SIN_OUTPUT; i <= VCO_SQR_OUTPUT; i++) {
+				outputs[i].setVoltage(0.0f);
 			}
 		}
+		if (adsrActive && !adsrNew) {
+			outputs[ADSR_ENVELOPE_OUTPUT].setVoltage(0.0f);
+		}
+		if (vcaActive && !vcaNew) {
+			outputs[VCA_OUT1_OUTPUT].setVoltage(0.0f);
+		}
+		if (vcfActive && !vcfNew) {
+			outputs[VCF_LPF_OUTPUT].setVoltage(0.0f);
+			outputs[VCF_HPF_OUTPUT].setVoltage(0.0f);
+		}
+		if (lfoActive && !lfoNew) {
+			outputs[LFO_SIN_OUTPUT].setVoltage(0.0f);
+			outputs[LFO_TRI_OUTPUT].setVoltage(0.0f);
+		}
+		vcoActive = vcoNew;
+		adsrActive = adsrNew;
+		vcaActive = vcaNew;
+		vcfActive = vcfNew;
+		lfoActive = lfoNew;
 	}
 	
-	void deactivateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(false);
-		if (holdTiedNotes) {// new method
-			int lastGateType = attributes[seqn][stepn].getGate1Mode();
-			for (int i = stepn + 1; i < 16 && attributes[seqn][i].getTied(); i++)
-				lastGateType = attributes[seqn][i].getGate1Mode();
-			if (stepn > 0)
-				attributes[seqn][stepn - 1].setGate1Mode(lastGateType);
-		}
-		//else old method, nothing to do
+	
+	inline void setGreenRed(int id, float green, float red) {
+		lights[id + 0].setBrightness(green);
+		lights[id + 1].setBrightness(red);
 	}
 	
+	
 	inline void setGateLight(bool gateOn, int lightIndex) {
 		if (!gateOn) {
 			lights[lightIndex + 0].setBrightness(0.0f);
@@ -1756,9 +1583,9 @@ struct SemiModularSynth : Module {
 
 
 struct SemiModularSynthWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 
-	struct SequenceDisplayWidget : TransparentWidget {
+	struct SequenceDisplayWidget : CachedDisplayWidget {
 		SemiModularSynth *module;
 		std::shared_ptr<Font> font;
 		char displayStr[4];
@@ -1768,19 +1595,11 @@ struct SemiModularSynthWidget : ModuleWidget {
 		}
 		
 		void runModeToStr(int num) {
-			if (num >= 0 && num < (NUM_MODES - 1))
+			if (num >= 0 && num < SemiModularSynth::NUM_SEQ_MODES)
 				snprintf(displayStr, 4, "%s", modeLabels[num].c_str());
 		}
 
-		void draw(const DrawArgs &args) override {
-			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
-			nvgFontFaceId(args.vg, font->handle);
-
-			Vec textPos = Vec(6, 24);
-			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
-			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
-			nvgFillColor(args.vg, textColor);
-			
+		void printState(DisplayState &state) override {
 			if (module == NULL) {
 				snprintf(displayStr, 4, "  1");
 			}
@@ -1841,6 +1660,17 @@ struct SemiModularSynthWidget : ModuleWidget {
 						module->seqIndexEdit : module->phrase[module->phraseIndexEdit]) + 1 );
 				}
 			}
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
+			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
+			nvgFontFaceId(args.vg, font->handle);
+
+			Vec textPos = Vec(6, 24);
+			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
+			nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
+			nvgFillColor(args.vg, textColor);
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};		
@@ -1875,12 +1705,24 @@ struct SemiModularSynthWidget : ModuleWidget {
 			module->holdTiedNotes = !module->holdTiedNotes;
 		}
 	};
+	struct PreRollProbItem : MenuItem {
+		SemiModularSynth *module;
+		void onAction(const event::Action &e) override {
+			module->preRollProb = !module->preRollProb;
+		}
+	};
 	struct StopAtEndOfSongItem : MenuItem {
 		SemiModularSynth *module;
 		void onAction(const event::Action &e) override {
 			module->stopAtEndOfSong = !module->stopAtEndOfSong;
 		}
 	};
+	struct VcoWavetableItem : MenuItem {
+		SemiModularSynth *module;
+		void onAction(const event::Action &e) override {
+			module->oscillatorVco.wavetable = !module->oscillatorVco.wavetable;
+		}
+	};
 	struct SeqCVmethodItem : MenuItem {
 		struct SeqCVmethodSubItem : MenuItem {
 			SemiModularSynth *module;
@@ -1941,6 +1783,10 @@ struct SemiModularSynthWidget : ModuleWidget {
 		holdItem->module = module;
 		menu->addChild(holdItem);
 
+		PreRollProbItem *preRollItem = createMenuItem<PreRollProbItem>("Pre-roll gate 1 probabilities", CHECKMARK(module->preRollProb));
+		preRollItem->module = module;
+		menu->addChild(preRollItem);
+
 		StopAtEndOfSongItem *loopItem = createMenuItem<StopAtEndOfSongItem>("Stop at end of song", CHECKMARK(module->stopAtEndOfSong));
 		loopItem->module = module;
 		menu->addChild(loopItem);
@@ -1956,6 +1802,20 @@ struct SemiModularSynthWidget : ModuleWidget {
 		AutoseqItem *aseqItem = createMenuItem<AutoseqItem>("AutoSeq when writing via CV inputs", CHECKMARK(module->autoseq));
 		aseqItem->module = module;
 		menu->addChild(aseqItem);
+
+		VcoWavetableItem *vcowtItem = createMenuItem<VcoWavetableItem>("VCO wavetable mode (no oversampling)", CHECKMARK(module->oscillatorVco.wavetable));
+		vcowtItem->module = module;
+		menu->addChild(vcowtItem);
+
+#ifdef IM_PROFILE
+		menu->addChild(new MenuLabel());// empty line
+
+		ProfileMenuItem *profItem = createMenuItem<ProfileMenuItem>("Performance", RIGHT_ARROW);
+		profItem->profiler = &module->profiler;
+		profItem->moduleName = "SemiModularSynth";
+		profItem->moduleId = module->id;
+		menu->addChild(profItem);
+#endif
 	}	
 	
 	struct SequenceKnob : IMBigKnobInf {
@@ -2012,8 +1872,10 @@ struct SemiModularSynthWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/SemiModular.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/SemiModular_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/SemiModular_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -2311,14 +2173,6 @@ struct SemiModularSynthWidget : ModuleWidget {
 		addOutput(createDynamicPort<IMPort>(Vec(colRulerLfo, rowRulerVCO4), false, module, SemiModularSynth::LFO_SIN_OUTPUT, module ? &module->panelTheme : NULL));
 		addInput(createDynamicPort<IMPort>(Vec(colRulerLfo, rowRulerVCO5), true, module, SemiModularSynth::LFO_RESET_INPUT, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((SemiModularSynth*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((SemiModularSynth*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelSemiModularSynth = createModel<SemiModularSynth, SemiModularSynthWidget>("Semi-ModularSynth");
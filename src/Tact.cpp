@@ -322,7 +322,7 @@ struct Tact : Module {
 
 
 struct TactWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 
 	struct PanelThemeItem : MenuItem {
 		Tact *module;
@@ -401,8 +401,10 @@ struct TactWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/Tact.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/Tact_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/Tact_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -509,14 +511,6 @@ struct TactWidget : ModuleWidget {
 		addChild(createLight<SmallLight<GreenLight>>(Vec(colRulerCenter - 47 - 1 + offsetMediumLight, rowRuler2 - 24 + offsetMediumLight), module, Tact::CVIN_LIGHTS + 0 * 2));		
 		addChild(createLight<SmallLight<GreenLight>>(Vec(colRulerCenter + 47 + 1 + offsetMediumLight, rowRuler2 - 24 + offsetMediumLight), module, Tact::CVIN_LIGHTS + 1 * 2));		
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((Tact*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((Tact*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 
@@ -678,7 +672,7 @@ struct Tact1 : Module {
 };
 
 struct Tact1Widget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 
 	struct PanelThemeItem : MenuItem {
 		Tact1 *module;
@@ -729,8 +723,10 @@ struct Tact1Widget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/Tact1.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/Tact1_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/Tact1_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -770,14 +766,6 @@ struct Tact1Widget : ModuleWidget {
 		// Exp switch
 		addParam(createParam<CKSS>(Vec(57 + hOffsetCKSS, rowRuler3 + vOffsetCKSS), module, Tact1::EXP_PARAM));		
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((Tact1*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((Tact1*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 
@@ -326,17 +326,24 @@ struct TwelveKey : Module {
 
 
 struct TwelveKeyWidget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 
-	struct OctaveNumDisplayWidget : TransparentWidget {
+	struct OctaveNumDisplayWidget : CachedDisplayWidget {
 		int *octaveNum;
 		std::shared_ptr<Font> font;
+		char displayStr[2];
 		
 		OctaveNumDisplayWidget() {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			displayStr[0] = 0x30 + (char) (octaveNum != NULL ? *octaveNum : 4);
+			displayStr[1] = 0;
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			//nvgTextLetterSpacing(args.vg, 2.5);
@@ -345,9 +352,6 @@ struct TwelveKeyWidget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~", NULL);
 			nvgFillColor(args.vg, textColor);
-			char displayStr[2];
-			displayStr[0] = 0x30 + (char) (octaveNum != NULL ? *octaveNum : 4);
-			displayStr[1] = 0;
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};
@@ -411,8 +415,10 @@ struct TwelveKeyWidget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/TwelveKey.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/TwelveKey_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/TwelveKey_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -510,14 +516,6 @@ struct TwelveKeyWidget : ModuleWidget {
 		addOutput(createDynamicPortCentered<IMPort>(Vec(columnRulerR1, rowRuler2), false, module, TwelveKey::GATE_OUTPUT, module ? &module->panelTheme : NULL));
 		addOutput(createDynamicPortCentered<IMPort>(Vec(columnRulerR2, rowRuler2), false, module, TwelveKey::VEL_OUTPUT, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((TwelveKey*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((TwelveKey*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelTwelveKey = createModel<TwelveKey, TwelveKeyWidget>("Twelve-Key");
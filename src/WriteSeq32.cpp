@@ -509,13 +509,14 @@ struct WriteSeq32 : Module {
 
 
 struct WriteSeq32Widget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 	int notesPos[8]; // used for rendering notes in LCD_24, 8 gate and 8 step LEDs 
 
-	struct NotesDisplayWidget : TransparentWidget {
+	struct NotesDisplayWidget : CachedDisplayWidget {
 		WriteSeq32 *module;
 		std::shared_ptr<Font> font;
-		char text[4];
+		char texts[8][4];
+		NoteLabelCache noteLabels[8];
 		int* notesPosLocal;
 
 		NotesDisplayWidget() {
@@ -523,6 +524,7 @@ struct WriteSeq32Widget : ModuleWidget {
 		}
 		
 		void cvToStr(int index8) {
+			char* text = texts[index8];
 			if (module == NULL) {
 				snprintf(text, 4, "C4 ");
 			}
@@ -550,12 +552,20 @@ struct WriteSeq32Widget : ModuleWidget {
 				}
 				else {
 					float cvVal = module->cv[module->indexChannel][index8|(index&0x18)];
-					printNote(cvVal, text, module->params[WriteSeq32::SHARP_PARAM].getValue() > 0.5f);
+					noteLabels[index8].print(cvVal, text, module->params[WriteSeq32::SHARP_PARAM].getValue() > 0.5f);
 				}
 			}
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			for (int i = 0; i < 8; i++) {
+				cvToStr(i);
+				state += texts[i];
+				state += '|';
+			}
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			nvgTextLetterSpacing(args.vg, -1.5);
@@ -565,22 +575,28 @@ struct WriteSeq32Widget : ModuleWidget {
 				nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 				nvgText(args.vg, textPos.x, textPos.y, "~~~", NULL);
 				nvgFillColor(args.vg, textColor);
-				cvToStr(i);
-				nvgText(args.vg, textPos.x, textPos.y, text, NULL);
+				nvgText(args.vg, textPos.x, textPos.y, texts[i], NULL);
 			}
 		}
 	};
 
 
-	struct StepsDisplayWidget : TransparentWidget {
+	struct StepsDisplayWidget : CachedDisplayWidget {
 		WriteSeq32 *module;
 		std::shared_ptr<Font> font;
+		char displayStr[3];
 		
 		StepsDisplayWidget() {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			float valueKnob = (module ? module->params[WriteSeq32::STEPS_PARAM].getValue() : 32.0f);
+			snprintf(displayStr, 3, "%2u", (unsigned) clamp(std::round(valueKnob), 1.0f, 32.0f) );
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			//nvgTextLetterSpacing(args.vg, 2.5);
@@ -589,9 +605,6 @@ struct WriteSeq32Widget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~~", NULL);
 			nvgFillColor(args.vg, textColor);
-			char displayStr[3];
-			float valueKnob = (module ? module->params[WriteSeq32::STEPS_PARAM].getValue() : 32.0f);
-			snprintf(displayStr, 3, "%2u", (unsigned) clamp(std::round(valueKnob), 1.0f, 32.0f) );
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};
@@ -644,8 +657,10 @@ struct WriteSeq32Widget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/WriteSeq32.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/WriteSeq32_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/WriteSeq32_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -800,14 +815,6 @@ struct WriteSeq32Widget : ModuleWidget {
 		// Clock
 		addInput(createDynamicPort<IMPort>(Vec(columnRuler5, rowRuler3), true, module, WriteSeq32::CLOCK_INPUT, module ? &module->panelTheme : NULL));			
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((WriteSeq32*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((WriteSeq32*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelWriteSeq32 = createModel<WriteSeq32, WriteSeq32Widget>("Write-Seq-32");
@@ -512,12 +512,13 @@ struct WriteSeq64 : Module {
 
 
 struct WriteSeq64Widget : ModuleWidget {
-	SvgPanel* darkPanel;
+	DynamicSVGPanel* darkPanel;
 
-	struct NoteDisplayWidget : TransparentWidget {
+	struct NoteDisplayWidget : CachedDisplayWidget {
 		WriteSeq64 *module;
 		std::shared_ptr<Font> font;
 		char text[7];
+		NoteLabelCache noteLabel;
 
 		NoteDisplayWidget() {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
@@ -541,7 +542,7 @@ struct WriteSeq64Widget : ModuleWidget {
 				else {			
 					if (module->params[WriteSeq64::SHARP_PARAM].getValue() > 0.5f) {// show notes
 						text[0] = ' ';
-						printNote(cvVal, &text[1], module->params[WriteSeq64::SHARP_PARAM].getValue() < 1.5f);
+						noteLabel.print(cvVal, &text[1], module->params[WriteSeq64::SHARP_PARAM].getValue() < 1.5f);
 					}
 					else  {// show volts
 						float cvValPrint = std::fabs(cvVal);
@@ -554,7 +555,12 @@ struct WriteSeq64Widget : ModuleWidget {
 			}
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			cvToStr();
+			state += text;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			nvgTextLetterSpacing(args.vg, -1.5);
@@ -563,21 +569,27 @@ struct WriteSeq64Widget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~~~~~~", NULL);
 			nvgFillColor(args.vg, textColor);
-			cvToStr();
 			nvgText(args.vg, textPos.x, textPos.y, text, NULL);
 		}
 	};
 
 
-	struct StepsDisplayWidget : TransparentWidget {
+	struct StepsDisplayWidget : CachedDisplayWidget {
 		WriteSeq64 *module;
 		std::shared_ptr<Font> font;
+		char displayStr[3];
 		
 		StepsDisplayWidget() {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			unsigned int numSteps = (module ? (unsigned) module->indexSteps[module->calcChan()] : 64);
+			snprintf(displayStr, 3, "%2u", numSteps);
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			//nvgTextLetterSpacing(args.vg, 2.5);
@@ -586,23 +598,27 @@ struct WriteSeq64Widget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~~", NULL);
 			nvgFillColor(args.vg, textColor);
-			char displayStr[3];
-			unsigned int numSteps = (module ? (unsigned) module->indexSteps[module->calcChan()] : 64);
-			snprintf(displayStr, 3, "%2u", numSteps);
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};	
 	
 	
-	struct StepDisplayWidget : TransparentWidget {
+	struct StepDisplayWidget : CachedDisplayWidget {
 		WriteSeq64 *module;
 		std::shared_ptr<Font> font;
+		char displayStr[3];
 		
 		StepDisplayWidget() {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			unsigned int stepNum = (module ? (unsigned) module->indexStep[module->calcChan()] : 0);
+			snprintf(displayStr, 3, "%2u", stepNum + 1);
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			//nvgTextLetterSpacing(args.vg, 2.5);
@@ -611,23 +627,28 @@ struct WriteSeq64Widget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~~", NULL);
 			nvgFillColor(args.vg, textColor);
-			char displayStr[3];
-			unsigned int stepNum = (module ? (unsigned) module->indexStep[module->calcChan()] : 0);
-			snprintf(displayStr, 3, "%2u", stepNum + 1);
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};
 	
 	
-	struct ChannelDisplayWidget : TransparentWidget {
+	struct ChannelDisplayWidget : CachedDisplayWidget {
 		WriteSeq64 *module;
 		std::shared_ptr<Font> font;
+		char displayStr[2];
 		
 		ChannelDisplayWidget() {
 			font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/Segment14.ttf"));
 		}
 
-		void draw(const DrawArgs &args) override {
+		void printState(DisplayState &state) override {
+			char chanNum = (module ? module->calcChan() : 0);
+			displayStr[0] = 0x30 + (char) (chanNum + 1);
+			displayStr[1] = 0;
+			state += displayStr;
+		}
+
+		void drawDisplay(const DrawArgs &args) override {
 			NVGcolor textColor = prepareDisplay(args.vg, &box, 18);
 			nvgFontFaceId(args.vg, font->handle);
 			//nvgTextLetterSpacing(args.vg, 2.5);
@@ -636,10 +657,6 @@ struct WriteSeq64Widget : ModuleWidget {
 			nvgFillColor(args.vg, nvgTransRGBA(textColor, displayAlpha));
 			nvgText(args.vg, textPos.x, textPos.y, "~", NULL);
 			nvgFillColor(args.vg, textColor);
-			char displayStr[2];
-			char chanNum = (module ? module->calcChan() : 0);
-			displayStr[0] = 0x30 + (char) (chanNum + 1);
-			displayStr[1] = 0;
 			nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
 		}
 	};
@@ -692,8 +709,10 @@ struct WriteSeq64Widget : ModuleWidget {
 		// Main panels from Inkscape
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/light/WriteSeq64.svg")));
         if (module) {
-			darkPanel = new SvgPanel();
-			darkPanel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/dark/WriteSeq64_dark.svg")));
+			darkPanel = new DynamicSVGPanel();
+			darkPanel->addFrameAlt(asset::plugin(pluginInstance, "res/dark/WriteSeq64_dark.svg"));
+			darkPanel->mode = &module->panelTheme;
+			darkPanel->lightPanel = panel;
 			darkPanel->visible = false;
 			addChild(darkPanel);
 		}
@@ -842,14 +861,6 @@ struct WriteSeq64Widget : ModuleWidget {
 		addOutput(createDynamicPort<IMPort>(Vec(columnRuler5, rowRuler2), false, module, WriteSeq64::GATE_OUTPUTS + 2, module ? &module->panelTheme : NULL));
 		addOutput(createDynamicPort<IMPort>(Vec(columnRuler5, rowRuler3), false, module, WriteSeq64::GATE_OUTPUTS + 3, module ? &module->panelTheme : NULL));
 	}
-	
-	void step() override {
-		if (module) {
-			panel->visible = ((((WriteSeq64*)module)->panelTheme) == 0);
-			darkPanel->visible  = ((((WriteSeq64*)module)->panelTheme) == 1);
-		}
-		Widget::step();
-	}
 };
 
 Model *modelWriteSeq64 = createModel<WriteSeq64, WriteSeq64Widget>("Write-Seq-64");
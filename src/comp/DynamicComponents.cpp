@@ -18,17 +18,41 @@ void DynamicSVGScrew::addFrame(std::shared_ptr<Svg> svg) {
 	}
 }
 
-void DynamicSVGScrew::step() {
-    if(mode != NULL && *mode != oldMode) {
-        if (*mode > 0 && !frameAltName.empty()) {// JIT loading of alternate skin
+void DynamicSVGScrew::applyMode(int newMode) {
+    if(newMode != oldMode) {
+        if (newMode > 0 && !frameAltName.empty()) {// JIT loading of alternate skin
 			frames.push_back(APP->window->loadSvg(frameAltName));
 			frameAltName.clear();// don't reload!
 		}
-        sw->setSvg(frames[*mode]);
-        oldMode = *mode;
+        sw->setSvg(frames[newMode]);
+        oldMode = newMode;
         fb->dirty = true;
     }
-	SvgScrew::step();
+}
+
+
+
+// Dynamic SVGPanel
+
+void DynamicSVGPanel::step() {
+	if (mode != NULL && *mode != oldMode) {
+		visible = ((*mode) == 1);
+		if (lightPanel != NULL)
+			lightPanel->visible = ((*mode) == 0);
+		oldMode = *mode;
+		if (parent != NULL) {
+			for (Widget *sibling : parent->children) {
+				DynamicModeWidget *dynWidget = dynamic_cast<DynamicModeWidget*>(sibling);
+				if (dynWidget != NULL)
+					dynWidget->applyMode(*mode);
+			}
+		}
+	}
+	if (visible && !frameAltName.empty()) {// JIT loading of alternate skin
+		setBackground(APP->window->loadSvg(frameAltName));
+		frameAltName.clear();// don't reload!
+	}
+	SvgPanel::step();
 }
 
 
@@ -42,17 +66,16 @@ void DynamicSVGPort::addFrame(std::shared_ptr<Svg> svg) {
 	}
 }
 
-void DynamicSVGPort::step() {
-    if(mode != NULL && *mode != oldMode) {
-        if (*mode > 0 && !frameAltName.empty()) {// JIT loading of alternate skin
+void DynamicSVGPort::applyMode(int newMode) {
+    if(newMode != oldMode) {
+        if (newMode > 0 && !frameAltName.empty()) {// JIT loading of alternate skin
 			frames.push_back(APP->window->loadSvg(frameAltName));
 			frameAltName.clear();// don't reload!
 		}
-        sw->setSvg(frames[*mode]);
-        oldMode = *mode;
+        sw->setSvg(frames[newMode]);
+        oldMode = newMode;
         fb->dirty = true;
     }
-	SvgPort::step();
 }
 
 
@@ -67,15 +90,15 @@ void DynamicSVGSwitch::addFrameAll(std::shared_ptr<Svg> svg) {
 	}
 }
 
-void DynamicSVGSwitch::step() {
-    if(mode != NULL && *mode != oldMode) {
-        if (*mode > 0 && !frameAltName0.empty() && !frameAltName1.empty()) {// JIT loading of alternate skin
+void DynamicSVGSwitch::applyMode(int newMode) {
+    if(newMode != oldMode) {
+        if (newMode > 0 && !frameAltName0.empty() && !frameAltName1.empty()) {// JIT loading of alternate skin
 			framesAll.push_back(APP->window->loadSvg(frameAltName0));
 			framesAll.push_back(APP->window->loadSvg(frameAltName1));
 			frameAltName0.clear();// don't reload!
 			frameAltName1.clear();// don't reload!
 		}
-		if ((*mode) == 0) {
+		if (newMode == 0) {
 			frames[0]=framesAll[0];
 			frames[1]=framesAll[1];
 		}
@@ -83,11 +106,10 @@ void DynamicSVGSwitch::step() {
 			frames[0]=framesAll[2];
 			frames[1]=framesAll[3];
 		}
-        oldMode = *mode;
+        oldMode = newMode;
 		onChange(*(new event::Change()));// required because of the way SVGSwitch changes images, we only change the frames above.
 		fb->dirty = true;// dirty is not sufficient when changing via frames assignments above (i.e. onChange() is required)
     }
-	SvgSwitch::step();
 }
 
 
@@ -101,9 +123,9 @@ void DynamicSVGKnob::addFrameAll(std::shared_ptr<Svg> svg) {
 	}
 }
 
-void DynamicSVGKnob::step() {
-    if(mode != NULL && *mode != oldMode) {
-        if (*mode > 0 && !frameAltName.empty() && !frameEffectName.empty()) {// JIT loading of alternate skin
+void DynamicSVGKnob::applyMode(int newMode) {
+    if(newMode != oldMode) {
+        if (newMode > 0 && !frameAltName.empty() && !frameEffectName.empty()) {// JIT loading of alternate skin
 			framesAll.push_back(APP->window->loadSvg(frameAltName));
 			effect = new SvgWidget();
 			effect->setSvg(APP->window->loadSvg(frameEffectName));
@@ -112,7 +134,7 @@ void DynamicSVGKnob::step() {
 			frameAltName.clear();// don't reload!
 			frameEffectName.clear();// don't reload!
 		}
-        if ((*mode) == 0) {
+        if (newMode == 0) {
 			setSvg(framesAll[0]);
 			if (effect != NULL)
 				effect->visible = false;
@@ -121,9 +143,8 @@ void DynamicSVGKnob::step() {
 			setSvg(framesAll[1]);
 			effect->visible = true;
 		}
-        oldMode = *mode;
+        oldMode = newMode;
 		fb->dirty = true;
     }
-	SvgKnob::step();
 }
 
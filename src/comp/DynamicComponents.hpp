@@ -21,23 +21,30 @@ static const float blurRadiusRatio = 0.06f;
 
 // ******** Dynamic Widgets ********
 
+// The dynamic screws, ports and params do not check their mode in step(): they are set to *mode when created, 
+//   and the DynamicSVGPanel of their module widget calls applyMode() on them when *mode changes
+struct DynamicModeWidget {
+	virtual ~DynamicModeWidget() {}
+	virtual void applyMode(int newMode) = 0;
+};
+
 // General Dynamic Widget creation
 template <class TWidget>
 TWidget* createDynamicWidget(Vec pos, int* mode) {
 	TWidget *dynWidget = createWidget<TWidget>(pos);
-	dynWidget->mode = mode;
+	if (mode != NULL)
+		dynWidget->applyMode(*mode);
 	return dynWidget;
 }
 
-struct DynamicSVGScrew : SvgScrew {
-    int* mode = NULL;
+struct DynamicSVGScrew : SvgScrew, DynamicModeWidget {
     int oldMode = -1;
     std::vector<std::shared_ptr<Svg>> frames;
 	std::string frameAltName;
 
     void addFrame(std::shared_ptr<Svg> svg);
     void addFrameAlt(std::string filename) {frameAltName = filename;}
-    void step() override;
+    void applyMode(int newMode) override;
 };
 
 
@@ -49,6 +56,23 @@ struct IMScrew : DynamicSVGScrew {
 };
 
 
+// ******** Dynamic Panels ********
+
+// Alternate (dark) panel of a module widget; its svg is only loaded the first time the panel is shown, 
+//   and is shared with the other instances through the svg cache of the window.
+// The panel shows itself and hides lightPanel when *mode is 1 (and the reverse when 0), only when *mode changes, 
+//   and then applies *mode to the dynamic widgets of its module widget (its siblings)
+struct DynamicSVGPanel : SvgPanel {
+	int* mode = NULL;
+	int oldMode = -1;
+	Widget* lightPanel = NULL;
+	std::string frameAltName;
+	
+	void addFrameAlt(std::string filename) {frameAltName = filename;}
+	void step() override;
+};
+
+
 // ******** Dynamic Ports ********
 
 // General Dynamic Port creation
@@ -57,7 +81,8 @@ TDynamicPort* createDynamicPort(Vec pos, bool isInput, Module *module, int portI
 	TDynamicPort *dynPort = isInput ? 
 		createInput<TDynamicPort>(pos, module, portId) :
 		createOutput<TDynamicPort>(pos, module, portId);
-	dynPort->mode = mode;
+	if (mode != NULL)
+		dynPort->applyMode(*mode);
 	return dynPort;
 }
 template <class TDynamicPort>
@@ -67,15 +92,14 @@ TDynamicPort* createDynamicPortCentered(Vec pos, bool isInput, Module *module, i
 	return dynPort;
 }
 
-struct DynamicSVGPort : SvgPort {
-    int* mode = NULL;
+struct DynamicSVGPort : SvgPort, DynamicModeWidget {
     int oldMode = -1;
     std::vector<std::shared_ptr<Svg>> frames;
 	std::string frameAltName;
 
     void addFrame(std::shared_ptr<Svg> svg);
     void addFrameAlt(std::string filename) {frameAltName = filename;}
-    void step() override;
+    void applyMode(int newMode) override;
 };
 
 
@@ -95,7 +119,8 @@ struct IMPort : DynamicSVGPort {
 template <class TDynamicParam>
 TDynamicParam* createDynamicParam(Vec pos, Module *module, int paramId, int* mode) {
 	TDynamicParam *dynParam = createParam<TDynamicParam>(pos, module, paramId);
-	dynParam->mode = mode;
+	if (mode != NULL)
+		dynParam->applyMode(*mode);
 	return dynParam;
 }
 template <class TDynamicParam>
@@ -105,8 +130,7 @@ TDynamicParam* createDynamicParamCentered(Vec pos, Module *module, int paramId,
 	return dynParam;
 }
 
-struct DynamicSVGSwitch : SvgSwitch {
-    int* mode = NULL;
+struct DynamicSVGSwitch : SvgSwitch, DynamicModeWidget {
     int oldMode = -1;
 	std::vector<std::shared_ptr<Svg>> framesAll;
 	std::string frameAltName0;
@@ -115,11 +139,10 @@ struct DynamicSVGSwitch : SvgSwitch {
 	void addFrameAll(std::shared_ptr<Svg> svg);
     void addFrameAlt0(std::string filename) {frameAltName0 = filename;}
     void addFrameAlt1(std::string filename) {frameAltName1 = filename;}
-    void step() override;
+    void applyMode(int newMode) override;
 };
 
-struct DynamicSVGKnob : SvgKnob {
-    int* mode = NULL;
+struct DynamicSVGKnob : SvgKnob, DynamicModeWidget {
     int oldMode = -1;
 	std::vector<std::shared_ptr<Svg>> framesAll;
 	SvgWidget* effect = NULL;
@@ -129,7 +152,7 @@ struct DynamicSVGKnob : SvgKnob {
 	void addFrameAll(std::shared_ptr<Svg> svg);
     void addFrameAlt(std::string filename) {frameAltName = filename;}	
 	void addFrameEffect(std::string filename) {frameEffectName = filename;}	
-    void step() override;
+    void applyMode(int newMode) override;
 };
 
 
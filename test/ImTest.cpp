@@ -0,0 +1,113 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Headless checks and benchmarks, built against the stub Rack runtime (see test/Makefile)
+//***********************************************************************************************
+
+
+#include "ImTest.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+
+#ifndef IM_TEST_GOLDEN_DIR
+#define IM_TEST_GOLDEN_DIR "golden"
+#endif
+
+
+struct ImTestEntry {
+	const char *name;
+	ImTestFunc func;
+	bool isBench;
+};
+
+static std::vector<ImTestEntry> &imTestEntries() {
+	static std::vector<ImTestEntry> entries;
+	return entries;
+}
+
+static int numFailures = 0;
+
+
+ImTestRegistrar::ImTestRegistrar(const char *name, ImTestFunc func, bool isBench) {
+	ImTestEntry entry = {name, func, isBench};
+	imTestEntries().push_back(entry);
+}
+
+void imCheckFailed(const char *file, int line, const std::string &message) {
+	std::printf("  FAILED %s:%d: %s\n", file, line, message.c_str());
+	numFailures++;
+}
+
+void imCheckGolden(const char *name, const std::string &text) {
+	std::string path = std::string(IM_TEST_GOLDEN_DIR) + "/" + name + ".txt";
+	if (std::getenv("IM_UPDATE_GOLDEN")) {
+		std::ofstream out(path.c_str(), std::ios::binary);
+		out << text;
+		std::printf("  wrote %s\n", path.c_str());
+		return;
+	}
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in) {
+		imCheckFailed(__FILE__, __LINE__, "missing golden file " + path + " (make golden)");
+		return;
+	}
+	std::stringstream golden;
+	golden << in.rdbuf();
+	if (golden.str() == text)
+		return;
+	// report the first line that differs
+	std::istringstream goldenLines(golden.str());
+	std::istringstream textLines(text);
+	std::string goldenLine;
+	std::string textLine;
+	for (int lineNum = 1; ; lineNum++) {
+		bool goldenOk = (bool)std::getline(goldenLines, goldenLine);
+		bool textOk = (bool)std::getline(textLines, textLine);
+		if (!goldenOk && !textOk)
+			break;
+		if (!goldenOk || !textOk || goldenLine != textLine) {
+			imCheckFailed(__FILE__, __LINE__, path + ":" + std::to_string(lineNum) + ": expected \"" + (goldenOk ? goldenLine : "<end>") + 
+				"\", got \"" + (textOk ? textLine : "<end>") + "\"");
+			break;
+		}
+	}
+}
+
+void imReportBench(const char *what, double nanosPerIteration) {
+	std::printf("  %-56s %10.2f ns\n", what, nanosPerIteration);
+}
+
+
+int main(int argc, char **argv) {
+	// usage: imtest [--bench] [name ...]
+	bool runBenches = false;
+	std::vector<std::string> names;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--bench") == 0)
+			runBenches = true;
+		else
+			names.push_back(argv[i]);
+	}
+	
+	int numRun = 0;
+	for (const ImTestEntry &entry : imTestEntries()) {
+		if (entry.isBench != runBenches)
+			continue;
+		if (!names.empty() && std::find(names.begin(), names.end(), entry.name) == names.end())
+			continue;
+		int failuresBefore = numFailures;
+		std::printf("%s\n", entry.name);
+		entry.func();
+		std::printf("%s %s\n", numFailures == failuresBefore ? "  ok" : "  FAILED", entry.name);
+		numRun++;
+	}
+	
+	std::printf("%d %s run, %d failure%s\n", numRun, runBenches ? "benchmarks" : "checks", numFailures, numFailures == 1 ? "" : "s");
+	return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Headless checks and benchmarks, built against the stub Rack runtime (see test/Makefile)
+//***********************************************************************************************
+
+#ifndef IM_TEST_HPP
+#define IM_TEST_HPP
+
+
+#include <chrono>
+#include <string>
+
+
+// Checks run with "make test", benchmarks with "make bench"; each is a function registered by name
+
+typedef void (*ImTestFunc)();
+
+struct ImTestRegistrar {
+	ImTestRegistrar(const char *name, ImTestFunc func, bool isBench);
+};
+
+#define IM_TEST(name) \
+	static void name(); \
+	static ImTestRegistrar name##Registrar(#name, name, false); \
+	static void name()
+
+#define IM_BENCH(name) \
+	static void name(); \
+	static ImTestRegistrar name##Registrar(#name, name, true); \
+	static void name()
+
+
+// Failures are counted and reported, and the current check goes on so that all its failures are shown
+
+void imCheckFailed(const char *file, int line, const std::string &message);
+
+#define IM_CHECK(cond) \
+	do { \
+		if (!(cond)) \
+			imCheckFailed(__FILE__, __LINE__, #cond); \
+	} while (0)
+
+#define IM_CHECK_MSG(cond, message) \
+	do { \
+		if (!(cond)) \
+			imCheckFailed(__FILE__, __LINE__, std::string(#cond) + ": " + (message)); \
+	} while (0)
+
+
+// Compares text with test/golden/<name>.txt, or writes it there when IM_UPDATE_GOLDEN is set in the environment ("make golden")
+void imCheckGolden(const char *name, const std::string &text);
+
+
+// Benchmark report line: nanoseconds per iteration of what was timed
+void imReportBench(const char *what, double nanosPerIteration);
+
+struct ImStopwatch {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double nanos() const {
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+};
+
+
+#endif
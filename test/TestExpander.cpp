@@ -0,0 +1,112 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Checks of the expander messages in ImpromptuModular.hpp
+//***********************************************************************************************
+
+
+#include "ImTest.hpp"
+#include "ImpromptuModular.hpp"
+
+
+// An expander on the right of its mother, sending 4 values to it, with the mother's message buffers
+struct TestExpanderPair {
+	Module mother;
+	Module expander;
+	ExpanderMessage<4> rightMessages[2] = {};
+	ExpanderMessageWriter<4> writerToMother;
+	ExpanderMessageReader<4> readerFromExpander;
+
+	TestExpanderPair() {
+		mother.id = 1;
+		expander.id = 2;
+		mother.rightExpander.module = &expander;
+		mother.rightExpander.producerMessage = &rightMessages[0];
+		mother.rightExpander.consumerMessage = &rightMessages[1];
+	}
+	bool step() {// one engine sample: the expander sends, the engine flips, then the mother reads on the next sample
+		bool sent = writerToMother.send(&mother, mother.rightExpander);
+		if (mother.rightExpander.messageFlipRequested) {
+			std::swap(mother.rightExpander.producerMessage, mother.rightExpander.consumerMessage);
+			mother.rightExpander.messageFlipRequested = false;
+		}
+		return sent;
+	}
+	ExpanderMessage<4> *read() {
+		return readerFromExpander.read(mother.rightExpander, true);
+	}
+};
+
+
+// Only changes are sent, and the reader sees them as changed
+IM_TEST(expanderMessageChanges) {
+	TestExpanderPair pair;
+	IM_CHECK(pair.read() == NULL);// nothing sent yet
+
+	pair.writerToMother.values[1] = NAN;
+	IM_CHECK(pair.step());// new peer
+	ExpanderMessage<4> *message = pair.read();
+	IM_CHECK(message != NULL);
+	for (int i = 0; i < 4; i++)
+		IM_CHECK(pair.readerFromExpander.hasChanged(i));
+
+	IM_CHECK(!pair.step());// unchanged, NaN included
+	message = pair.read();
+	IM_CHECK(message != NULL && std::isnan(message->values[1]));
+	for (int i = 0; i < 4; i++)
+		IM_CHECK(!pair.readerFromExpander.hasChanged(i));
+
+	pair.writerToMother.values[2] = 5.0f;
+	IM_CHECK(pair.step());
+	message = pair.read();
+	IM_CHECK(message != NULL && message->values[2] == 5.0f);
+	IM_CHECK(pair.readerFromExpander.hasChanged(2) && !pair.readerFromExpander.hasChanged(0) && !pair.readerFromExpander.hasChanged(3));
+
+	// missed messages: all changed
+	pair.writerToMother.values[0] = 1.0f;
+	pair.step();
+	pair.writerToMother.values[3] = 1.0f;
+	pair.step();
+	pair.read();
+	for (int i = 0; i < 4; i++)
+		IM_CHECK(pair.readerFromExpander.hasChanged(i));
+}
+
+
+// A peer restored by an undo has the same id and cleared messages, and gets the values again
+IM_TEST(expanderMessageUndo) {
+	TestExpanderPair pair;
+	pair.writerToMother.values[0] = 3.0f;
+	pair.step();
+	IM_CHECK(pair.read() != NULL);
+
+	std::memset(pair.rightMessages, 0, sizeof(pair.rightMessages));// mother deleted then restored by undo
+	pair.readerFromExpander = ExpanderMessageReader<4>();
+	IM_CHECK(pair.read() == NULL);
+
+	IM_CHECK(pair.step());// resent although no value changed
+	ExpanderMessage<4> *message = pair.read();
+	IM_CHECK(message != NULL && message->values[0] == 3.0f);
+	IM_CHECK(pair.readerFromExpander.hasChanged(0));
+	IM_CHECK(!pair.step());// and then only changes again
+}
+
+
+// Modulated inputs speed up the exchanges down to the mothers' input refresh rate, static ones slow them back down
+IM_TEST(expanderRefreshCounter) {
+	ExpanderRefreshCounter counter;
+	IM_CHECK(counter.stepSkips == expanderRefreshStepSkips);
+	for (int i = 0; i < 10; i++)
+		counter.update(true);
+	IM_CHECK(counter.stepSkips == ExpanderRefreshCounter::minStepSkips);
+	IM_CHECK(ExpanderRefreshCounter::minStepSkips == RefreshCounter::userInputsStepSkipMask + 1);
+	int numProcessed = 0;
+	for (unsigned int i = 0; i < 10 * ExpanderRefreshCounter::minStepSkips; i++) {
+		if (counter.process())
+			numProcessed++;
+	}
+	IM_CHECK(numProcessed == 10);
+	for (int i = 0; i < 10; i++)
+		counter.update(false);
+	IM_CHECK(counter.stepSkips == expanderRefreshStepSkips);
+}
@@ -0,0 +1,129 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Checks and benchmarks of the DSP helpers in FundamentalUtil.hpp and ImpromptuModular.hpp
+//***********************************************************************************************
+
+
+#include "ImTest.hpp"
+#include "FundamentalUtil.hpp"
+
+
+// LowFrequencyOscillator sine (QuadratureOscillator)
+
+// Largest error of the LFO sine against std::sin of the LFO's own phase, over minutes of run time;
+//   pitchMod (in V) modulates the rate every sample with a 0.1 Hz triangle, so that the rotation is recomputed every sample
+static float lfoSineError(float sampleRate, float pitch, float pitchMod, int seconds, float *lastMinuteError) {
+	LowFrequencyOscillator lfo;
+	lfo.setPitch(pitch);
+	float dt = 1.0f / sampleRate;
+	long numSamples = (long)sampleRate * seconds;
+	long lastMinuteStart = numSamples - (long)sampleRate * 60;
+	float maxError = 0.0f;
+	*lastMinuteError = 0.0f;
+	for (long i = 0; i < numSamples; i++) {
+		if (pitchMod != 0.0f) {
+			float tri = std::fabs(std::fmod(i * dt * 0.1f, 1.0f) * 2.0f - 1.0f);
+			lfo.setPitch(pitch + pitchMod * tri);
+		}
+		lfo.step(dt);
+		if ((i & 0xF) == 0) {
+			float error = std::fabs(lfo.sin() - (float)std::sin(2.0 * M_PI * lfo.phase));
+			maxError = std::fmax(maxError, error);
+			if (i >= lastMinuteStart)
+				*lastMinuteError = std::fmax(*lastMinuteError, error);
+		}
+	}
+	return maxError;
+}
+
+IM_TEST(lfoSineDrift) {
+	static const float sampleRates[] = {44100.0f, 48000.0f, 96000.0f};
+	static const float pitches[] = {-7.0f, -2.0f, 0.0f, 4.0f, 8.0f};// 0.008 Hz to 256 Hz
+	for (float sampleRate : sampleRates) {
+		for (float pitch : pitches) {
+			for (float pitchMod : {0.0f, 1.0f}) {
+				float lastMinuteError;
+				float maxError = lfoSineError(sampleRate, pitch - pitchMod, pitchMod, 5 * 60, &lastMinuteError);
+				std::printf("  %5.0f Hz, pitch %+.0f V, mod %.0f V: max error %.2e, last minute %.2e\n", sampleRate, pitch, pitchMod, maxError, lastMinuteError);
+				// the error comes from the table at each anchor, and does not grow with run time
+				IM_CHECK_MSG(maxError <= 2e-5f, string::f("%g Hz, pitch %g, max error %g", sampleRate, pitch, maxError));
+			}
+		}
+	}
+}
+
+IM_BENCH(lfoSine) {
+	static const int numSamples = 1 << 22;
+	float dt = 1.0f / 44100.0f;
+	float sum = 0.0f;
+	for (float pitchMod : {0.0f, 1.0f}) {
+		LowFrequencyOscillator lfo;
+		lfo.setPitch(0.0f);
+		ImStopwatch stopwatch;
+		for (int i = 0; i < numSamples; i++) {
+			if (pitchMod != 0.0f)
+				lfo.setPitch(pitchMod * (float)(i & 0xFFF) * (1.0f / 4096.0f));
+			lfo.step(dt);
+			sum += lfo.sin();
+		}
+		imReportBench(pitchMod != 0.0f ? "LFO step + sin(), rate modulated every sample" : "LFO step + sin(), constant rate", stopwatch.nanos() / numSamples);
+	}
+	IM_CHECK(std::isfinite(sum));
+}
+
+
+// fastExp2() and voltToFreq()
+
+// Every float in [-10V : 10V] that is a multiple of 2^-17 V (2.6 million points), against exp2 in double
+IM_TEST(fastExp2Accuracy) {
+	double maxRelError = 0.0;
+	double maxRelErrorFreq = 0.0;
+	float maxErrorVolts = 0.0f;
+	float lastFreq = 0.0f;
+	bool monotonic = true;
+	for (int i = -10 * (1 << 17); i <= 10 * (1 << 17); i++) {
+		float volts = (float)i * (1.0f / (1 << 17));
+		double relError = std::fabs((double)fastExp2(volts) / std::exp2((double)volts) - 1.0);
+		if (relError > maxRelError) {
+			maxRelError = relError;
+			maxErrorVolts = volts;
+		}
+		float freq = voltToFreq(volts, dsp::FREQ_C4);
+		maxRelErrorFreq = std::fmax(maxRelErrorFreq, std::fabs((double)freq / (dsp::FREQ_C4 * std::exp2((double)volts)) - 1.0));
+		if (freq < lastFreq)
+			monotonic = false;
+		lastFreq = freq;
+	}
+	std::printf("  fastExp2: max relative error %.3e at %+.6f V (%.6f cents)\n", maxRelError, maxErrorVolts, 1200.0 * std::log2(1.0 + maxRelError));
+	std::printf("  voltToFreq: max relative error %.3e\n", maxRelErrorFreq);
+	IM_CHECK_MSG(maxRelError <= 1.8e-7, string::f("%g", maxRelError));// the bound stated in ImpromptuModular.hpp
+	IM_CHECK_MSG(maxRelErrorFreq <= 2.5e-7, string::f("%g", maxRelErrorFreq));// one more float rounding
+	IM_CHECK(monotonic);
+	for (int i = 0; i < 1000; i++) {// octaves are exact ratios, since they only change the exponent
+		float volts = (float)((int)(random::u32() % (19 << 17)) - (10 << 17)) * (1.0f / (1 << 17));// on the grid, so that volts + 1 is exact
+		IM_CHECK(fastExp2(volts + 1.0f) == 2.0f * fastExp2(volts));
+	}
+	IM_CHECK(fastExp2(-1000.0f) == fastExp2(-126.0f));
+	IM_CHECK(fastExp2(1000.0f) == fastExp2(126.0f));
+}
+
+IM_BENCH(fastExp2) {
+	static const int numValues = 4096;
+	static const int numPasses = 1024;
+	float volts[numValues];
+	for (int i = 0; i < numValues; i++)
+		volts[i] = random::uniform() * 20.0f - 10.0f;
+	float sum = 0.0f;
+	ImStopwatch stopwatch;
+	for (int p = 0; p < numPasses; p++)
+		for (int i = 0; i < numValues; i++)
+			sum += fastExp2(volts[i]);
+	imReportBench("fastExp2()", stopwatch.nanos() / (numValues * numPasses));
+	stopwatch = ImStopwatch();
+	for (int p = 0; p < numPasses; p++)
+		for (int i = 0; i < numValues; i++)
+			sum += std::pow(2.0f, volts[i]);
+	imReportBench("std::pow(2.0f, x)", stopwatch.nanos() / (numValues * numPasses));
+	IM_CHECK(std::isfinite(sum));
+}
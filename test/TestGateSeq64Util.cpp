@@ -0,0 +1,74 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Checks of the pages of the GateSeq64 sequences in GateSeq64Util.hpp
+//***********************************************************************************************
+
+
+#include "ImTest.hpp"
+#include "GateSeq64Util.hpp"
+
+
+static void fillPage(StepAttributesGS *pageSteps, int seed) {// gates on every other step, and a non default probability every 4 steps
+	for (int s = 0; s < 64; s++) {
+		pageSteps[s].init();
+		pageSteps[s].setGate(((s + seed) & 0x1) != 0);
+		if ((s & 0x3) == 0) {
+			pageSteps[s].setGateP(true);
+			pageSteps[s].setGatePVal((s + seed) % 101);
+		}
+	}
+}
+
+
+// Pages go back and forth between the loaded page and the pool unchanged, and only the non default steps take room in the pool
+IM_TEST(pagedStepsStoreLoad) {
+	PagedStepsGS pages;
+	pages.init();
+	StepAttributesGS pageSteps[64];
+	StepAttributesGS loaded[64];
+	for (int p = 0; p < 3; p++) {
+		fillPage(pageSteps, p);
+		IM_CHECK(pages.storePage(p, pageSteps));
+	}
+	IM_CHECK(pages.numOverrides == 3 * 16);
+	fillPage(pageSteps, 1);
+	for (int s = 0; s < 64; s++)
+		IM_CHECK(pages.getAttribute(1, s).getAttribute() == pageSteps[s].getAttribute());
+	
+	pages.loadPage(1, loaded);
+	for (int s = 0; s < 64; s++)
+		IM_CHECK(loaded[s].getAttribute() == pageSteps[s].getAttribute());
+	IM_CHECK(pages.numOverrides == 2 * 16);
+	IM_CHECK(pages.gateBits[1] == 0);
+	
+	loaded[5].setGateMode(3);// edit and store back
+	IM_CHECK(pages.storePage(1, loaded));
+	IM_CHECK(pages.numOverrides == 2 * 16 + 17);
+	IM_CHECK(pages.getAttribute(1, 5).getGateMode() == 3);
+	IM_CHECK(pages.getAttribute(1, 5).getGate() == pageSteps[5].getGate());
+	IM_CHECK(pages.getAttribute(7, 5).getAttribute() == StepAttributesGS::ATT_MSK_INITSTATE);
+	for (int o = 1; o < pages.numOverrides; o++)
+		IM_CHECK(pages.overrideSteps[o - 1] < pages.overrideSteps[o]);
+}
+
+
+// A page that does not fit in the pool is not stored, and the pool is left as it was
+IM_TEST(pagedStepsFull) {
+	PagedStepsGS pages;
+	pages.init();
+	StepAttributesGS pageSteps[64];
+	for (int s = 0; s < 64; s++) {
+		pageSteps[s].init();
+		pageSteps[s].setGateMode(1);
+	}
+	int p = 0;
+	for (; p < PagedStepsGS::MAX_PAGES; p++) {
+		if (!pages.storePage(p, pageSteps))
+			break;
+	}
+	IM_CHECK(p == PagedStepsGS::MAX_OVERRIDES / 64);
+	IM_CHECK(pages.numOverrides == p * 64);
+	IM_CHECK(pages.gateBits[p] == 0 && pages.getAttribute(p, 0).getGateMode() == 0);
+	IM_CHECK(pages.storePage(0, pageSteps));// replacing a page's steps needs no more room
+}
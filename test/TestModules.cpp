@@ -0,0 +1,237 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Scripted runs of the modules' process(): outputs checked against golden files, save/load round trips, and benchmarks
+//***********************************************************************************************
+
+
+#include "ImTest.hpp"
+#include "ImpromptuModular.hpp"
+
+
+// Input and param ids of the modules (see their InputIds and ParamIds enums)
+static const int CLOCKED_RATIO_PARAMS = 0;
+static const int CLOCKED_SWING_PARAMS = 4;
+static const int CLOCKED_DELAY_PARAMS = 14;
+static const int FOUNDRY_CLOCK_INPUTS = 6;
+static const int GATESEQ64_CLOCK_INPUT = 0;
+static const int PHRASESEQ_CLOCK_INPUT = 3;// PhraseSeq16, PhraseSeq32 and SemiModularSynth
+static const int PHRASESEQ_RUN_PARAM = 5;
+static const int SMS_VCF_LPF_OUTPUT = 10;
+
+
+// A module and its widget as Rack creates them, processed at 44.1 kHz with all its outputs connected,
+//   and with its widget stepped at 60 Hz as the UI would
+struct ModuleRig {
+	static const int samplesPerFrame = 735;
+	ModuleWidget *widget;
+	Module *module;
+	Module::ProcessArgs args;
+	long sampleCount = 0;
+
+	ModuleRig(Model *model) {
+		widget = model->createModuleWidget();
+		module = widget->module;
+		args.sampleRate = APP->engine->getSampleRate();
+		args.sampleTime = 1.0f / args.sampleRate;
+		for (Output &output : module->outputs)
+			output.setChannels(1);
+	}
+	~ModuleRig() {
+		delete widget;
+	}
+
+	void process(int numSamples) {
+		for (int i = 0; i < numSamples; i++) {
+			module->process(args);
+			if (++sampleCount % samplesPerFrame == 0)
+				widget->step();
+		}
+	}
+	void pressButton(int paramId) {// held long enough to be seen by the inputs refresh
+		module->params[paramId].setValue(1.0f);
+		process(256);
+		module->params[paramId].setValue(0.0f);
+		process(256);
+	}
+	// Square clock on the given inputs (numInputs consecutive ones), onClock() is called a quarter period after each rising edge
+	void clock(int firstInput, int numInputs, int numClocks, int period, std::function<void(int)> onClock) {
+		for (int i = 0; i < numInputs; i++)
+			module->inputs[firstInput + i].setChannels(1);
+		for (int k = 0; k < numClocks; k++) {
+			for (int i = 0; i < numInputs; i++)
+				module->inputs[firstInput + i].setVoltage(10.0f);
+			process(period / 4);
+			if (onClock)
+				onClock(k);
+			process(period / 2 - period / 4);
+			for (int i = 0; i < numInputs; i++)
+				module->inputs[firstInput + i].setVoltage(0.0f);
+			process(period - period / 2);
+		}
+	}
+
+	std::string printOutputs(int firstOutput, int numOutputs) {
+		std::string text;
+		for (int i = 0; i < numOutputs; i++)
+			text += string::f(" %6.3f", module->outputs[firstOutput + i].getVoltage());
+		return text;
+	}
+};
+
+
+// Copies the state of one module into another through dataToJson() and dataFromJson(), as a save and a load of the patch do
+static void copyModule(Module *from, Module *to) {
+	json_t *rootJ = from->dataToJson();
+	char *text = json_dumps(rootJ, 0);
+	json_decref(rootJ);
+	json_error_t error;
+	rootJ = json_loads(text, 0, &error);
+	std::free(text);
+	to->dataFromJson(rootJ);
+	json_decref(rootJ);
+}
+
+
+// Sequencers: a randomized module (fixed seed) clocked numClocks times, with all its outputs printed on each clock,
+//   and the same run after a save and load into a new module
+static std::string runSequencer(ModuleRig &rig, int clockInput, int numClockInputs, int numClocks) {
+	std::string text;
+	int numOutputs = (int)rig.module->outputs.size();
+	random::seed(0x5EC0, 0x0001);
+	rig.clock(clockInput, numClockInputs, numClocks, 2205, [&](int k) {
+		text += string::f("%3d", k) + rig.printOutputs(0, numOutputs) + "\n";
+	});
+	return text;
+}
+
+static void checkSequencer(Model *model, const char *name, int clockInput, int numClockInputs) {
+	ModuleRig rig(model);
+	random::seed(0x5EC0, 0x0000);
+	rig.module->onRandomize();
+	rig.process(4410);// past the clock ignore on reset
+	ModuleRig loaded(model);
+	copyModule(rig.module, loaded.module);
+	loaded.process(4410);
+
+	std::string text = runSequencer(rig, clockInput, numClockInputs, 64);
+	imCheckGolden(name, text);
+	IM_CHECK_MSG(runSequencer(loaded, clockInput, numClockInputs, 64) == text, std::string(name) + " after a save and load");
+}
+
+IM_TEST(modulePhraseSeq16) {
+	checkSequencer(modelPhraseSeq16, "modulePhraseSeq16", PHRASESEQ_CLOCK_INPUT, 1);
+}
+
+IM_TEST(modulePhraseSeq32) {
+	checkSequencer(modelPhraseSeq32, "modulePhraseSeq32", PHRASESEQ_CLOCK_INPUT, 1);
+}
+
+IM_TEST(moduleGateSeq64) {
+	checkSequencer(modelGateSeq64, "moduleGateSeq64", GATESEQ64_CLOCK_INPUT, 1);
+}
+
+IM_TEST(moduleFoundry) {
+	checkSequencer(modelFoundry, "moduleFoundry", FOUNDRY_CLOCK_INPUTS, 1);// the clock of track A is normalled to the others
+}
+
+
+// Run stopped and restarted: no clock is played while stopped, and the run goes on from where it was
+IM_TEST(modulePhraseSeq16Run) {
+	ModuleRig rig(modelPhraseSeq16);
+	random::seed(0x5EC0, 0x0000);
+	rig.module->onRandomize();
+	rig.process(4410);
+	std::string text;
+	rig.clock(PHRASESEQ_CLOCK_INPUT, 1, 8, 2205, [&](int k) {text += rig.printOutputs(0, 3) + "\n";});
+	rig.pressButton(PHRASESEQ_RUN_PARAM);
+	std::string stopped;
+	rig.clock(PHRASESEQ_CLOCK_INPUT, 1, 8, 2205, [&](int k) {stopped += rig.printOutputs(0, 3) + "\n";});
+	rig.pressButton(PHRASESEQ_RUN_PARAM);
+	rig.clock(PHRASESEQ_CLOCK_INPUT, 1, 8, 2205, [&](int k) {text += rig.printOutputs(0, 3) + "\n";});
+
+	ModuleRig uninterrupted(modelPhraseSeq16);
+	random::seed(0x5EC0, 0x0000);
+	uninterrupted.module->onRandomize();
+	uninterrupted.process(4410);
+	std::string expected;
+	uninterrupted.clock(PHRASESEQ_CLOCK_INPUT, 1, 16, 2205, [&](int k) {expected += uninterrupted.printOutputs(0, 3) + "\n";});
+	IM_CHECK(text == expected);
+	IM_CHECK(stopped.find("10.000") == std::string::npos);// no gate while stopped
+}
+
+
+// SemiModularSynth: the sequencer on its internal clock, played by the internal synth path,
+//   with the sequencer outputs and the filter output level printed every 50 ms
+IM_TEST(moduleSemiModularSynth) {
+	ModuleRig rig(modelSemiModularSynth);
+	random::seed(0x5EC0, 0x0000);
+	rig.module->onRandomize();
+	std::string text;
+	for (int frame = 0; frame < 60; frame++) {
+		float sumSquares = 0.0f;
+		for (int i = 0; i < 2205; i++) {
+			rig.process(1);
+			float lpf = rig.module->outputs[SMS_VCF_LPF_OUTPUT].getVoltage();
+			sumSquares += lpf * lpf;
+		}
+		text += string::f("%3d", frame) + rig.printOutputs(0, 3) + string::f("  lpf rms %6.3f\n", std::sqrt(sumSquares / 2205));
+	}
+	imCheckGolden("moduleSemiModularSynth", text);
+}
+
+
+// Clocked: rising edges of the four clock outputs over four seconds, with ratios, swing and delay on the sub clocks
+IM_TEST(moduleClocked) {
+	ModuleRig rig(modelClocked);
+	rig.module->params[CLOCKED_RATIO_PARAMS + 1].setValue(2.0f);// x2
+	rig.module->params[CLOCKED_RATIO_PARAMS + 2].setValue(-4.0f);// /3
+	rig.module->params[CLOCKED_RATIO_PARAMS + 3].setValue(1.0f);// x1.5
+	rig.module->params[CLOCKED_SWING_PARAMS + 1].setValue(0.5f);
+	rig.module->params[CLOCKED_DELAY_PARAMS + 3].setValue(2.0f);// 1/8
+	copyModule(rig.module, rig.module);// the ratios are taken when a patch is loaded (or when their knobs are turned)
+
+	std::vector<long> edges[4];
+	bool high[4] = {};
+	for (long s = 0; s < 4 * 44100; s++) {
+		rig.process(1);
+		for (int i = 0; i < 4; i++) {
+			bool isHigh = rig.module->outputs[i].getVoltage() > 5.0f;
+			if (isHigh && !high[i])
+				edges[i].push_back(s);
+			high[i] = isHigh;
+		}
+	}
+	std::string text;
+	for (int i = 0; i < 4; i++) {
+		text += string::f("clock %d: %d edges:", i, (int)edges[i].size());
+		for (long edge : edges[i])
+			text += string::f(" %ld", edge);
+		text += "\n";
+	}
+	imCheckGolden("moduleClocked", text);
+}
+
+
+// Cost of process() per sample, clocked at 120 BPM (sequencers) or running on its own clock (Clocked, SemiModularSynth)
+static void benchModule(Model *model, const char *what, int clockInput, int numClockInputs) {
+	ModuleRig rig(model);
+	random::seed(0x5EC0, 0x0000);
+	rig.module->onRandomize();
+	rig.process(4410);
+	ImStopwatch stopwatch;
+	if (clockInput >= 0)
+		rig.clock(clockInput, numClockInputs, 40, 11025, NULL);
+	else
+		rig.process(40 * 11025);
+	imReportBench(what, stopwatch.nanos() / (40 * 11025));
+}
+
+IM_BENCH(modules) {
+	benchModule(modelPhraseSeq16, "PhraseSeq16 process() and UI, per sample", PHRASESEQ_CLOCK_INPUT, 1);
+	benchModule(modelPhraseSeq32, "PhraseSeq32 process() and UI, per sample", PHRASESEQ_CLOCK_INPUT, 1);
+	benchModule(modelGateSeq64, "GateSeq64 process() and UI, per sample", GATESEQ64_CLOCK_INPUT, 1);
+	benchModule(modelFoundry, "Foundry process() and UI, per sample", FOUNDRY_CLOCK_INPUTS, 1);
+	benchModule(modelSemiModularSynth, "SemiModularSynth process() and UI, per sample", -1, 0);
+	benchModule(modelClocked, "Clocked process() and UI, per sample", -1, 0);
+}
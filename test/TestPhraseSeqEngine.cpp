@@ -0,0 +1,281 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Checks of the run/edit engine shared by PhraseSeq16, PhraseSeq32 and SemiModularSynth, and of the run modes
+//***********************************************************************************************
+
+
+#include "ImTest.hpp"
+#include "PhraseSeqEngine.hpp"
+
+
+typedef PhraseSeqEngine<16, 16, NUM_MODES - 1> EnginePS16;
+
+
+static void initEngine(EnginePS16 &engine) {
+	engine.holdTiedNotes = true;
+	engine.running = true;
+	engine.runModeSong = MODE_FWD;
+	engine.stopAtEndOfSong = false;
+	engine.preRollProb = false;
+	engine.initSequences(16);
+	engine.initCopyPaste();
+	engine.phraseIndexRun = 0;
+	engine.phraseIndexRunHistory = 0;
+	engine.stepIndexRunHistory = 0;
+}
+
+static void randomizeSong(EnginePS16 &engine, int numPhrases) {
+	for (int seqn = 0; seqn < EnginePS16::NUM_SEQS; seqn++)
+		engine.randomizeSequence(seqn, EnginePS16::NUM_STEPS);
+	engine.phrases = numPhrases;
+	for (int p = 0; p < numPhrases; p++)
+		engine.phrase[p] = random::u32() % EnginePS16::NUM_SEQS;
+	// StepAttributes::randomize() can draw the unused gate types 12 to 15, keep the ones that exist
+	for (int seqn = 0; seqn < EnginePS16::NUM_SEQS; seqn++) {
+		for (int s = 0; s < EnginePS16::NUM_STEPS; s++) {
+			engine.attributes[seqn][s].setGate1Mode(engine.attributes[seqn][s].getGate1Mode() % NUM_GATES);
+			engine.attributes[seqn][s].setGate2Mode(engine.attributes[seqn][s].getGate2Mode() % NUM_GATES);
+		}
+	}
+}
+
+
+// Song playback: each step's sequence, index, CV and gate codes over 4 pulses per step, for each song run mode,
+//   with random sequences (lengths, run modes, attributes) from a fixed seed
+IM_TEST(phraseSeqEngineSong) {
+	static const int pulsesPerStep = 4;
+	random::seed(0x1234, 0x5678);
+	std::string text;
+	for (int runModeSong = 0; runModeSong < NUM_MODES - 1; runModeSong++) {
+		EnginePS16 engine;
+		initEngine(engine);
+		randomizeSong(engine, 7);
+		engine.runModeSong = runModeSong;
+		engine.preRollProb = (runModeSong & 0x1) != 0;
+		text += string::f("song mode %s, pre-roll %d\n", modeLabels[runModeSong].c_str(), engine.preRollProb ? 1 : 0);
+		int stepIndexRun = 0;
+		int seqn = engine.initRunIndexes(false, 0, &stepIndexRun);
+		for (int step = 0; step < 200; step++) {
+			if (step > 0)
+				seqn = engine.moveRunIndexes(false, 0, &stepIndexRun);
+			StepAttributes attribute = engine.attributes[seqn][stepIndexRun];
+			text += string::f("%3d: phr %2d seq %2d step %2d cv %+.4f gates", step, engine.phraseIndexRun, seqn, stepIndexRun, engine.cv[seqn][stepIndexRun]);
+			for (int ppqnCount = 0; ppqnCount < pulsesPerStep; ppqnCount++) {
+				int preRolled = engine.preRollGate1(seqn, stepIndexRun, ppqnCount, 0.5f);
+				text += string::f(" %+d/%d", calcGate1Code(attribute, ppqnCount, pulsesPerStep, 0.5f, preRolled), calcGate2Code(attribute, ppqnCount, pulsesPerStep));
+			}
+			text += "\n";
+		}
+	}
+	imCheckGolden("phraseSeqEngineSong", text);
+}
+
+
+// Stop at end of song: the run stops on the last step of the last phrase, which is kept as the run position
+IM_TEST(phraseSeqEngineStopAtEnd) {
+	EnginePS16 engine;
+	initEngine(engine);
+	engine.phrases = 3;
+	engine.stopAtEndOfSong = true;
+	for (int seqn = 0; seqn < 3; seqn++) {
+		engine.phrase[seqn] = seqn;
+		engine.sequences[seqn].setLength(4);
+	}
+	int stepIndexRun = 0;
+	engine.initRunIndexes(false, 0, &stepIndexRun);
+	int numSteps = 1;
+	while (engine.running && numSteps < 100) {
+		engine.moveRunIndexes(false, 0, &stepIndexRun);
+		numSteps++;
+	}
+	IM_CHECK(!engine.running);
+	IM_CHECK(numSteps == 3 * 4 + 1);// the move after the last step is the one that stops
+	IM_CHECK(engine.phraseIndexRun == 2);
+	IM_CHECK(stepIndexRun == 3);
+}
+
+
+// Edits: copy/paste, rotation and tied steps
+IM_TEST(phraseSeqEngineEdits) {
+	random::seed(0xABCD, 0xEF01);
+	EnginePS16 engine;
+	initEngine(engine);
+	engine.randomizeSequence(0, 16);
+	engine.sequences[0].setLength(16);
+
+	// rotate right then left is the identity
+	float cvBefore[16];
+	unsigned short attributesBefore[16];
+	for (int s = 0; s < 16; s++) {
+		cvBefore[s] = engine.cv[0][s];
+		attributesBefore[s] = engine.attributes[0][s].getAttribute();
+	}
+	engine.rotateSeq(0, true, 16);
+	IM_CHECK(engine.cv[0][0] == cvBefore[15]);
+	IM_CHECK(engine.cv[0][1] == cvBefore[0]);
+	engine.rotateSeq(0, false, 16);
+	for (int s = 0; s < 16; s++) {
+		IM_CHECK(engine.cv[0][s] == cvBefore[s]);
+		IM_CHECK(engine.attributes[0][s].getAttribute() == attributesBefore[s]);
+	}
+
+	// copy 4 steps from step 2 of sequence 0, paste them at step 8 of sequence 1
+	engine.copy(true, 0, 2, 0.0f);
+	IM_CHECK(engine.countCP == 4);
+	bool crossed = engine.paste(true, 1, 8, 0.0f, 16);
+	IM_CHECK(!crossed);
+	for (int i = 0; i < 4; i++) {
+		IM_CHECK(engine.cv[1][8 + i] == cvBefore[2 + i]);
+		IM_CHECK(engine.attributes[1][8 + i].getAttribute() == attributesBefore[2 + i]);
+	}
+
+	// copy all of the song, paste is not crossed
+	engine.phrase[3] = 5;
+	engine.copy(false, 0, 0, 2.0f);
+	engine.phrase[3] = 0;
+	crossed = engine.paste(false, 0, 0, 2.0f, 16);
+	IM_CHECK(!crossed);
+	IM_CHECK(engine.phrase[3] == 5);
+
+	// tied steps carry the CV of the step before them
+	engine.cv[2][4] = 1.0f;
+	engine.cv[2][5] = -1.0f;
+	engine.activateTiedStep(2, 5);
+	IM_CHECK(engine.attributes[2][5].getTied());
+	IM_CHECK(engine.cv[2][5] == 1.0f);
+	engine.cv[2][4] = 2.0f;
+	engine.propagateCVtoTied(2, 4);
+	IM_CHECK(engine.cv[2][5] == 2.0f);
+	engine.deactivateTiedStep(2, 5);
+	IM_CHECK(!engine.attributes[2][5].getTied());
+}
+
+
+// Json: what engineToJson() writes is read back identically, through text
+IM_TEST(phraseSeqEngineJson) {
+	random::seed(0x1111, 0x2222);
+	EnginePS16 engine;
+	initEngine(engine);
+	randomizeSong(engine, 16);
+
+	json_t *rootJ = json_object();
+	engine.engineToJson(rootJ);
+	char *text = json_dumps(rootJ, JSON_INDENT(2) | JSON_REAL_PRECISION(9));
+	json_decref(rootJ);
+	json_error_t error;
+	json_t *loadedJ = json_loads(text, 0, &error);
+	std::free(text);
+	IM_CHECK(loadedJ != NULL);
+
+	EnginePS16 loaded;
+	initEngine(loaded);
+	IM_CHECK(loaded.engineFromJson(loadedJ));
+	json_decref(loadedJ);
+	for (int i = 0; i < 16; i++) {
+		IM_CHECK(loaded.phrase[i] == engine.phrase[i]);
+		for (int s = 0; s < 16; s++) {
+			IM_CHECK(loaded.cv[i][s] == engine.cv[i][s]);
+			IM_CHECK(loaded.attributes[i][s].getAttribute() == engine.attributes[i][s].getAttribute());
+		}
+	}
+
+	// a patch without attributes asks for the legacy loading
+	json_t *legacyJ = json_object();
+	IM_CHECK(!loaded.engineFromJson(legacyJ));
+	json_decref(legacyJ);
+}
+
+
+// Run modes: the traversal of each deterministic run mode over two periods, from a reset
+IM_TEST(runModes) {
+	static const int runModes[] = {MODE_FWD, MODE_REV, MODE_PPG, MODE_PEN, MODE_FW2, MODE_FW3, MODE_FW4};
+	std::string text;
+	for (int runMode : runModes) {
+		for (int numSteps = 1; numSteps <= 5; numSteps++) {
+			int index = (runMode == MODE_REV ? numSteps - 1 : 0);
+			unsigned long history = 0;
+			text += string::f("%s %d:", modeLabels[runMode].c_str(), numSteps);
+			int numBoundaries = 0;
+			for (int move = 0; move < 100 && numBoundaries < 2; move++) {
+				bool crossBoundary = moveIndexRunMode(&index, numSteps, runMode, &history);
+				text += string::f(" %d%s", index, crossBoundary ? "|" : "");
+				if (crossBoundary)
+					numBoundaries++;
+			}
+			text += "\n";
+		}
+	}
+	imCheckGolden("runModes", text);
+
+	// random run modes stay in range and cross a boundary every numSteps moves
+	random::seed(0x3333, 0x4444);
+	static const int randomModes[] = {MODE_BRN, MODE_RND, MODE_RN2};
+	for (int runMode : randomModes) {
+		int index = 0;
+		unsigned long history = 0;
+		int numBoundaries = 0;
+		for (int move = 1; move <= 7 * 10; move++) {
+			bool crossBoundary = moveIndexRunMode(&index, 7, runMode, &history);
+			IM_CHECK(index >= 0 && index < 7);
+			if (crossBoundary) {
+				IM_CHECK(move % 7 == 0);
+				numBoundaries++;
+			}
+		}
+		IM_CHECK(numBoundaries == 10);
+	}
+}
+
+
+// Cost of the engine's per-step and per-pulse work, as run by PhraseSeq16/SemiModularSynth and PhraseSeq32, 
+//   on a random song (sequence lengths, run modes and step attributes)
+template <typename ENGINE>
+static void benchEngine(const char *moveWhat, const char *gateWhat) {
+	static const int numMoves = 1 << 20;
+	static const int pulsesPerStep = 12;
+	random::seed(0x7777, 0x8888);
+	ENGINE engine;
+	engine.holdTiedNotes = true;
+	engine.running = true;
+	engine.runModeSong = MODE_FWD;
+	engine.stopAtEndOfSong = false;
+	engine.preRollProb = false;
+	engine.initSequences(ENGINE::NUM_STEPS);
+	engine.initCopyPaste();
+	engine.phrases = ENGINE::NUM_SEQS;
+	for (int seqn = 0; seqn < ENGINE::NUM_SEQS; seqn++) {
+		engine.randomizeSequence(seqn, ENGINE::NUM_STEPS);
+		engine.phrase[seqn] = seqn;
+		for (int s = 0; s < ENGINE::NUM_STEPS; s++) {// see randomizeSong()
+			engine.attributes[seqn][s].setGate1Mode(engine.attributes[seqn][s].getGate1Mode() % NUM_GATES);
+			engine.attributes[seqn][s].setGate2Mode(engine.attributes[seqn][s].getGate2Mode() % NUM_GATES);
+		}
+	}
+	
+	int stepIndexRun = 0;
+	int seqn = engine.initRunIndexes(false, 0, &stepIndexRun);
+	int sum = 0;
+	ImStopwatch stopwatch;
+	for (int i = 0; i < numMoves; i++) {
+		seqn = engine.moveRunIndexes(false, 0, &stepIndexRun);
+		sum += seqn + stepIndexRun;
+	}
+	imReportBench(moveWhat, stopwatch.nanos() / numMoves);
+	
+	stopwatch = ImStopwatch();
+	for (int i = 0; i < numMoves / pulsesPerStep; i++) {
+		seqn = engine.moveRunIndexes(false, 0, &stepIndexRun);
+		StepAttributes attribute = engine.attributes[seqn][stepIndexRun];
+		for (int ppqnCount = 0; ppqnCount < pulsesPerStep; ppqnCount++) {
+			sum += calcGate1Code(attribute, ppqnCount, pulsesPerStep, 0.5f) + calcGate2Code(attribute, ppqnCount, pulsesPerStep);
+		}
+	}
+	imReportBench(gateWhat, stopwatch.nanos() / (numMoves / pulsesPerStep * pulsesPerStep));
+	IM_CHECK(sum != 0);
+}
+
+IM_BENCH(phraseSeqEngine) {
+	benchEngine<EnginePS16>("PhraseSeq16 moveRunIndexes(), per step", "PhraseSeq16 calcGate1Code() + calcGate2Code(), per pulse");
+	benchEngine<PhraseSeqEngine<32, 32, NUM_MODES> >("PhraseSeq32 moveRunIndexes(), per step", "PhraseSeq32 calcGate1Code() + calcGate2Code(), per pulse");
+}
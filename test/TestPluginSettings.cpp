@@ -0,0 +1,48 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Checks of the plugin-wide settings in ImpromptuModular.cpp
+//***********************************************************************************************
+
+
+#include "ImTest.hpp"
+#include "ImpromptuModular.hpp"
+
+
+static bool fileExists(const std::string &filename) {
+	FILE *file = std::fopen(filename.c_str(), "r");
+	if (file)
+		std::fclose(file);
+	return file != NULL;
+}
+
+
+// Loading keeps the defaults in memory without writing the file, only a change by the user writes it
+IM_TEST(pluginSettingsLoadSave) {
+	std::string settingsFilename = asset::user("ImpromptuModular.json");
+	std::remove(settingsFilename.c_str());
+
+	PluginSettings settings;
+	settings.load();
+	IM_CHECK(!settings.darkAsDefault);
+	IM_CHECK(!fileExists(settingsFilename));
+
+	// invalid file is left as is
+	FILE *file = std::fopen(settingsFilename.c_str(), "w");
+	std::fputs("{\"darkAsDefault\": ", file);
+	std::fclose(file);
+	settings.load();
+	IM_CHECK(!settings.darkAsDefault);
+	file = std::fopen(settingsFilename.c_str(), "r");
+	json_error_t error;
+	IM_CHECK(json_loadf(file, 0, &error) == NULL);
+	std::fclose(file);
+
+	settings.darkAsDefault = true;
+	settings.save();
+	PluginSettings loaded;
+	loaded.load();
+	IM_CHECK(loaded.darkAsDefault);
+
+	std::remove(settingsFilename.c_str());
+}
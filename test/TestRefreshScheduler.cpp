@@ -0,0 +1,41 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Checks of the slots given to the refresh counters by RefreshScheduler in ImpromptuModular.hpp
+//***********************************************************************************************
+
+
+#include "ImTest.hpp"
+#include "ImpromptuModular.hpp"
+
+
+// Returns true when the counts differ by at most 1
+static bool isEven(const int *counts, int numCounts) {
+	int minCount = counts[0];
+	int maxCount = counts[0];
+	for (int i = 1; i < numCounts; i++) {
+		minCount = std::min(minCount, counts[i]);
+		maxCount = std::max(maxCount, counts[i]);
+	}
+	return maxCount - minCount <= 1;
+}
+
+
+// After any number of acquires, the slot loads and the input refresh phases (slot % 16) are within 1 of each other
+IM_TEST(refreshSchedulerSpread) {
+	RefreshScheduler scheduler;
+	int phases[16] = {};
+	int loads[RefreshScheduler::NUM_SLOTS];
+	for (int n = 1; n <= 3 * RefreshScheduler::NUM_SLOTS; n++) {
+		phases[scheduler.acquire() & RefreshCounter::userInputsStepSkipMask]++;
+		for (int i = 0; i < RefreshScheduler::NUM_SLOTS; i++)
+			loads[i] = scheduler.getLoad(i);
+		IM_CHECK_MSG(isEven(loads, RefreshScheduler::NUM_SLOTS), string::f("loads after %d acquires", n));
+		IM_CHECK_MSG(isEven(phases, 16), string::f("input phases after %d acquires", n));
+	}
+	
+	// a released slot is the next one given
+	scheduler.release(37);
+	IM_CHECK(scheduler.getLoad(37) == 2);
+	IM_CHECK(scheduler.acquire() == 37);
+}
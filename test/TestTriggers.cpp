@@ -0,0 +1,65 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Checks of the triggers in ImpromptuModular.hpp
+//***********************************************************************************************
+
+
+#include "ImTest.hpp"
+#include "ImpromptuModular.hpp"
+
+
+// Input values around the trigger thresholds (0.1V and 1.0V), with the occasional large or negative value
+static float randomTriggerInput() {
+	static const float levels[] = {-1.0f, 0.0f, 0.05f, 0.1f, 0.11f, 0.5f, 0.99f, 1.0f, 1.01f, 10.0f};
+	return levels[random::u32() % 10];
+}
+
+
+// TriggerBank has the same edges as a Trigger per input
+template <int N>
+static void checkTriggerBank(int numSamples) {
+	TriggerBank<N> bank;
+	Trigger triggers[N];
+	float in[TriggerBank<N>::NUM_PADDED] = {};
+	int numEdges = 0;
+	int numMismatches = 0;
+	for (int i = 0; i < numSamples; i++) {
+		for (int n = 0; n < N; n++)
+			in[n] = randomTriggerInput();
+		uint64_t edges = bank.process(in);
+		for (int n = 0; n < N; n++) {
+			bool edge = triggers[n].process(in[n]);
+			if (edge != (((edges >> n) & 0x1) != 0) || triggers[n].state != (((bank.state >> n) & 0x1) != 0))
+				numMismatches++;
+			if (edge)
+				numEdges++;
+		}
+		IM_CHECK(N == 64 || (edges >> (N % 64)) == 0);// padding never triggers
+	}
+	IM_CHECK_MSG(numMismatches == 0, string::f("%d mismatches for N = %d", numMismatches, N));
+	IM_CHECK(numEdges > numSamples / 10);// the inputs did exercise the edges
+}
+
+IM_TEST(triggerBankVsTrigger) {
+	random::seed(0x5555, 0x6666);
+	checkTriggerBank<1>(20000);
+	checkTriggerBank<7>(20000);
+	checkTriggerBank<8>(20000);
+	checkTriggerBank<16>(10000);
+	checkTriggerBank<64>(5000);
+}
+
+
+// The param overload reads params firstId to firstId + N - 1
+IM_TEST(triggerBankParams) {
+	std::vector<Param> params(12);
+	TriggerBank<7> bank;
+	bank.process(params, 3);// all low
+	params[3 + 2].setValue(1.0f);
+	params[3 + 6].setValue(1.0f);
+	params[2].setValue(1.0f);// outside of the bank
+	params[10].setValue(1.0f);// outside of the bank
+	IM_CHECK(bank.process(params, 3) == ((0x1 << 2) | (0x1 << 6)));
+	IM_CHECK(bank.process(params, 3) == 0);// held
+}
@@ -0,0 +1,165 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Checks of the shared widgets in ImpromptuModular.hpp and comp/
+//***********************************************************************************************
+
+
+#include "ImTest.hpp"
+#include "ImpromptuModular.hpp"
+
+
+// CachedDisplayWidget
+
+struct TestDisplayWidget : CachedDisplayWidget {
+	int value = 0;
+	char overlayChar = 0;
+	int numDraws = 0;
+	
+	void printState(DisplayState &state) override {
+		char displayStr[4];
+		snprintf(displayStr, 4, "%3d", value);
+		state += displayStr;
+		state += overlayChar;
+	}
+	void drawDisplay(const DrawArgs &args) override {
+		numDraws++;
+	}
+	void frame() {// step, then the draw that Rack does for a dirty framebuffer
+		step();
+		if (dirty) {
+			drawDisplay(DrawArgs());
+			dirty = false;
+		}
+	}
+};
+
+IM_TEST(cachedDisplay) {
+	TestDisplayWidget display;
+	display.frame();
+	IM_CHECK(display.numDraws == 1);
+	for (int i = 0; i < 10; i++)
+		display.frame();
+	IM_CHECK(display.numDraws == 1);// unchanged
+	display.value = 12;
+	display.frame();
+	display.frame();
+	IM_CHECK(display.numDraws == 2);
+	display.overlayChar = '.';// a char is part of the state, including when it is 0
+	display.frame();
+	IM_CHECK(display.numDraws == 3);
+	display.overlayChar = 0;
+	display.frame();
+	IM_CHECK(display.numDraws == 4);
+	
+	// long states are truncated to the buffer
+	DisplayState state;
+	for (int i = 0; i < 100; i++)
+		state += "abc";
+	IM_CHECK(state.length == DisplayState::CAPACITY);
+	DisplayState other = state;
+	IM_CHECK(other == state);
+	other.text[5] = 'x';
+	IM_CHECK(!(other == state));
+}
+
+
+// Dark panels (DynamicSVGPanel): loaded the first time they are shown
+
+static const char *panelNames[] = {"BigButtonSeq", "BigButtonSeq2", "Clocked", "Foundry", "FourView", "GateSeq64", "PhraseSeq16", 
+	"PhraseSeq32", "SemiModular", "Tact", "Tact1", "TwelveKey", "WriteSeq32", "WriteSeq64"};
+static const int numPanelNames = sizeof(panelNames) / sizeof(panelNames[0]);
+
+struct TestPanelWidget : Widget {
+	// the panels and screws of a module widget, as built in the module widget constructors
+	int panelTheme;
+	
+	TestPanelWidget(const char *name, int _panelTheme, bool eagerDark) {
+		panelTheme = _panelTheme;
+		SvgPanel *panel = new SvgPanel();
+		panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, string::f("res/light/%s.svg", name))));
+		addChild(panel);
+		DynamicSVGPanel *darkPanel = new DynamicSVGPanel();
+		std::string darkName = asset::plugin(pluginInstance, string::f("res/dark/%s_dark.svg", name));
+		if (eagerDark)// as before the dark panels were loaded on first display
+			darkPanel->setBackground(APP->window->loadSvg(darkName));
+		else
+			darkPanel->addFrameAlt(darkName);
+		darkPanel->mode = &panelTheme;
+		darkPanel->lightPanel = panel;
+		darkPanel->visible = false;
+		addChild(darkPanel);
+		for (int i = 0; i < 4; i++)
+			addChild(createDynamicWidget<IMScrew>(Vec(15 * i, 0), &panelTheme));
+	}
+};
+
+// Loads a patch of numModules modules (all panel types, every darkEvery-th module dark when darkEvery > 0), 
+//   with an empty svg cache, and shows it for one frame; returns the number of svg files read
+static int loadPatch(std::vector<TestPanelWidget*> &widgets, int numModules, int darkEvery, bool eagerDark, double *nanos) {
+	APP->window->svgCache.clear();
+	APP->window->numSvgLoads = 0;
+	ImStopwatch stopwatch;
+	for (int i = 0; i < numModules; i++) {
+		int panelTheme = (darkEvery > 0 && i % darkEvery == 0) ? 1 : 0;
+		widgets.push_back(new TestPanelWidget(panelNames[i % numPanelNames], panelTheme, eagerDark));
+	}
+	for (TestPanelWidget *widget : widgets)
+		widget->step();
+	*nanos = stopwatch.nanos();
+	return APP->window->numSvgLoads;
+}
+
+static void deletePatch(std::vector<TestPanelWidget*> &widgets) {
+	for (TestPanelWidget *widget : widgets)
+		delete widget;
+	widgets.clear();
+}
+
+IM_TEST(lazyDarkPanels) {
+	std::vector<TestPanelWidget*> widgets;
+	double nanos;
+	
+	// all light: only the light panels and the light screw are read
+	int numLoads = loadPatch(widgets, 100, 0, false, &nanos);
+	IM_CHECK_MSG(numLoads == numPanelNames + 1, string::f("%d loads", numLoads));
+	
+	// switching one module to dark reads its dark panel and the dark screw once, a second module of the same type reads nothing
+	widgets[0]->panelTheme = 1;
+	widgets[0]->step();
+	IM_CHECK(APP->window->numSvgLoads == numLoads + 2);
+	widgets[numPanelNames]->panelTheme = 1;
+	widgets[numPanelNames]->step();
+	IM_CHECK(APP->window->numSvgLoads == numLoads + 2);
+	IM_CHECK(widgets[numPanelNames]->children[1]->visible && !widgets[numPanelNames]->children[0]->visible);
+	IM_CHECK(((IMScrew*)widgets[numPanelNames]->children[2])->oldMode == 1);// the dark panel applied the mode to the screws
+	IM_CHECK(((IMScrew*)widgets[numPanelNames + 1]->children[2])->oldMode == 0);
+	
+	// back to light: the light panel is shown again, and nothing is read
+	widgets[0]->panelTheme = 0;
+	widgets[0]->step();
+	IM_CHECK(!widgets[0]->children[1]->visible && widgets[0]->children[0]->visible);
+	IM_CHECK(((IMScrew*)widgets[0]->children[5])->oldMode == 0);
+	IM_CHECK(APP->window->numSvgLoads == numLoads + 2);
+	deletePatch(widgets);
+	
+	// a patch saved with dark modules reads their panels on its first frame
+	numLoads = loadPatch(widgets, 100, 2, false, &nanos);
+	IM_CHECK_MSG(numLoads == numPanelNames + numPanelNames / 2 + 2, string::f("%d loads", numLoads));
+	deletePatch(widgets);
+}
+
+IM_BENCH(lazyDarkPanelsLoad) {
+	// patch load time per module for 100 modules, svg files read from disk (Rack also parses them, which is not timed here)
+	std::vector<TestPanelWidget*> widgets;
+	double nanos;
+	int numLoads = loadPatch(widgets, 100, 0, true, &nanos);
+	deletePatch(widgets);
+	imReportBench(string::f("Light patch, eager dark panels (%d svg reads)", numLoads).c_str(), nanos / 100);
+	numLoads = loadPatch(widgets, 100, 0, false, &nanos);
+	deletePatch(widgets);
+	imReportBench(string::f("Light patch, lazy dark panels (%d svg reads)", numLoads).c_str(), nanos / 100);
+	numLoads = loadPatch(widgets, 100, 2, false, &nanos);
+	deletePatch(widgets);
+	imReportBench(string::f("Half dark patch, lazy dark panels (%d svg reads)", numLoads).c_str(), nanos / 100);
+}
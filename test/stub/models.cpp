@@ -0,0 +1,24 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Models of the modules that are not built headless (see test/Makefile), null since they are only referenced by init() in
+//ImpromptuModular.cpp and by the expander checks of the modules that are built
+//***********************************************************************************************
+
+
+#include "ImpromptuModular.hpp"
+
+
+Model *modelTact = NULL;
+Model *modelTact1 = NULL;
+Model *modelTwelveKey = NULL;
+Model *modelClockedExpander = NULL;
+Model *modelFoundryExpander = NULL;
+Model *modelGateSeq64Expander = NULL;
+Model *modelPhraseSeqExpander = NULL;
+Model *modelWriteSeq32 = NULL;
+Model *modelWriteSeq64 = NULL;
+Model *modelBigButtonSeq = NULL;
+Model *modelBigButtonSeq2 = NULL;
+Model *modelFourView = NULL;
+Model *modelBlankPanel = NULL;
@@ -0,0 +1,433 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Headless stand-in for the Rack v1 runtime, see rack.hpp
+//***********************************************************************************************
+
+
+#include "rack.hpp"
+
+
+// Json
+
+static json_t *jsonNew(json_type type) {
+	json_t *json = new json_t;
+	json->type = type;
+	return json;
+}
+
+json_t *json_object() {return jsonNew(JSON_OBJECT);}
+json_t *json_array() {return jsonNew(JSON_ARRAY);}
+json_t *json_true() {return jsonNew(JSON_TRUE);}
+json_t *json_false() {return jsonNew(JSON_FALSE);}
+json_t *json_null() {return jsonNew(JSON_NULL);}
+json_t *json_boolean(bool value) {return jsonNew(value ? JSON_TRUE : JSON_FALSE);}
+
+json_t *json_string(const char *value) {
+	json_t *json = jsonNew(JSON_STRING);
+	json->str = value;
+	return json;
+}
+
+json_t *json_integer(long long value) {
+	json_t *json = jsonNew(JSON_INTEGER);
+	json->integer = value;
+	return json;
+}
+
+json_t *json_real(double value) {
+	json_t *json = jsonNew(JSON_REAL);
+	json->real = value;
+	return json;
+}
+
+json_t *json_incref(json_t *json) {
+	if (json)
+		json->refcount++;
+	return json;
+}
+
+void json_decref(json_t *json) {
+	if (!json || --json->refcount > 0)
+		return;
+	for (auto &member : json->members)
+		json_decref(member.second);
+	for (json_t *element : json->elements)
+		json_decref(element);
+	delete json;
+}
+
+int json_object_set_new(json_t *object, const char *key, json_t *value) {
+	if (!object || object->type != JSON_OBJECT || !value) {
+		json_decref(value);
+		return -1;
+	}
+	for (auto &member : object->members) {
+		if (member.first == key) {
+			json_decref(member.second);
+			member.second = value;
+			return 0;
+		}
+	}
+	object->members.push_back(std::make_pair(std::string(key), value));
+	return 0;
+}
+
+json_t *json_object_get(const json_t *object, const char *key) {
+	if (!object || object->type != JSON_OBJECT)
+		return NULL;
+	for (const auto &member : object->members) {
+		if (member.first == key)
+			return member.second;
+	}
+	return NULL;
+}
+
+int json_array_append_new(json_t *array, json_t *value) {
+	return json_array_insert_new(array, json_array_size(array), value);
+}
+
+int json_array_insert_new(json_t *array, size_t index, json_t *value) {
+	if (!array || array->type != JSON_ARRAY || !value || index > array->elements.size()) {
+		json_decref(value);
+		return -1;
+	}
+	array->elements.insert(array->elements.begin() + index, value);
+	return 0;
+}
+
+json_t *json_array_get(const json_t *array, size_t index) {
+	if (!array || array->type != JSON_ARRAY || index >= array->elements.size())
+		return NULL;
+	return array->elements[index];
+}
+
+size_t json_array_size(const json_t *array) {
+	return (array && array->type == JSON_ARRAY) ? array->elements.size() : 0;
+}
+
+long long json_integer_value(const json_t *json) {
+	return (json && json->type == JSON_INTEGER) ? json->integer : 0;
+}
+
+double json_real_value(const json_t *json) {
+	return (json && json->type == JSON_REAL) ? json->real : 0.0;
+}
+
+double json_number_value(const json_t *json) {
+	if (json && json->type == JSON_INTEGER)
+		return (double)json->integer;
+	return json_real_value(json);
+}
+
+bool json_is_true(const json_t *json) {
+	return json && json->type == JSON_TRUE;
+}
+
+bool json_boolean_value(const json_t *json) {
+	return json_is_true(json);
+}
+
+const char *json_string_value(const json_t *json) {
+	return (json && json->type == JSON_STRING) ? json->str.c_str() : NULL;
+}
+
+
+static void jsonDump(const json_t *json, std::string &out, int indent, int depth, int precision) {
+	std::string newline = (indent > 0 ? "\n" + std::string((depth + 1) * indent, ' ') : "");
+	std::string closeline = (indent > 0 ? "\n" + std::string(depth * indent, ' ') : "");
+	switch (json->type) {
+		case JSON_OBJECT :
+			out += "{";
+			for (size_t i = 0; i < json->members.size(); i++) {
+				out += (i > 0 ? "," : "") + newline + "\"" + json->members[i].first + "\": ";
+				jsonDump(json->members[i].second, out, indent, depth + 1, precision);
+			}
+			out += (json->members.empty() ? "" : closeline) + "}";
+		break;
+		case JSON_ARRAY :
+			out += "[";
+			for (size_t i = 0; i < json->elements.size(); i++) {
+				out += (i > 0 ? "," : "") + newline;
+				jsonDump(json->elements[i], out, indent, depth + 1, precision);
+			}
+			out += (json->elements.empty() ? "" : closeline) + "]";
+		break;
+		case JSON_STRING :
+			out += "\"" + json->str + "\"";
+		break;
+		case JSON_INTEGER :
+			out += rack::string::f("%lld", json->integer);
+		break;
+		case JSON_REAL : {
+			std::string real = rack::string::f("%.*g", precision, json->real);
+			if (real.find_first_of(".eEn") == std::string::npos)
+				real += ".0";
+			out += real;
+		} break;
+		case JSON_TRUE :
+			out += "true";
+		break;
+		case JSON_FALSE :
+			out += "false";
+		break;
+		default :
+			out += "null";
+	}
+}
+
+char *json_dumps(const json_t *json, size_t flags) {
+	if (!json)
+		return NULL;
+	int precision = (int)((flags >> 11) & 0x1F);
+	std::string out;
+	jsonDump(json, out, (int)(flags & 0x1F), 0, precision == 0 ? 17 : precision);
+	return strdup(out.c_str());
+}
+
+int json_dumpf(const json_t *json, FILE *output, size_t flags) {
+	char *out = json_dumps(json, flags);
+	if (!out)
+		return -1;
+	int ret = (std::fputs(out, output) < 0 ? -1 : 0);
+	std::free(out);
+	return ret;
+}
+
+
+struct JsonParser {
+	const char *p;
+
+	void skipSpace() {
+		while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+			p++;
+	}
+
+	json_t *parse() {
+		skipSpace();
+		if (*p == '{') {
+			p++;
+			json_t *object = json_object();
+			skipSpace();
+			if (*p == '}') {
+				p++;
+				return object;
+			}
+			while (true) {
+				skipSpace();
+				json_t *key = (*p == '"' ? parse() : NULL);
+				skipSpace();
+				if (!key || *p != ':') {
+					json_decref(key);
+					json_decref(object);
+					return NULL;
+				}
+				p++;
+				json_t *value = parse();
+				if (!value) {
+					json_decref(key);
+					json_decref(object);
+					return NULL;
+				}
+				json_object_set_new(object, key->str.c_str(), value);
+				json_decref(key);
+				skipSpace();
+				if (*p == ',') {
+					p++;
+					continue;
+				}
+				if (*p == '}') {
+					p++;
+					return object;
+				}
+				json_decref(object);
+				return NULL;
+			}
+		}
+		if (*p == '[') {
+			p++;
+			json_t *array = json_array();
+			skipSpace();
+			if (*p == ']') {
+				p++;
+				return array;
+			}
+			while (true) {
+				json_t *value = parse();
+				if (!value) {
+					json_decref(array);
+					return NULL;
+				}
+				json_array_append_new(array, value);
+				skipSpace();
+				if (*p == ',') {
+					p++;
+					continue;
+				}
+				if (*p == ']') {
+					p++;
+					return array;
+				}
+				json_decref(array);
+				return NULL;
+			}
+		}
+		if (*p == '"') {// no escapes, which the plugin does not write
+			const char *end = std::strchr(p + 1, '"');
+			if (!end)
+				return NULL;
+			json_t *str = json_string(std::string(p + 1, end).c_str());
+			p = end + 1;
+			return str;
+		}
+		if (std::strncmp(p, "true", 4) == 0) {
+			p += 4;
+			return json_true();
+		}
+		if (std::strncmp(p, "false", 5) == 0) {
+			p += 5;
+			return json_false();
+		}
+		if (std::strncmp(p, "null", 4) == 0) {
+			p += 4;
+			return json_null();
+		}
+		const char *start = p;
+		char *end;
+		double real = std::strtod(start, &end);
+		if (end == start)
+			return NULL;
+		p = end;
+		std::string number(start, (const char*)end);
+		if (number.find_first_of(".eE") == std::string::npos)
+			return json_integer(std::strtoll(start, NULL, 10));
+		return json_real(real);
+	}
+};
+
+json_t *json_loads(const char *input, size_t flags, json_error_t *error) {
+	JsonParser parser;
+	parser.p = input;
+	json_t *json = parser.parse();
+	if (json) {
+		parser.skipSpace();
+		if (*parser.p != 0) {
+			json_decref(json);
+			json = NULL;
+		}
+	}
+	if (!json && error) {
+		error->line = 0;
+		std::snprintf(error->text, sizeof(error->text), "invalid json");
+	}
+	return json;
+}
+
+json_t *json_loadf(FILE *input, size_t flags, json_error_t *error) {
+	std::string text;
+	char buf[4096];
+	size_t n;
+	while ((n = std::fread(buf, 1, sizeof(buf), input)) > 0)
+		text.append(buf, n);
+	return json_loads(text.c_str(), flags, error);
+}
+
+
+namespace rack {
+
+
+// Random
+
+namespace random {
+
+static uint64_t xoroshiroState[2] = {0x9E3779B97F4A7C15ull, 0xBF58476D1CE4E5B9ull};
+
+void seed(uint64_t s0, uint64_t s1) {
+	xoroshiroState[0] = s0;
+	xoroshiroState[1] = s1 | 0x1;// state must not be all zeros
+}
+
+uint64_t u64() {
+	uint64_t s0 = xoroshiroState[0];
+	uint64_t s1 = xoroshiroState[1] ^ s0;
+	xoroshiroState[0] = ((s0 << 55) | (s0 >> 9)) ^ s1 ^ (s1 << 14);
+	xoroshiroState[1] = (s1 << 36) | (s1 >> 28);
+	return xoroshiroState[0] + xoroshiroState[1];
+}
+
+uint32_t u32() {
+	return (uint32_t)(u64() >> 32);
+}
+
+float uniform() {
+	return (u32() >> 8) * (1.0f / 16777216.0f);// [0.0, 1.0) as in Rack
+}
+
+float normal() {// Box-Muller
+	float u = std::max(uniform(), 1e-12f);
+	return std::sqrt(-2.0f * std::log(u)) * std::cos(2.0f * (float)M_PI * uniform());
+}
+
+}// namespace random
+
+
+// Assets
+
+namespace asset {
+
+#ifndef IM_TEST_PLUGIN_DIR
+#define IM_TEST_PLUGIN_DIR "."
+#endif
+#ifndef IM_TEST_USER_DIR
+#define IM_TEST_USER_DIR "."
+#endif
+
+std::string plugin(Plugin *plugin, std::string filename) {
+	return std::string(IM_TEST_PLUGIN_DIR) + "/" + filename;
+}
+
+std::string system(std::string filename) {// Rack's own resources are not available headless
+	return "rack-system/" + filename;
+}
+
+std::string user(std::string filename) {
+	return std::string(IM_TEST_USER_DIR) + "/" + filename;
+}
+
+}// namespace asset
+
+
+// App
+
+std::shared_ptr<Svg> Window::loadSvg(const std::string &filename) {
+	auto it = svgCache.find(filename);
+	if (it != svgCache.end())
+		return it->second;
+	std::shared_ptr<Svg> svg = std::make_shared<Svg>();
+	svg->path = filename;
+	FILE *file = std::fopen(filename.c_str(), "rb");
+	if (file) {// read the file as Rack does before parsing it
+		char buf[4096];
+		size_t n;
+		while ((n = std::fread(buf, 1, sizeof(buf), file)) > 0)
+			svg->size += n;
+		std::fclose(file);
+	}
+	numSvgLoads++;
+	svgCache[filename] = svg;
+	return svg;
+}
+
+App *appGet() {
+	static Engine engine;
+	static Window window;
+	static RackWidget rackWidget;
+	static Scene scene;
+	static history::State historyState;
+	static App app = {&engine, &window, &scene, &historyState};
+	scene.rack = &rackWidget;
+	return &app;
+}
+
+
+}// namespace rack
@@ -0,0 +1,956 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Headless stand-in for the parts of the Rack v1 API used by the sources built in the test harness
+//  (see test/Makefile). Engine, dsp and simd objects behave as in Rack; widgets, menus and the app
+//  only hold their state, except Window::loadSvg() which reads and counts the svg files it loads.
+//***********************************************************************************************
+
+#ifndef IM_TEST_RACK_STUB_HPP
+#define IM_TEST_RACK_STUB_HPP
+
+
+#include <cassert>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <xmmintrin.h>
+
+
+#define WARN(format, ...) std::fprintf(stderr, "[warn] " format "\n", ##__VA_ARGS__)
+#define INFO(format, ...) std::fprintf(stderr, "[info] " format "\n", ##__VA_ARGS__)
+
+#define ENUMS(name, count) name, name ## _LAST = name + (count) - 1
+
+
+// GLFW (input constants only)
+
+#define GLFW_RELEASE 0
+#define GLFW_PRESS 1
+#define GLFW_REPEAT 2
+#define GLFW_MOUSE_BUTTON_LEFT 0
+#define GLFW_MOUSE_BUTTON_RIGHT 1
+#define GLFW_MOD_SHIFT 0x0001
+#define GLFW_MOD_CONTROL 0x0002
+#define GLFW_MOD_ALT 0x0004
+#define GLFW_MOD_SUPER 0x0008
+#define GLFW_KEY_SPACE 32
+
+#define RACK_MOD_CTRL GLFW_MOD_CONTROL
+#define RACK_MOD_MASK (GLFW_MOD_SHIFT | GLFW_MOD_CONTROL | GLFW_MOD_ALT | GLFW_MOD_SUPER)
+
+
+// Json (subset of jansson, see stub/rack.cpp)
+
+enum json_type {JSON_OBJECT, JSON_ARRAY, JSON_STRING, JSON_INTEGER, JSON_REAL, JSON_TRUE, JSON_FALSE, JSON_NULL};
+
+struct json_t {
+	json_type type;
+	int refcount = 1;
+	long long integer = 0;
+	double real = 0.0;
+	std::string str;
+	std::vector<std::pair<std::string, json_t*>> members;
+	std::vector<json_t*> elements;
+};
+
+struct json_error_t {
+	int line;
+	char text[160];
+};
+
+#define JSON_INDENT(n) ((n) & 0x1F)
+#define JSON_REAL_PRECISION(n) (((n) & 0x1F) << 11)
+
+json_t *json_object();
+json_t *json_array();
+json_t *json_string(const char *value);
+json_t *json_integer(long long value);
+json_t *json_real(double value);
+json_t *json_boolean(bool value);
+json_t *json_true();
+json_t *json_false();
+json_t *json_null();
+void json_decref(json_t *json);
+json_t *json_incref(json_t *json);
+int json_object_set_new(json_t *object, const char *key, json_t *value);
+json_t *json_object_get(const json_t *object, const char *key);
+int json_array_append_new(json_t *array, json_t *value);
+int json_array_insert_new(json_t *array, size_t index, json_t *value);
+json_t *json_array_get(const json_t *array, size_t index);
+size_t json_array_size(const json_t *array);
+long long json_integer_value(const json_t *json);
+double json_real_value(const json_t *json);
+double json_number_value(const json_t *json);
+bool json_boolean_value(const json_t *json);
+bool json_is_true(const json_t *json);
+const char *json_string_value(const json_t *json);
+char *json_dumps(const json_t *json, size_t flags);
+json_t *json_loads(const char *input, size_t flags, json_error_t *error);
+int json_dumpf(const json_t *json, FILE *output, size_t flags);
+json_t *json_loadf(FILE *input, size_t flags, json_error_t *error);
+
+
+// NanoVG (drawing is not done headless)
+
+struct NVGcontext;
+
+struct NVGcolor {
+	float r, g, b, a;
+};
+
+inline NVGcolor nvgRGBA(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+	NVGcolor color = {r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f};
+	return color;
+}
+inline NVGcolor nvgRGB(unsigned char r, unsigned char g, unsigned char b) {return nvgRGBA(r, g, b, 255);}
+inline NVGcolor nvgRGBf(float r, float g, float b) {
+	NVGcolor color = {r, g, b, 1.0f};
+	return color;
+}
+inline NVGcolor nvgTransRGBA(NVGcolor color, unsigned char a) {
+	color.a = a / 255.0f;
+	return color;
+}
+inline void nvgBeginPath(NVGcontext *vg) {}
+inline void nvgRoundedRect(NVGcontext *vg, float x, float y, float w, float h, float r) {}
+inline void nvgFillColor(NVGcontext *vg, NVGcolor color) {}
+inline void nvgFill(NVGcontext *vg) {}
+inline void nvgStrokeWidth(NVGcontext *vg, float size) {}
+inline void nvgStrokeColor(NVGcontext *vg, NVGcolor color) {}
+inline void nvgStroke(NVGcontext *vg) {}
+inline void nvgFontSize(NVGcontext *vg, float size) {}
+inline void nvgTranslate(NVGcontext *vg, float x, float y) {}
+inline void nvgMoveTo(NVGcontext *vg, float x, float y) {}
+inline void nvgLineTo(NVGcontext *vg, float x, float y) {}
+inline void nvgRect(NVGcontext *vg, float x, float y, float w, float h) {}
+inline void nvgFontFaceId(NVGcontext *vg, int font) {}
+inline void nvgTextLetterSpacing(NVGcontext *vg, float spacing) {}
+inline float nvgText(NVGcontext *vg, float x, float y, const char *string, const char *end) {return x;}
+
+
+namespace rack {
+
+
+// Math
+
+namespace math {
+
+inline int clamp(int x, int a, int b) {return std::max(std::min(x, b), a);}
+inline float clamp(float x, float a, float b) {return std::fmax(std::fmin(x, b), a);}
+inline float rescale(float x, float xMin, float xMax, float yMin, float yMax) {return yMin + (x - xMin) / (xMax - xMin) * (yMax - yMin);}
+inline float crossfade(float a, float b, float p) {return a + (b - a) * p;}
+inline float interpolateLinear(const float *p, float x) {
+	int xi = (int)x;
+	float xf = x - xi;
+	return crossfade(p[xi], p[xi + 1], xf);
+}
+inline int eucMod(int a, int b) {
+	int mod = a % b;
+	if (mod < 0)
+		mod += b;
+	return mod;
+}
+inline float eucMod(float a, float b) {
+	float mod = std::fmod(a, b);
+	if (mod < 0.0f)
+		mod += b;
+	return mod;
+}
+
+struct Vec {
+	float x = 0.0f;
+	float y = 0.0f;
+	Vec() {}
+	Vec(float _x, float _y) : x(_x), y(_y) {}
+	Vec neg() const {return Vec(-x, -y);}
+	Vec plus(Vec b) const {return Vec(x + b.x, y + b.y);}
+	Vec minus(Vec b) const {return Vec(x - b.x, y - b.y);}
+	Vec mult(float s) const {return Vec(x * s, y * s);}
+	Vec mult(Vec b) const {return Vec(x * b.x, y * b.y);}
+	Vec div(float s) const {return Vec(x / s, y / s);}
+	Vec flip() const {return Vec(y, x);}
+};
+
+struct Rect {
+	Vec pos;
+	Vec size;
+	Rect() {}
+	Rect(Vec _pos, Vec _size) : pos(_pos), size(_size) {}
+	Vec getCenter() const {return pos.plus(size.mult(0.5f));}
+};
+
+}// namespace math
+
+using namespace math;
+
+inline Vec mm2px(Vec mm) {return mm.mult(75.0f / 25.4f);}
+
+
+// Random (xoroshiro128+ as in Rack, with a fixed seed so that runs are reproducible)
+
+namespace random {
+
+void seed(uint64_t s0, uint64_t s1);
+uint32_t u32();
+uint64_t u64();
+float uniform();
+float normal();
+
+}// namespace random
+
+
+// String
+
+namespace string {
+
+inline std::string f(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	char buf[1024];
+	std::vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	return buf;
+}
+
+}// namespace string
+
+
+// SIMD (float_4 only)
+
+namespace simd {
+
+struct float_4 {
+	__m128 v;
+	float_4() {}
+	float_4(__m128 _v) : v(_v) {}
+	float_4(float x) : v(_mm_set1_ps(x)) {}
+	static float_4 load(const float *x) {return float_4(_mm_loadu_ps(x));}
+	void store(float *x) {_mm_storeu_ps(x, v);}
+};
+
+inline float_4 operator>=(float_4 a, float_4 b) {return float_4(_mm_cmpge_ps(a.v, b.v));}
+inline float_4 operator<=(float_4 a, float_4 b) {return float_4(_mm_cmple_ps(a.v, b.v));}
+inline int movemask(float_4 a) {return _mm_movemask_ps(a.v);}
+
+}// namespace simd
+
+
+// DSP
+
+namespace dsp {
+
+static const float FREQ_C4 = 261.6256f;
+
+struct SchmittTrigger {
+	bool state = true;
+	void reset() {state = true;}
+	bool process(float in) {
+		if (state) {
+			if (in <= 0.0f)
+				state = false;
+		}
+		else {
+			if (in >= 1.0f) {
+				state = true;
+				return true;
+			}
+		}
+		return false;
+	}
+	bool isHigh() {return state;}
+};
+
+struct BooleanTrigger {
+	bool state = true;
+	void reset() {state = true;}
+	bool process(bool _state) {
+		bool triggered = _state && !state;
+		state = _state;
+		return triggered;
+	}
+};
+
+struct PulseGenerator {
+	float remaining = 0.0f;
+	void reset() {remaining = 0.0f;}
+	bool process(float deltaTime) {
+		if (remaining > 0.0f) {
+			remaining -= deltaTime;
+			return true;
+		}
+		return false;
+	}
+	void trigger(float duration = 1e-3f) {
+		if (duration > remaining)
+			remaining = duration;
+	}
+};
+
+struct RCFilter {
+	float c = 0.0f;
+	float xstate[1] = {};
+	float ystate[1] = {};
+	void setCutoff(float r) {c = 2.0f / r;}
+	void process(float x) {
+		float y = (x + xstate[0] - ystate[0] * (1 - c)) / (1 + c);
+		xstate[0] = x;
+		ystate[0] = y;
+	}
+	float lowpass() {return ystate[0];}
+	float highpass() {return xstate[0] - ystate[0];}
+};
+
+template <int OVERSAMPLE, int QUALITY>
+struct Decimator {// averaging instead of Rack's windowed sinc, which is enough to exercise the oversampled paths
+	float process(float *in) {
+		float sum = 0.0f;
+		for (int i = 0; i < OVERSAMPLE; i++)
+			sum += in[i];
+		return sum / OVERSAMPLE;
+	}
+};
+
+template <typename T, typename F>
+void stepRK4(T t, T dt, T x[], int len, F f) {
+	T k1[len];
+	T k2[len];
+	T k3[len];
+	T k4[len];
+	T yi[len];
+	f(t, x, k1);
+	for (int i = 0; i < len; i++)
+		yi[i] = x[i] + k1[i] * dt / T(2);
+	f(t + dt / T(2), yi, k2);
+	for (int i = 0; i < len; i++)
+		yi[i] = x[i] + k2[i] * dt / T(2);
+	f(t + dt / T(2), yi, k3);
+	for (int i = 0; i < len; i++)
+		yi[i] = x[i] + k3[i] * dt;
+	f(t + dt, yi, k4);
+	for (int i = 0; i < len; i++)
+		x[i] += dt * (k1[i] + T(2) * k2[i] + T(2) * k3[i] + k4[i]) / T(6);
+}
+
+inline float quadraticBipolar(float x) {
+	float x2 = x * x;
+	return (x >= 0.0f) ? x2 : -x2;
+}
+
+}// namespace dsp
+
+
+// Engine
+
+struct Model;
+struct Module;
+
+struct ParamQuantity {
+	Module *module = NULL;
+	int paramId = 0;
+	float minValue = 0.0f;
+	float maxValue = 1.0f;
+	float defaultValue = 0.0f;
+	std::string label;
+	std::string unit;
+	virtual ~ParamQuantity() {}
+	float getValue();
+	void setValue(float value);
+	virtual float getDisplayValue() {return getValue();}
+	virtual std::string getLabel() {return label;}
+};
+
+struct Param {
+	float value = 0.0f;
+	float getValue() {return value;}
+	void setValue(float _value) {value = _value;}
+};
+
+struct Port {
+	float voltages[16] = {};
+	int channels = 0;
+	float getVoltage(int channel = 0) {return voltages[channel];}
+	void setVoltage(float voltage, int channel = 0) {voltages[channel] = voltage;}
+	bool isConnected() {return channels > 0;}
+	void setChannels(int _channels) {channels = (_channels == 0 ? 1 : _channels);}
+	int getChannels() {return channels;}
+};
+struct Input : Port {};
+struct Output : Port {};
+
+struct Light {
+	float value = 0.0f;
+	void setBrightness(float brightness) {value = brightness;}
+	float getBrightness() {return value;}
+	void setSmoothBrightness(float brightness, float deltaTime) {value += (brightness - value) * std::min(deltaTime * 60.0f, 1.0f);}
+};
+
+struct Module {
+	int id = -1;
+	Model *model = NULL;
+	std::vector<Param> params;
+	std::vector<Input> inputs;
+	std::vector<Output> outputs;
+	std::vector<Light> lights;
+	std::vector<ParamQuantity*> paramQuantities;
+
+	struct Expander {
+		int moduleId = -1;
+		Module *module = NULL;
+		void *producerMessage = NULL;
+		void *consumerMessage = NULL;
+		bool messageFlipRequested = false;
+	};
+	Expander leftExpander;
+	Expander rightExpander;
+
+	struct ProcessArgs {
+		float sampleRate;
+		float sampleTime;
+	};
+
+	virtual ~Module() {
+		for (ParamQuantity *paramQuantity : paramQuantities)
+			delete paramQuantity;
+	}
+	void config(int numParams, int numInputs, int numOutputs, int numLights = 0) {
+		params.resize(numParams);
+		inputs.resize(numInputs);
+		outputs.resize(numOutputs);
+		lights.resize(numLights);
+		for (int i = 0; i < numParams; i++) {
+			ParamQuantity *paramQuantity = new ParamQuantity;
+			paramQuantity->module = this;
+			paramQuantity->paramId = i;
+			paramQuantities.push_back(paramQuantity);
+		}
+	}
+	template <class TParamQuantity = ParamQuantity>
+	void configParam(int paramId, float minValue, float maxValue, float defaultValue, std::string label = "", std::string unit = "", 
+			float displayBase = 0.0f, float displayMultiplier = 1.0f, float displayOffset = 0.0f) {
+		delete paramQuantities[paramId];
+		TParamQuantity *paramQuantity = new TParamQuantity;
+		paramQuantity->module = this;
+		paramQuantity->paramId = paramId;
+		paramQuantity->minValue = minValue;
+		paramQuantity->maxValue = maxValue;
+		paramQuantity->defaultValue = defaultValue;
+		paramQuantity->label = label;
+		paramQuantity->unit = unit;
+		paramQuantities[paramId] = paramQuantity;
+		params[paramId].value = defaultValue;
+	}
+	virtual void process(const ProcessArgs &args) {}
+	virtual json_t *dataToJson() {return NULL;}
+	virtual void dataFromJson(json_t *rootJ) {}
+	virtual void onReset() {}
+	virtual void onRandomize() {}
+	virtual void onSampleRateChange() {}
+};
+
+inline float ParamQuantity::getValue() {return module->params[paramId].getValue();}
+inline void ParamQuantity::setValue(float value) {module->params[paramId].setValue(value);}
+
+struct Engine {
+	float sampleRate = 44100.0f;
+	float getSampleRate() {return sampleRate;}
+};
+
+
+// Events
+
+struct Widget;
+
+namespace event {
+struct Base {
+	mutable Widget *target = NULL;
+	void consume(Widget *w) const {target = w;}
+};
+struct PositionBase {
+	Vec pos;
+};
+struct Button : Base, PositionBase {
+	int button = 0;
+	int action = 0;
+	int mods = 0;
+};
+struct DoubleClick : Base {};
+struct HoverKey : Base, PositionBase {
+	int key = 0;
+	int scancode = 0;
+	int action = 0;
+	int mods = 0;
+};
+struct DragBase : Base {
+	int button = 0;
+};
+struct DragStart : DragBase {};
+struct DragEnd : DragBase {};
+struct DragMove : DragBase {
+	Vec mouseDelta;
+};
+struct DragEnter : DragBase {
+	Widget *origin = NULL;
+};
+struct Action : Base {};
+struct Change : Base {};
+}// namespace event
+
+
+// Widgets
+
+static const NVGcolor SCHEME_RED = {0.93f, 0.12f, 0.14f, 1.0f};
+static const NVGcolor SCHEME_ORANGE = {1.0f, 0.71f, 0.13f, 1.0f};
+static const NVGcolor SCHEME_GREEN = {0.56f, 0.75f, 0.25f, 1.0f};
+static const NVGcolor SCHEME_WHITE = {1.0f, 1.0f, 1.0f, 1.0f};
+
+struct Svg {
+	std::string path;
+	size_t size = 0;
+};
+
+struct Font {
+	int handle = 0;
+};
+
+struct Widget {
+	Rect box;
+	Widget *parent = NULL;
+	std::vector<Widget*> children;
+	bool visible = true;
+
+	struct DrawArgs {
+		NVGcontext *vg = NULL;
+		Rect clipBox;
+	};
+
+	virtual ~Widget() {
+		for (Widget *child : children)
+			delete child;
+	}
+	void addChild(Widget *child) {
+		child->parent = this;
+		children.push_back(child);
+	}
+	void removeChild(Widget *child) {
+		children.erase(std::remove(children.begin(), children.end(), child), children.end());
+		child->parent = NULL;
+	}
+	virtual void step() {
+		for (Widget *child : children)
+			child->step();
+	}
+	virtual void draw(const DrawArgs &args) {}
+	virtual void onButton(const event::Button &e) {}
+	virtual void onDoubleClick(const event::DoubleClick &e) {}
+	virtual void onHoverKey(const event::HoverKey &e) {}
+	virtual void onDragStart(const event::DragStart &e) {}
+	virtual void onDragEnd(const event::DragEnd &e) {}
+	virtual void onDragMove(const event::DragMove &e) {}
+	virtual void onDragEnter(const event::DragEnter &e) {}
+	virtual void onChange(const event::Change &e) {}
+};
+
+struct TransparentWidget : Widget {};
+struct OpaqueWidget : Widget {};
+
+struct FramebufferWidget : Widget {
+	bool dirty = true;
+};
+
+struct TransformWidget : Widget {
+	void translate(Vec delta) {}
+	void rotate(float angle) {}
+	void scale(Vec s) {}
+};
+
+struct CircularShadow : TransparentWidget {
+	float blurRadius = 0.0f;
+	float opacity = 0.15f;
+};
+
+struct SvgWidget : Widget {
+	std::shared_ptr<Svg> svg;
+	void setSvg(std::shared_ptr<Svg> _svg) {svg = _svg;}
+};
+
+struct SvgPanel : FramebufferWidget {
+	SvgWidget *sw = NULL;
+	void setBackground(std::shared_ptr<Svg> svg) {
+		if (!sw) {
+			sw = new SvgWidget();
+			addChild(sw);
+		}
+		sw->setSvg(svg);
+		dirty = true;
+	}
+};
+
+namespace ui {
+struct Menu;
+}// namespace ui
+
+namespace app {
+struct ModuleWidget;
+}// namespace app
+
+struct Model {
+	std::string slug;
+	virtual ~Model() {}
+	virtual Module *createModule() {return NULL;}
+	virtual app::ModuleWidget *createModuleWidget() {return NULL;}// with a new module
+};
+
+namespace app {
+
+struct SvgScrew : Widget {
+	FramebufferWidget *fb;
+	SvgWidget *sw;
+	SvgScrew() {
+		fb = new FramebufferWidget();
+		addChild(fb);
+		sw = new SvgWidget();
+		fb->addChild(sw);
+	}
+};
+
+struct ParamWidget : OpaqueWidget {
+	ParamQuantity *paramQuantity = NULL;// owned by the module
+	virtual void randomize() {}
+};
+
+struct PortWidget : OpaqueWidget {
+	Module *module = NULL;
+	int portId = 0;
+	bool isInput = true;
+};
+
+struct SvgPort : PortWidget {
+	FramebufferWidget *fb;
+	CircularShadow *shadow;
+	SvgWidget *sw;
+	SvgPort() {
+		fb = new FramebufferWidget();
+		addChild(fb);
+		shadow = new CircularShadow();
+		fb->addChild(shadow);
+		sw = new SvgWidget();
+		fb->addChild(sw);
+	}
+	void setSvg(std::shared_ptr<Svg> svg) {sw->setSvg(svg);}
+};
+
+struct Switch : ParamWidget {
+	bool momentary = false;
+};
+
+struct SvgSwitch : Switch {
+	FramebufferWidget *fb;
+	CircularShadow *shadow;
+	SvgWidget *sw;
+	std::vector<std::shared_ptr<Svg>> frames;
+	SvgSwitch() {
+		fb = new FramebufferWidget();
+		addChild(fb);
+		shadow = new CircularShadow();
+		fb->addChild(shadow);
+		sw = new SvgWidget();
+		fb->addChild(sw);
+	}
+	void addFrame(std::shared_ptr<Svg> svg) {
+		frames.push_back(svg);
+		if (!sw->svg)
+			sw->setSvg(svg);
+	}
+};
+
+struct Knob : ParamWidget {
+	bool snap = false;
+	float speed = 1.0f;
+};
+
+struct SvgKnob : Knob {
+	FramebufferWidget *fb;
+	CircularShadow *shadow;
+	TransformWidget *tw;
+	SvgWidget *sw;
+	float minAngle = -M_PI;
+	float maxAngle = M_PI;
+	SvgKnob() {
+		fb = new FramebufferWidget();
+		addChild(fb);
+		shadow = new CircularShadow();
+		fb->addChild(shadow);
+		tw = new TransformWidget();
+		fb->addChild(tw);
+		sw = new SvgWidget();
+		tw->addChild(sw);
+	}
+	void setSvg(std::shared_ptr<Svg> svg) {sw->setSvg(svg);}
+};
+
+struct CKSS : SvgSwitch {};
+struct LEDButton : SvgSwitch {};
+struct LEDBezel : SvgSwitch {};
+
+struct ModuleLightWidget : Widget {
+	Module *module = NULL;
+	int firstLightId = 0;
+	std::vector<NVGcolor> baseColors;
+	void addBaseColor(NVGcolor baseColor) {baseColors.push_back(baseColor);}
+};
+struct GrayModuleLightWidget : ModuleLightWidget {};
+struct RedLight : GrayModuleLightWidget {
+	RedLight() {addBaseColor(SCHEME_RED);}
+};
+struct GreenLight : GrayModuleLightWidget {
+	GreenLight() {addBaseColor(SCHEME_GREEN);}
+};
+struct GreenRedLight : GrayModuleLightWidget {
+	GreenRedLight() {
+		addBaseColor(SCHEME_GREEN);
+		addBaseColor(SCHEME_RED);
+	}
+};
+template <typename BASE>
+struct SmallLight : BASE {};
+template <typename BASE>
+struct MediumLight : BASE {};
+
+struct ModuleWidget : OpaqueWidget {
+	Model *model = NULL;
+	Module *module = NULL;
+	Widget *panel = NULL;
+	virtual ~ModuleWidget() {delete module;}
+	void setModule(Module *_module) {module = _module;}
+	void setPanel(std::shared_ptr<Svg> svg) {
+		SvgPanel *svgPanel = new SvgPanel();
+		svgPanel->setBackground(svg);
+		panel = svgPanel;
+		addChild(panel);
+		box.size = Vec(15.0f * 10, 380.0f);
+	}
+	void addParam(ParamWidget *param) {addChild(param);}
+	void addInput(PortWidget *input) {addChild(input);}
+	void addOutput(PortWidget *output) {addChild(output);}
+	virtual void appendContextMenu(ui::Menu *menu) {}
+};
+
+struct RackWidget : Widget {
+	Vec mousePos;
+	void setModulePosNearest(ModuleWidget *mw, Vec pos) {mw->box.pos = pos;}
+	void addModule(ModuleWidget *mw) {addChild(mw);}
+};
+
+struct Scene : Widget {
+	RackWidget *rack = NULL;
+};
+
+}// namespace app
+
+using namespace app;
+
+
+// Menus
+
+namespace ui {
+
+struct Menu : OpaqueWidget {
+	void addChild(Widget *child) {Widget::addChild(child);}
+};
+
+struct MenuLabel : Widget {
+	std::string text;
+};
+
+struct MenuItem : Widget {
+	std::string text;
+	std::string rightText;
+	bool disabled = false;
+	virtual Menu *createChildMenu() {return NULL;}
+	virtual void onAction(const event::Action &e) {}
+};
+
+}// namespace ui
+
+using namespace ui;
+
+#define CHECKMARK_STRING "\u2714"
+#define CHECKMARK(_cond) ((_cond) ? CHECKMARK_STRING : "")
+#define RIGHT_ARROW "\u25B8"
+
+template <class TMenuItem = MenuItem>
+TMenuItem *createMenuItem(std::string text, std::string rightText = "") {
+	TMenuItem *item = new TMenuItem;
+	item->text = text;
+	item->rightText = rightText;
+	return item;
+}
+
+
+// Plugin, models and history
+
+struct Plugin {
+	std::vector<Model*> models;
+	void addModel(Model *model) {models.push_back(model);}
+};
+
+namespace history {
+
+struct Action {
+	std::string name;
+	virtual ~Action() {}
+};
+
+struct ModuleAdd : Action {
+	int moduleId = -1;
+	void setModule(ModuleWidget *mw) {moduleId = (mw->module ? mw->module->id : -1);}
+};
+
+struct State {
+	std::vector<Action*> actions;
+	void push(Action *action) {actions.push_back(action);}
+};
+
+}// namespace history
+
+
+// Assets: plugin resources are read from the source tree (IM_TEST_PLUGIN_DIR), user files go in IM_TEST_USER_DIR
+
+namespace asset {
+
+std::string plugin(Plugin *plugin, std::string filename);
+std::string system(std::string filename);
+std::string user(std::string filename);
+
+}// namespace asset
+
+
+// App
+
+struct Window {
+	std::map<std::string, std::shared_ptr<Svg>> svgCache;
+	int numSvgLoads = 0;// files actually read (cache misses)
+	int mods = 0;// keyboard modifiers held
+	std::shared_ptr<Svg> loadSvg(const std::string &filename);
+	std::shared_ptr<Font> loadFont(const std::string &filename) {return std::make_shared<Font>();}
+	int getMods() {return mods;}
+};
+
+struct App {
+	Engine *engine;
+	Window *window;
+	Scene *scene;
+	history::State *history;
+};
+
+App *appGet();
+
+#define APP rack::appGet()
+
+
+// Widget creation helpers
+
+template <class TWidget>
+TWidget *createWidget(Vec pos) {
+	TWidget *o = new TWidget;
+	o->box.pos = pos;
+	return o;
+}
+
+template <class TWidget>
+TWidget *createWidgetCentered(Vec pos) {
+	TWidget *o = createWidget<TWidget>(pos);
+	o->box.pos = o->box.pos.minus(o->box.size.div(2));
+	return o;
+}
+
+template <class TParamWidget>
+TParamWidget *createParam(Vec pos, Module *module, int paramId) {
+	TParamWidget *o = new TParamWidget;
+	o->box.pos = pos;
+	if (module)
+		o->paramQuantity = module->paramQuantities[paramId];
+	return o;
+}
+
+template <class TParamWidget>
+TParamWidget *createParamCentered(Vec pos, Module *module, int paramId) {
+	TParamWidget *o = createParam<TParamWidget>(pos, module, paramId);
+	o->box.pos = o->box.pos.minus(o->box.size.div(2));
+	return o;
+}
+
+template <class TModuleLightWidget>
+TModuleLightWidget *createLight(Vec pos, Module *module, int firstLightId) {
+	TModuleLightWidget *o = new TModuleLightWidget;
+	o->box.pos = pos;
+	o->module = module;
+	o->firstLightId = firstLightId;
+	return o;
+}
+
+template <class TModuleLightWidget>
+TModuleLightWidget *createLightCentered(Vec pos, Module *module, int firstLightId) {
+	TModuleLightWidget *o = createLight<TModuleLightWidget>(pos, module, firstLightId);
+	o->box.pos = o->box.pos.minus(o->box.size.div(2));
+	return o;
+}
+
+template <class TPortWidget>
+TPortWidget *createInput(Vec pos, Module *module, int inputId) {
+	TPortWidget *o = new TPortWidget;
+	o->box.pos = pos;
+	o->module = module;
+	o->portId = inputId;
+	o->isInput = true;
+	return o;
+}
+
+template <class TPortWidget>
+TPortWidget *createOutput(Vec pos, Module *module, int outputId) {
+	TPortWidget *o = new TPortWidget;
+	o->box.pos = pos;
+	o->module = module;
+	o->portId = outputId;
+	o->isInput = false;
+	return o;
+}
+
+
+template <class TModule, class TModuleWidget>
+Model *createModel(std::string slug) {
+	struct TModel : Model {
+		Module *createModule() override {
+			TModule *m = new TModule;
+			m->model = this;
+			return m;
+		}
+		app::ModuleWidget *createModuleWidget() override {
+			TModule *m = new TModule;
+			m->model = this;
+			TModuleWidget *mw = new TModuleWidget(m);
+			mw->model = this;
+			return mw;
+		}
+	};
+	TModel *o = new TModel;
+	o->slug = slug;
+	return o;
+}
+
+
+}// namespace rack
+
+
+#endif